@@ -0,0 +1,103 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "command_plan.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+// Breaks down the host side of a boot-time configuration: loading the command map,
+// compiling a text command list, loading a binary plan with and without resolving
+// the commands, and sending the plan to a device which models the bus cost.
+
+using namespace std;
+using bench_clock_t = chrono::steady_clock;
+
+extern size_t num_commands;
+
+/** @brief Milliseconds between two time points */
+static double elapsed_ms(bench_clock_t::time_point start, bench_clock_t::time_point end)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1e6;
+}
+
+/** @brief Print a single line of the breakdown */
+static void print_step(const string name, double ms)
+{
+    cout << left << setw(34) << name + ":" << right << setw(10) << ms << " ms" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    string cmd_map_path = (argc > 1) ? argv[1] : COMMAND_MAP_PATH;
+    int repeats = (argc > 2) ? stoi(argv[2]) : 50;
+    const string text_path = "bench_boot_apply.txt";
+    const string plan_path = "bench_boot_apply.bin";
+
+    cout << fixed << setprecision(3);
+    auto start = bench_clock_t::now();
+    dl_handle_t handle = load_command_map_dll(cmd_map_path);
+    print_step("Command map load", elapsed_ms(start, bench_clock_t::now()));
+
+    // Write every writable command of the command map, several times over
+    ofstream text_file(text_path, ios::out | ios::trunc);
+    for(int r = 0; r < repeats; r++)
+    {
+        for(size_t i = 0; i < num_commands; i++)
+        {
+            cmd_t cmd;
+            init_cmd(&cmd, "_", i);
+            if((cmd.rw == CMD_RO) || (cmd.type == TYPE_CHAR))
+            {
+                continue;
+            }
+            text_file << cmd.cmd_name;
+            for(unsigned v = 0; v < cmd.num_values; v++)
+            {
+                text_file << " " << r;
+            }
+            text_file << endl;
+        }
+    }
+    text_file.close();
+
+    CommandPlan text_plan;
+    start = bench_clock_t::now();
+    text_plan.compile_text(text_path, nullptr);
+    double compile_ms = elapsed_ms(start, bench_clock_t::now());
+    text_plan.save_binary(plan_path);
+    size_t num_ops = text_plan.get_ops().size();
+    cout << num_ops << " writes in the command list" << endl;
+    print_step("Text compile", compile_ms);
+
+    CommandPlan resolved_plan;
+    start = bench_clock_t::now();
+    resolved_plan.load_binary(plan_path, nullptr, true);
+    print_step("Binary load, commands resolved", elapsed_ms(start, bench_clock_t::now()));
+
+    CommandPlan boot_plan;
+    start = bench_clock_t::now();
+    boot_plan.load_binary(plan_path, nullptr, false);
+    print_step("Binary load, boot apply", elapsed_ms(start, bench_clock_t::now()));
+
+    start = bench_clock_t::now();
+    size_t num_runs = boot_plan.group_by_resource();
+    print_step("Grouping by resource", elapsed_ms(start, bench_clock_t::now()));
+
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    Command command(device, true, handle);
+
+    start = bench_clock_t::now();
+    resolved_plan.execute(&command);
+    print_step("Send, file order", elapsed_ms(start, bench_clock_t::now()));
+
+    start = bench_clock_t::now();
+    boot_plan.execute(&command);
+    print_step("Send, grouped by resource", elapsed_ms(start, bench_clock_t::now()));
+    cout << num_runs << " runs of writes to the same resource" << endl;
+
+    remove(text_path.c_str());
+    remove(plan_path.c_str());
+    return 0;
+}
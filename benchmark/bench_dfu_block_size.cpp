@@ -0,0 +1,44 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "dfu_operations.hpp"
+#include <chrono>
+#include <sstream>
+
+// Measures the download throughput for several transfer block sizes, using a device
+// which models the fixed and per-byte cost of each bus transaction.
+
+using namespace std;
+
+int main(int argc, char ** argv)
+{
+    string yaml_path = (argc > 1) ? argv[1] : DFU_CMDS_YAML_PATH;
+    size_t image_size = (argc > 2) ? stoul(argv[2]) : 32 * 1024;
+    const size_t block_sizes[] = {32, 64, 128, 192, DFU_DNLOAD_MAX_LENGTH - DFU_TRANSFER_BLOCK_LENGTH_BYTES};
+
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    device->device_init();
+
+    vector<uint8_t> image(image_size, 0xA5);
+    cout << "Image of " << image_size << " bytes" << endl;
+    for (size_t block_size : block_sizes)
+    {
+        CommandList command_list;
+        command_list.parse_dfu_cmds_yaml(yaml_path);
+        DfuTelemetry telemetry("download", image_size);
+
+        // Hide the progress line of the download
+        stringstream discard;
+        streambuf * cout_buf = cout.rdbuf(discard.rdbuf());
+        control_ret_t ret = download_image(device, &command_list, image.data(), image_size, 0, "", &telemetry, block_size);
+        cout.rdbuf(cout_buf);
+        if (ret != CONTROL_SUCCESS) {
+            cerr << "Download failed with block size " << block_size << endl;
+            return 1;
+        }
+        cout << "Block size " << setw(3) << block_size << " bytes: " << setprecision(2) << fixed
+        << setw(8) << telemetry.get_throughput() / 1024 << " KiB/s" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "dfu_commands.hpp"
+#include <chrono>
+
+// Measures the host overhead of a single DFU download block, i.e. one DFU_DNLOAD
+// write followed by one DFU_GETSTATUS read, with a device that responds instantly.
+
+using namespace std;
+
+int main(int argc, char ** argv)
+{
+    string yaml_path = (argc > 1) ? argv[1] : DFU_CMDS_YAML_PATH;
+    long iterations = (argc > 2) ? stol(argv[2]) : 1000000;
+
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    device->device_init();
+
+    CommandList command_list;
+    command_list.parse_dfu_cmds_yaml(yaml_path);
+    uint8_t * dnload_values = command_list.get_cmd_values(DFU_DNLOAD);
+    uint8_t * status_values = command_list.get_cmd_values(DFU_GETSTATUS);
+
+    auto start = chrono::steady_clock::now();
+    for(long i = 0; i < iterations; i++)
+    {
+        dnload_values[0] = i & 0xFF;
+        command_list.command_set(device, DFU_DNLOAD, dnload_values);
+        command_list.command_get(device, DFU_GETSTATUS, status_values);
+    }
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+    cout << "DFU block host overhead: " << static_cast<double>(elapsed) / iterations
+    << " ns per block (" << iterations << " blocks)" << endl;
+    return 0;
+}
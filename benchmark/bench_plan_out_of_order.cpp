@@ -0,0 +1,85 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "command_plan.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+
+// Sends a plan of writes spread over several resources to a device which models the bus cost,
+// while the servicer of one of the resources is busy after each command, so it asks to retry.
+// The time of the whole plan is compared when the operations are sent in plan order and out of order.
+
+using namespace std;
+using bench_clock_t = chrono::steady_clock;
+
+extern size_t num_commands;
+
+/** @brief Milliseconds between two time points */
+static double elapsed_ms(bench_clock_t::time_point start, bench_clock_t::time_point end)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1e6;
+}
+
+/** @brief Print a single line of the results */
+static void print_step(const string name, double ms)
+{
+    cout << left << setw(34) << name + ":" << right << setw(10) << ms << " ms" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    string cmd_map_path = (argc > 1) ? argv[1] : COMMAND_MAP_PATH;
+    int repeats = (argc > 2) ? stoi(argv[2]) : 20;
+    const control_resid_t num_resources = 4;
+
+    // The device model reads these when it is initialised, the environment takes precedence
+    setenv("BENCH_BUSY_RES_ID", "1", 0);
+    setenv("BENCH_BUSY_US", "1000", 0);
+
+    dl_handle_t handle = load_command_map_dll(cmd_map_path);
+    cmd_t base_cmd;
+    for(size_t i = 0; i < num_commands; i++)
+    {
+        init_cmd(&base_cmd, "_", i);
+        if((base_cmd.rw != CMD_RO) && (base_cmd.type != TYPE_CHAR) && !is_order_sensitive_cmd(&base_cmd))
+        {
+            break;
+        }
+    }
+
+    // The writes of each resource are sent back to back, as --boot-apply groups them
+    CommandPlan plan;
+    for(control_resid_t res_id = 0; res_id < num_resources; res_id++)
+    {
+        for(int r = 0; r < repeats; r++)
+        {
+            plan_op_t op;
+            op.cmd = base_cmd;
+            op.cmd.res_id = res_id;
+            op.is_read = false;
+            op.payload.assign(command_param_type_size(op.cmd.type) * op.cmd.num_values, static_cast<uint8_t>(r));
+            op.line = 0;
+            plan.add_op(move(op));
+        }
+    }
+    cout << plan.get_ops().size() << " writes of " << base_cmd.cmd_name << " over " << static_cast<int>(num_resources)
+    << " resources, resource " << getenv("BENCH_BUSY_RES_ID") << " busy for " << getenv("BENCH_BUSY_US") << " us after each command" << endl;
+
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    Command command(device, true, handle);
+
+    cout << fixed << setprecision(3);
+    auto start = bench_clock_t::now();
+    plan.execute(&command, false);
+    const double in_order_ms = elapsed_ms(start, bench_clock_t::now());
+    print_step("Send, in order", in_order_ms);
+
+    start = bench_clock_t::now();
+    plan.execute(&command, true);
+    const double out_of_order_ms = elapsed_ms(start, bench_clock_t::now());
+    print_step("Send, out of order", out_of_order_ms);
+    cout << "Speed up: " << setprecision(2) << in_order_ms / out_of_order_ms << " x" << endl;
+    return 0;
+}
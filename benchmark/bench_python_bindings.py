@@ -0,0 +1,58 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+"""Compare the Python bindings of xvf_control with starting xvf_host for each read
+
+The build directory must hold xvf_host, libxvf_control and xvf_control.py, and lib_dir the
+command map and the device driver. With a build made with -DTESTING=ON, the tests copy xvf_host
+and the dummy libraries into build/test, so the dummy device can be used:
+
+    cd build/test && python ../../benchmark/bench_python_bindings.py .. . i2c CMD_SMALL
+"""
+
+import argparse
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("build_dir", type=Path, help="directory of xvf_host and of the xvf_control library")
+    parser.add_argument("lib_dir", type=Path, help="directory of the command map and of the device driver")
+    parser.add_argument("protocol", help="i2c, spi or usb")
+    parser.add_argument("command", help="command to read")
+    parser.add_argument("--repeats", type=int, default=100, help="number of reads, default is 100")
+    args = parser.parse_args()
+
+    sys.path.insert(0, str(args.build_dir))
+    import xvf_control
+
+    # xvf_host loads the libraries from its own directory, so a copy in lib_dir is used first
+    host_bin = args.lib_dir.resolve() / "xvf_host"
+    if not host_bin.is_file():
+        host_bin = args.build_dir.resolve() / "xvf_host"
+
+    start = time.perf_counter()
+    for _ in range(args.repeats):
+        out = subprocess.run([str(host_bin), "-u", args.protocol, args.command], capture_output=True, text=True, check=True)
+        [float(v) for v in out.stdout.split()[1:]] # parse the values as the test utilities do
+    subprocess_s = time.perf_counter() - start
+
+    start = time.perf_counter()
+    with xvf_control.XvfControl(args.lib_dir, args.protocol) as ctrl:
+        open_s = time.perf_counter() - start
+        out = None
+        for _ in range(args.repeats):
+            out = ctrl.get(args.command, out)
+    bindings_s = time.perf_counter() - start
+
+    print(f"{'xvf_host per read:':<28}{subprocess_s * 1e3 / args.repeats:>10.3f} ms")
+    print(f"{'Bindings open:':<28}{open_s * 1e3:>10.3f} ms")
+    print(f"{'Bindings per read:':<28}{(bindings_s - open_s) * 1e3 / args.repeats:>10.3f} ms")
+    print(f"{'Speed up for ' + str(args.repeats) + ' reads:':<28}{subprocess_s / bindings_s:>10.1f} x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "device_session.hpp"
+#include <algorithm>
+#include <iomanip>
+
+// Measures the latency of single control writes while a bulk buffer transfer runs on the same
+// DeviceSession, with the transfer submitted as a single task and as one step per chunk.
+// The device models the bus, so each transaction takes the same time on every run.
+
+using namespace std;
+using bench_clock_t = chrono::steady_clock;
+
+/** @brief Latency statistics of the control writes, in milliseconds */
+struct latency_t
+{
+    double transfer_ms;
+    double mean_ms;
+    double max_ms;
+    size_t num_writes;
+};
+
+/**
+ * @brief Run a bulk transfer and time the control writes made while it runs
+ *
+ * @param session       Session to use
+ * @param offset_cmd    Command setting the start offset of a chunk
+ * @param buffer_cmd    Command reading a chunk
+ * @param control_cmd   Command written by the control thread
+ * @param length        Number of values of the buffer
+ * @param preemptible   Submit one step per chunk instead of a single task
+ */
+static latency_t run_transfer(DeviceSession & session, const cmd_t & offset_cmd, const cmd_t & buffer_cmd,
+                              const SessionCommand & control_cmd, size_t length, bool preemptible)
+{
+    vector<uint8_t> chunk(command_param_type_size(buffer_cmd.type) * buffer_cmd.num_values + 1);
+    size_t start = 0;
+    auto step = [&](Command * command)
+    {
+        uint8_t offset[4];
+        cmd_param_t offset_value;
+        offset_value.i32 = static_cast<int32_t>(start);
+        command_param_to_bytes(offset_cmd.type, offset, 0, offset_value);
+        command->command_set_bytes(&offset_cmd, offset, sizeof(offset));
+        command->command_get_bytes(&buffer_cmd, chunk.data(), chunk.size());
+        start += buffer_cmd.num_values;
+        return start >= length;
+    };
+
+    const auto transfer_start = bench_clock_t::now();
+    future<control_ret_t> transfer = (preemptible) ? session.run_steps(step) :
+        session.run([&](Command * command) {while(!step(command)) {} return CONTROL_SUCCESS;}, SESSION_PRIORITY_BULK);
+
+    // Control writes at a fixed interval until the transfer is complete
+    vector<cmd_param_t> values(control_cmd.get_cmd().num_values);
+    vector<double> latencies;
+    while(transfer.wait_for(chrono::milliseconds(2)) != future_status::ready)
+    {
+        const auto write_start = bench_clock_t::now();
+        control_cmd.set(values.data());
+        latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(bench_clock_t::now() - write_start).count() / 1e6);
+    }
+    transfer.get();
+    const double transfer_ms = chrono::duration_cast<chrono::nanoseconds>(bench_clock_t::now() - transfer_start).count() / 1e6;
+
+    latency_t result = {transfer_ms, 0.0, 0.0, latencies.size()};
+    for(double latency : latencies)
+    {
+        result.mean_ms += latency / latencies.size();
+        result.max_ms = max(result.max_ms, latency);
+    }
+    return result;
+}
+
+/** @brief Print the latency statistics of a run */
+static void print_latency(const string name, const latency_t & latency)
+{
+    cout << left << setw(24) << name + ":" << right << "transfer " << setw(8) << latency.transfer_ms << " ms, "
+    << latency.num_writes << " control writes, mean " << setw(7) << latency.mean_ms << " ms, worst " << setw(7) << latency.max_ms << " ms" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    string cmd_map_path = (argc > 1) ? argv[1] : COMMAND_MAP_PATH;
+    size_t length = (argc > 2) ? stoul(argv[2]) : 4000;
+
+    dl_handle_t handle = load_command_map_dll(cmd_map_path);
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    Command command(device, true, handle);
+    DeviceSession session(&command);
+
+    // The dummy command map has no filter commands, so the transfer uses commands of the same shape
+    cmd_t offset_cmd, buffer_cmd;
+    init_cmd(&offset_cmd, "RANGE_TEST0");
+    init_cmd(&buffer_cmd, "CMD_FLOAT");
+    SessionCommand control_cmd(&session, "CMD_SMALL");
+
+    cout << fixed << setprecision(3);
+    cout << "Buffer of " << length << " values in chunks of " << buffer_cmd.num_values << endl;
+
+    // A single control write without a transfer gives the time of one transaction
+    vector<cmd_param_t> values(control_cmd.get_cmd().num_values);
+    const auto start = bench_clock_t::now();
+    control_cmd.set(values.data());
+    cout << left << setw(24) << "Idle control write:" << right
+    << chrono::duration_cast<chrono::nanoseconds>(bench_clock_t::now() - start).count() / 1e6 << " ms" << endl;
+
+    print_latency("Single bulk task", run_transfer(session, offset_cmd, buffer_cmd, control_cmd, length, false));
+    print_latency("One step per chunk", run_transfer(session, offset_cmd, buffer_cmd, control_cmd, length, true));
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "command.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <vector>
+
+// Breaks down the startup of the host application for a single read: resolving the library paths,
+// loading the command map, looking the command up and connecting to a device which models the
+// connection cost. The device must only be connected by the first transaction, so a command
+// which fails to parse does not pay for it. Returns an error if the device is connected earlier.
+
+using namespace std;
+using bench_clock_t = chrono::steady_clock;
+
+/** @brief Milliseconds between two time points */
+static double elapsed_ms(bench_clock_t::time_point start, bench_clock_t::time_point end)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1e6;
+}
+
+/** @brief Print a single line of the breakdown */
+static void print_step(const string name, double ms)
+{
+    cout << left << setw(34) << name + ":" << right << setw(10) << ms << " ms" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    string cmd_map_path = (argc > 1) ? argv[1] : COMMAND_MAP_PATH;
+
+    // The device model reads this when it is initialised, the environment takes precedence
+    setenv("BENCH_INIT_US", "20000", 0);
+    const double init_ms = atol(getenv("BENCH_INIT_US")) / 1e3;
+
+    cout << fixed << setprecision(3);
+    auto start = bench_clock_t::now();
+    const string device_path = get_dynamic_lib_path(default_driver_name);
+    print_step("Library paths", elapsed_ms(start, bench_clock_t::now()));
+
+    start = bench_clock_t::now();
+    dl_handle_t handle = load_command_map_dll(cmd_map_path);
+    print_step("Command map load", elapsed_ms(start, bench_clock_t::now()));
+
+    cmd_t cmd;
+    start = bench_clock_t::now();
+    init_cmd(&cmd, "_", 0);
+    print_step("First command lookup", elapsed_ms(start, bench_clock_t::now()));
+
+    start = bench_clock_t::now();
+    init_cmd(&cmd, cmd.cmd_name);
+    print_step("Next command lookup", elapsed_ms(start, bench_clock_t::now()));
+
+    int device_info[1] = {0};
+    Device * device = make_Dev(device_info);
+    start = bench_clock_t::now();
+    Command command(device, false, handle);
+    const double setup_ms = elapsed_ms(start, bench_clock_t::now());
+    print_step("Command setup", setup_ms);
+
+    start = bench_clock_t::now();
+    try
+    {
+        init_cmd(&cmd, cmd.cmd_name + "_TYPO");
+    }
+    catch(const host_app_error &) {}
+    print_step("Misspelled command", elapsed_ms(start, bench_clock_t::now()));
+
+    vector<uint8_t> data(command_param_type_size(cmd.type) * cmd.num_values + 1); // one extra for the status
+    start = bench_clock_t::now();
+    command.command_get_bytes(&cmd, data.data(), data.size());
+    const double first_read_ms = elapsed_ms(start, bench_clock_t::now());
+    print_step("First read, with device init", first_read_ms);
+
+    start = bench_clock_t::now();
+    command.command_get_bytes(&cmd, data.data(), data.size());
+    print_step("Next read", elapsed_ms(start, bench_clock_t::now()));
+
+    if((setup_ms > init_ms / 2) || (first_read_ms < init_ms))
+    {
+        cerr << "The device has been connected before the first transaction" << endl;
+        return 1;
+    }
+    return 0;
+}
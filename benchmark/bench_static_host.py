@@ -0,0 +1,54 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+"""Compare the time from process start to exit for a single read of xvf_host and of xvf_host_static
+
+xvf_host loads the command map and the device driver from its directory, xvf_host_static has them
+linked in. With a build made with -DTESTING=ON, the tests copy xvf_host and the dummy libraries into
+build/test, where xvf_host_static_dummy is built with the dummy device as its i2c driver:
+
+    cd build/test && python ../../benchmark/bench_static_host.py . i2c CMD_SMALL --static-bin xvf_host_static_dummy
+"""
+
+import argparse
+import statistics
+import subprocess
+import time
+from pathlib import Path
+
+
+def time_reads(cmd, repeats):
+    """Run a read in a new process and return the time of each process, in seconds"""
+    times = []
+    for _ in range(repeats):
+        start = time.perf_counter()
+        subprocess.run(cmd, capture_output=True, check=True)
+        times.append(time.perf_counter() - start)
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("bin_dir", type=Path, help="directory of xvf_host, its libraries and xvf_host_static")
+    parser.add_argument("protocol", help="i2c, spi or usb, built into xvf_host_static")
+    parser.add_argument("command", help="command to read")
+    parser.add_argument("--static-bin", default="xvf_host_static", help="name of the static variant in bin_dir, default is xvf_host_static")
+    parser.add_argument("--repeats", type=int, default=200, help="number of processes of each variant, default is 200")
+    args = parser.parse_args()
+
+    variants = {"xvf_host": args.bin_dir.resolve() / "xvf_host",
+                "xvf_host_static": args.bin_dir.resolve() / args.static_bin}
+    times = {}
+    # The runs are interleaved, so both variants see the same state of the host
+    for _ in range(2):
+        for name, path in variants.items():
+            times.setdefault(name, []).extend(time_reads([str(path), "-u", args.protocol, args.command], args.repeats // 2))
+
+    for name, run_times in times.items():
+        print(f"{name + ' median:':<28}{statistics.median(run_times) * 1e3:>10.3f} ms")
+        print(f"{name + ' min:':<28}{min(run_times) * 1e3:>10.3f} ms")
+    print(f"{'Speed up of the median:':<28}{statistics.median(times['xvf_host']) / statistics.median(times['xvf_host_static']):>10.2f} x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "device.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// Device which models the cost of a control bus and the DFU state machine of the firmware.
+// Each transaction takes a fixed setup time plus a time per byte, set with the environment
+// variables BENCH_BUS_TRANSACTION_US and BENCH_BUS_BYTE_NS. Any DFU_DNLOAD length is accepted.
+// The servicer of the resource set with BENCH_BUSY_RES_ID is busy for BENCH_BUSY_US after each
+// command it serves, and answers SERVICER_COMMAND_RETRY to the transactions sent meanwhile.
+// Connecting to the device takes BENCH_INIT_US, as the enumeration of a USB device would.
+
+#define DFU_DNLOAD_CMD_ID      1
+#define DFU_GETSTATUS_CMD_ID   3
+#define DFU_STATE_dfuIDLE           2
+#define DFU_STATE_dfuDNLOAD_IDLE    5
+#define DFU_STATE_dfuMANIFEST       7
+
+static long transaction_ns = 100000;
+static long byte_ns = 2500;
+static uint8_t dfu_state = DFU_STATE_dfuIDLE;
+static long busy_res_id = -1;
+static long busy_ns = 0;
+static std::chrono::steady_clock::time_point busy_until;
+
+/** @brief Busy wait for the time a transaction of the given length takes on the bus */
+static void bus_transfer(size_t payload_len)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(transaction_ns + byte_ns * payload_len);
+    while (std::chrono::steady_clock::now() < end) { }
+}
+
+/** @brief Check if the servicer of a resource is busy, otherwise it serves the command and becomes busy */
+static bool is_servicer_busy(control_resid_t res_id)
+{
+    if (res_id != busy_res_id) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now < busy_until) {
+        return true;
+    }
+    busy_until = now + std::chrono::nanoseconds(busy_ns);
+    return false;
+}
+
+Device::Device(int * info)
+{
+    device_info = info;
+}
+
+control_ret_t Device::device_init()
+{
+    const char * env = getenv("BENCH_BUS_TRANSACTION_US");
+    if (env != nullptr) {
+        transaction_ns = atol(env) * 1000;
+    }
+    env = getenv("BENCH_BUS_BYTE_NS");
+    if (env != nullptr) {
+        byte_ns = atol(env);
+    }
+    env = getenv("BENCH_BUSY_RES_ID");
+    if (env != nullptr) {
+        busy_res_id = atol(env);
+    }
+    env = getenv("BENCH_BUSY_US");
+    if (env != nullptr) {
+        busy_ns = atol(env) * 1000;
+    }
+    env = getenv("BENCH_INIT_US");
+    if (env != nullptr) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(atol(env));
+        while (std::chrono::steady_clock::now() < end) { }
+    }
+    device_initialised = true;
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
+{
+    bus_transfer(payload_len);
+    memset(payload, 0, payload_len); // status byte is CONTROL_SUCCESS
+    if (is_servicer_busy(res_id)) {
+        payload[0] = SERVICER_COMMAND_RETRY;
+        return CONTROL_SUCCESS;
+    }
+    if ((cmd_id & 0x7F) == DFU_GETSTATUS_CMD_ID && payload_len > 5) {
+        payload[5] = dfu_state;
+        if (dfu_state == DFU_STATE_dfuMANIFEST) {
+            dfu_state = DFU_STATE_dfuIDLE;
+        }
+    }
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
+{
+    bus_transfer(payload_len);
+    if (is_servicer_busy(res_id)) {
+        return SERVICER_COMMAND_RETRY;
+    }
+    if (cmd_id == DFU_DNLOAD_CMD_ID && payload_len >= 2) {
+        size_t block_len = payload[0] | (payload[1] << 8);
+        dfu_state = (block_len) ? DFU_STATE_dfuDNLOAD_IDLE : DFU_STATE_dfuMANIFEST;
+    }
+    return CONTROL_SUCCESS;
+}
+
+Device::~Device()
+{
+    device_initialised = false;
+}
+
+extern "C"
+Device * make_Dev(int * info)
+{
+    static Device dev_obj(info);
+    return &dev_obj;
+}
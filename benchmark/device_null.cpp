@@ -0,0 +1,42 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "device.hpp"
+#include <cstring>
+
+// Device which completes every transaction straight away.
+// Used to measure the overhead of the host application on its own.
+
+Device::Device(int * info)
+{
+    device_info = info;
+}
+
+control_ret_t Device::device_init()
+{
+    device_initialised = true;
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
+{
+    memset(payload, 0, payload_len); // status byte is CONTROL_SUCCESS
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
+{
+    return CONTROL_SUCCESS;
+}
+
+Device::~Device()
+{
+    device_initialised = false;
+}
+
+extern "C"
+Device * make_Dev(int * info)
+{
+    static Device dev_obj(info);
+    return &dev_obj;
+}
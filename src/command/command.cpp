@@ -6,146 +6,138 @@
 using namespace std;
 
 Command::Command(Device * _dev, bool _bypass_range, dl_handle_t _handle) :
-    device(_dev), bypass_range_check(_bypass_range)
+    device(_dev), bypass_range_check(_bypass_range), cmd_map_handle(_handle)
 {
-    print_args = get_print_args_fptr(_handle);
-    check_range = get_check_range_fptr(_handle);
+}
+
+void Command::open_device()
+{
+    if(is_device_open)
+    {
+        return;
+    }
+    startup_profile_mark("Command setup");
     control_ret_t ret = device->device_init();
     if (ret != CONTROL_SUCCESS)
     {
-        cerr << "Could not connect to the device" << endl;
-        exit(ret);
+        throw host_app_error("Could not connect to the device", ret);
     }
+    is_device_open = true;
+    startup_profile_mark("Device init");
 }
 
-void Command::init_cmd_info(const string cmd_name)
+BusArbiter * Command::get_arbiter()
 {
-    init_cmd(&cmd, cmd_name);
+    open_device();
+    return device->get_arbiter();
 }
 
-size_t Command::get_num_bytes_from_type()
+check_range_fptr Command::get_check_range()
 {
-    size_t num_bytes;
-    switch(cmd.type)
+    return (bypass_range_check) ? nullptr : check_values_in_range;
+}
+
+Command::~Command()
+{
+    if(cache_config.stats_stream != nullptr)
     {
-    case TYPE_CHAR:
-    case TYPE_UINT8:
-        num_bytes = 1;
-        break;
-    case TYPE_INT32:
-    case TYPE_UINT32:
-    case TYPE_FLOAT:
-    case TYPE_RADIANS:
-        num_bytes = 4;
-        break;
-    default:
-        cerr << "Unsupported parameter type" << endl;
-        exit(HOST_APP_ERROR);
+        print_cache_stats(*cache_config.stats_stream);
     }
-    return num_bytes;
 }
 
-cmd_param_t Command::cmd_arg_str_to_val(const char * str)
+void Command::configure_cache(const cache_config_t & config)
 {
-    cmd_param_t val;
-    try{
-        switch(cmd.type)
-        {
-        case TYPE_CHAR:
-            cerr << "TYPE_CHAR commands can only be READ_ONLY" << endl;
-            exit(HOST_APP_ERROR);
+    cache_config = config;
+    cache_policies.clear();
+    cache.clear();
+    cmd_t policy_cmd;
+    for(const string & name : config.static_cmds)
+    {
+        init_cmd(&policy_cmd, name);
+        cache_policies[command_key(&policy_cmd)] = CACHE_POLICY_STATIC;
+    }
+    for(const string & name : config.bypass_cmds)
+    {
+        init_cmd(&policy_cmd, name);
+        cache_policies[command_key(&policy_cmd)] = CACHE_POLICY_BYPASS;
+    }
+}
 
-        case TYPE_UINT8:
-        {
-            int32_t tmp = stoi(str, nullptr, 0);
-            if ((tmp > UINT8_MAX) || (tmp < 0))
-            {
-                throw out_of_range("");
-            }
-            val.ui8 = static_cast<uint8_t>(tmp);
-            break;
-        }
-        case TYPE_INT32:
-            val.i32 = stoi(str, nullptr, 0);
-            break;
+cache_policy_t Command::get_cache_policy(const cmd_t * _cmd) const
+{
+    if(!cache_config.enabled || is_order_sensitive_cmd(_cmd))
+    {
+        return CACHE_POLICY_BYPASS;
+    }
+    auto policy = cache_policies.find(command_key(_cmd));
+    return (policy == cache_policies.end()) ? CACHE_POLICY_TTL : policy->second;
+}
 
-        case TYPE_UINT32:
-            val.ui32 = stoul(str, nullptr, 0);
-            break;
+void Command::invalidate_cache()
+{
+    cache.clear();
+}
 
-        case TYPE_FLOAT:
-        case TYPE_RADIANS:
-            val.f = stof(str);
-            break;
+void Command::invalidate_cache(const cmd_t * _cmd)
+{
+    cache.erase(command_key(_cmd));
+}
 
-        default:
-            cerr << "Unsupported parameter type" << endl;
-            exit(HOST_APP_ERROR);
-        }
+void Command::print_cache_stats(ostream & os) const
+{
+    os << "Device reads: " << stats.device_reads << ", device writes: " << stats.device_writes << endl;
+    if(cache_config.enabled)
+    {
+        const size_t cached_reads = stats.hits + stats.misses;
+        const double hit_rate = (cached_reads == 0) ? 0.0 : 100.0 * stats.hits / cached_reads;
+        os << "Cache hits: " << stats.hits << ", misses: " << stats.misses << ", bypassed: " << stats.bypassed
+        << ", hit rate: " << static_cast<unsigned>(hit_rate + 0.5) << "%" << endl;
     }
-    catch(const out_of_range & ex)
+    if(device->get_arbiter() != nullptr)
     {
-        static_cast<void>(ex);
-        cerr << "Value " << str << " is out of range of " << command_param_type_name(cmd.type) << " type"<< endl;
-        exit(HOST_APP_ERROR);
+        print_bus_arbiter_stats(device->get_arbiter()->get_stats(), os);
     }
-    catch(const invalid_argument & ex)
+}
+
+void Command::init_cmd_info(const string cmd_name)
+{
+    init_cmd(&cmd, cmd_name);
+}
+
+size_t Command::get_num_bytes_from_type()
+{
+    return command_param_type_size(cmd.type);
+}
+
+cmd_param_t Command::cmd_arg_str_to_val(const char * str)
+{
+    cmd_param_t val;
+    string error;
+    if(!command_param_from_str(cmd.type, str, val, error))
     {
-        static_cast<void>(ex);
-        cerr << "Argument " << str << " is invalid" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error(error);
     }
     return val;
 }
 
 control_ret_t Command::command_get(cmd_param_t * values)
 {
-    control_cmd_t cmd_id = cmd.cmd_id | 0x80; // setting 8th bit for read commands
-
     size_t data_len = get_num_bytes_from_type()*cmd.num_values + 1; // one extra for the status
     uint8_t * data = new uint8_t[data_len];
 
-    control_ret_t ret = device->device_get(cmd.res_id, cmd_id, data, data_len);
-    int read_attempts = 1;
-
-    while(1)
+    control_ret_t ret = command_get_bytes(&cmd, data, data_len);
+    for (unsigned i = 0; i < cmd.num_values; i++)
     {
-        if(read_attempts == 1000)
-        {
-            cerr << "Resource could not respond to the " << cmd.cmd_name << " read command."
-            << endl << "Check the audio loop is active." << endl;
-            exit(HOST_APP_ERROR);
-        }
-        if(data[0] == CONTROL_SUCCESS)
-        {
-            for (unsigned i = 0; i < cmd.num_values; i++)
-            {
-                values[i] = command_bytes_to_value(&data[1], i);
-            }
-            break;
-        }
-        else if(data[0] == SERVICER_COMMAND_RETRY)
-        {
-            ret = device->device_get(cmd.res_id, cmd_id, data, data_len);
-            read_attempts++;
-        }
-        else
-        {
-            check_cmd_error(cmd.cmd_name, "read", static_cast<control_ret_t>(data[0]));
-        }
+        values[i] = command_bytes_to_value(&data[1], i);
     }
 
     delete []data;
-    check_cmd_error(cmd.cmd_name, "read", ret);
     return ret;
 }
 
 control_ret_t Command::command_set(const cmd_param_t * values)
 {
-    if(!bypass_range_check)
-    {
-        check_range(cmd.cmd_name, values);
-    }
+    check_values_range(&cmd, values);
 
     size_t data_len = get_num_bytes_from_type() * cmd.num_values;
     uint8_t * data = new uint8_t[data_len];
@@ -155,39 +147,142 @@ control_ret_t Command::command_set(const cmd_param_t * values)
         command_bytes_from_value(data, i, values[i]);
     }
 
-    control_ret_t ret = device->device_set(cmd.res_id, cmd.cmd_id, data, data_len);
-    int write_attempts = 1;
+    control_ret_t ret = command_set_bytes(&cmd, data, data_len);
+
+    delete []data;
+    return ret;
+}
+
+control_ret_t Command::command_get_bytes(const cmd_t * _cmd, uint8_t * data, size_t data_len)
+{
+    control_ret_t ret;
+    unsigned attempt = 0;
+    do
+    {
+        ret = command_get_bytes_once(_cmd, data, data_len, ++attempt);
+    } while(ret == SERVICER_COMMAND_RETRY);
+    return ret;
+}
 
-    while(1)
+control_ret_t Command::command_get_bytes_once(const cmd_t * _cmd, uint8_t * data, size_t data_len, unsigned attempt)
+{
+    const cache_policy_t policy = get_cache_policy(_cmd);
+    if(attempt == 1)
     {
-        if(write_attempts == 1000)
+        if(policy == CACHE_POLICY_BYPASS)
         {
-            cerr << "Resource could not respond to the " << cmd.cmd_name << " write command."
-            << endl << "Check the audio loop is active." << endl;
-            exit(HOST_APP_ERROR);
+            if(cache_config.enabled)
+            {
+                stats.bypassed++;
+            }
         }
-        if(ret == CONTROL_SUCCESS)
+        else
         {
-            break;
+            auto entry = cache.find(command_key(_cmd));
+            if((entry != cache.end()) && (entry->second.data.size() == data_len - 1) &&
+               ((policy == CACHE_POLICY_STATIC) ||
+                (chrono::steady_clock::now() - entry->second.time < chrono::milliseconds(cache_config.ttl_ms))))
+            {
+                data[0] = CONTROL_SUCCESS;
+                memcpy(&data[1], entry->second.data.data(), data_len - 1);
+                stats.hits++;
+                return CONTROL_SUCCESS;
+            }
+            stats.misses++;
         }
-        else if(ret == SERVICER_COMMAND_RETRY)
+        stats.device_reads++;
+    }
+
+    open_device();
+    control_cmd_t cmd_id = _cmd->cmd_id | 0x80; // setting 8th bit for read commands
+    control_ret_t ret = device->device_get(_cmd->res_id, cmd_id, data, data_len);
+
+    if(data[0] == SERVICER_COMMAND_RETRY)
+    {
+        if(attempt >= COMMAND_MAX_ATTEMPTS)
         {
-            ret = device->device_set(cmd.res_id, cmd.cmd_id, data, data_len);
-            write_attempts++;
+            throw host_app_error("Resource could not respond to the " + _cmd->cmd_name + " read command.\n"
+            + "Check the audio loop is active.");
         }
-        else
+        return SERVICER_COMMAND_RETRY;
+    }
+    check_cmd_error(_cmd->cmd_name, "read", static_cast<control_ret_t>(data[0]));
+    check_cmd_error(_cmd->cmd_name, "read", ret);
+
+    if(policy != CACHE_POLICY_BYPASS)
+    {
+        cache_entry_t & entry = cache[command_key(_cmd)];
+        entry.data.assign(&data[1], &data[data_len]);
+        entry.time = chrono::steady_clock::now();
+    }
+    return ret;
+}
+
+control_ret_t Command::command_set_bytes(const cmd_t * _cmd, const uint8_t * data, size_t data_len)
+{
+    control_ret_t ret;
+    unsigned attempt = 0;
+    do
+    {
+        ret = command_set_bytes_once(_cmd, data, data_len, ++attempt);
+    } while(ret == SERVICER_COMMAND_RETRY);
+    return ret;
+}
+
+control_ret_t Command::command_set_bytes_once(const cmd_t * _cmd, const uint8_t * data, size_t data_len, unsigned attempt)
+{
+    open_device();
+    control_ret_t ret = device->device_set(_cmd->res_id, _cmd->cmd_id, data, data_len);
+    if(attempt == 1)
+    {
+        stats.device_writes++;
+    }
+
+    if(ret == SERVICER_COMMAND_RETRY)
+    {
+        if(attempt >= COMMAND_MAX_ATTEMPTS)
         {
-            check_cmd_error(cmd.cmd_name, "write", ret);
+            throw host_app_error("Resource could not respond to the " + _cmd->cmd_name + " write command.\n"
+            + "Check the audio loop is active.");
         }
+        return SERVICER_COMMAND_RETRY;
     }
+    check_cmd_error(_cmd->cmd_name, "write", ret);
 
-    delete []data;
-    check_cmd_error(cmd.cmd_name, "write", ret);
+    if(is_order_sensitive_cmd(_cmd))
+    {
+        // A special command can change the value of any other command
+        invalidate_cache();
+    }
+    else if(get_cache_policy(_cmd) != CACHE_POLICY_BYPASS)
+    {
+        cache_entry_t & entry = cache[command_key(_cmd)];
+        entry.data.assign(data, data + data_len);
+        entry.time = chrono::steady_clock::now();
+    }
     return ret;
 }
 
+void Command::check_values_range(const cmd_t * _cmd, const cmd_param_t * values)
+{
+    if(!bypass_range_check)
+    {
+        check_values_in_range(_cmd->cmd_name, values);
+    }
+}
+
+void Command::print_values(const cmd_t * _cmd, cmd_param_t * values)
+{
+    if(print_args == nullptr)
+    {
+        print_args = get_print_args_fptr(cmd_map_handle);
+    }
+    print_args(_cmd->cmd_name, values);
+}
+
 control_ret_t Command::command_get_low_level(uint8_t *data, size_t payload_len)
 {
+    open_device();
     control_ret_t ret;
     if(payload_len >= 3)
     {
@@ -211,6 +306,7 @@ control_ret_t Command::command_get_low_level(uint8_t *data, size_t payload_len)
 
 control_ret_t Command::command_set_low_level(uint8_t *data, size_t data_len)
 {
+    open_device();
     control_ret_t ret;
     if(data_len > 3)
     {
@@ -250,7 +346,7 @@ control_ret_t Command::do_command(const string cmd_name, char ** argv, int argc,
     if(args_left == 0) // READ
     {
         ret = command_get(cmd_values);
-        print_args(cmd.cmd_name, cmd_values);
+        print_values(&cmd, cmd_values);
     }
     else // WRITE
     {
@@ -268,40 +364,18 @@ control_ret_t Command::do_command(const string cmd_name, char ** argv, int argc,
 
 cmd_param_t Command::command_bytes_to_value(const uint8_t * data, unsigned index)
 {
-    cmd_param_t value;
-    size_t size_bytes = get_num_bytes_from_type();
-
-    switch(size_bytes)
-    {
-    case 1:
-        memcpy(&value.ui8, data + index * size_bytes, size_bytes);
-        break;
-    case 4:
-        memcpy(&value.i32, data + index * size_bytes, size_bytes);
-        break;
-    default:
-        cerr << "Unsupported parameter type" << endl;
-        exit(HOST_APP_ERROR);
-    }
-
-    return value;
+    return command_param_from_bytes(cmd.type, data, index);
 }
 
 void Command::command_bytes_from_value(uint8_t * data, unsigned index, const cmd_param_t value)
 {
-    size_t num_bytes = get_num_bytes_from_type();
-    switch(num_bytes)
-    {
-    case 1:
-        memcpy(data + index * num_bytes, &value.ui8, num_bytes);
-        break;
-    case 4:
-        memcpy(data + index * num_bytes, &value.i32, num_bytes);
-        break;
-    default:
-        cerr << "Unsupported parameter type" << endl;
-        exit(HOST_APP_ERROR);
-    }
+    command_param_to_bytes(cmd.type, data, index, value);
+}
+
+bool is_order_sensitive_cmd(const cmd_t * cmd)
+{
+    const string & name = cmd->cmd_name;
+    return (name.compare(0, 12, "SPECIAL_CMD_") == 0) || (name.compare(0, 5, "TEST_") == 0);
 }
 
 string command_param_type_name(cmd_param_type_t type)
@@ -335,9 +409,117 @@ string command_param_type_name(cmd_param_type_t type)
         break;
 
     default:
-        cerr << "Unsupported parameter type" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Unsupported parameter type");
     }
 
     return tstr;
 }
+
+size_t command_param_type_size(cmd_param_type_t type)
+{
+    size_t num_bytes;
+    switch(type)
+    {
+    case TYPE_CHAR:
+    case TYPE_UINT8:
+        num_bytes = 1;
+        break;
+    case TYPE_INT32:
+    case TYPE_UINT32:
+    case TYPE_FLOAT:
+    case TYPE_RADIANS:
+        num_bytes = 4;
+        break;
+    default:
+        throw host_app_error("Unsupported parameter type");
+    }
+    return num_bytes;
+}
+
+cmd_param_t command_param_from_bytes(cmd_param_type_t type, const uint8_t * data, unsigned index)
+{
+    cmd_param_t value;
+    size_t size_bytes = command_param_type_size(type);
+
+    switch(size_bytes)
+    {
+    case 1:
+        memcpy(&value.ui8, data + index * size_bytes, size_bytes);
+        break;
+    case 4:
+        memcpy(&value.i32, data + index * size_bytes, size_bytes);
+        break;
+    default:
+        throw host_app_error("Unsupported parameter type");
+    }
+
+    return value;
+}
+
+void command_param_to_bytes(cmd_param_type_t type, uint8_t * data, unsigned index, const cmd_param_t value)
+{
+    size_t num_bytes = command_param_type_size(type);
+    switch(num_bytes)
+    {
+    case 1:
+        memcpy(data + index * num_bytes, &value.ui8, num_bytes);
+        break;
+    case 4:
+        memcpy(data + index * num_bytes, &value.i32, num_bytes);
+        break;
+    default:
+        throw host_app_error("Unsupported parameter type");
+    }
+}
+
+bool command_param_from_str(cmd_param_type_t type, const string str, cmd_param_t & value, string & error)
+{
+    try{
+        switch(type)
+        {
+        case TYPE_CHAR:
+            error = "TYPE_CHAR commands can only be READ_ONLY";
+            return false;
+
+        case TYPE_UINT8:
+        {
+            int32_t tmp = stoi(str, nullptr, 0);
+            if ((tmp > UINT8_MAX) || (tmp < 0))
+            {
+                throw out_of_range("");
+            }
+            value.ui8 = static_cast<uint8_t>(tmp);
+            break;
+        }
+        case TYPE_INT32:
+            value.i32 = stoi(str, nullptr, 0);
+            break;
+
+        case TYPE_UINT32:
+            value.ui32 = stoul(str, nullptr, 0);
+            break;
+
+        case TYPE_FLOAT:
+        case TYPE_RADIANS:
+            value.f = stof(str);
+            break;
+
+        default:
+            error = "Unsupported parameter type";
+            return false;
+        }
+    }
+    catch(const out_of_range & ex)
+    {
+        static_cast<void>(ex);
+        error = "Value " + str + " is out of range of " + command_param_type_name(type) + " type";
+        return false;
+    }
+    catch(const invalid_argument & ex)
+    {
+        static_cast<void>(ex);
+        error = "Argument " + str + " is invalid";
+        return false;
+    }
+    return true;
+}
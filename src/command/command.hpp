@@ -5,6 +5,51 @@
 #define COMMAND_CLASS_H_
 
 #include "utils.hpp"
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+
+/** @brief Number of times a command is sent to a busy resource before giving up */
+#define COMMAND_MAX_ATTEMPTS 1000
+
+/**
+ * @brief Enum for the shadow cache policy of a command
+ *
+ * CACHE_POLICY_TTL serves reads from the cache for the configured time to live,
+ * CACHE_POLICY_STATIC serves them for as long as the application runs and
+ * CACHE_POLICY_BYPASS always reads from the device.
+ */
+enum cache_policy_t {CACHE_POLICY_TTL, CACHE_POLICY_STATIC, CACHE_POLICY_BYPASS};
+
+/** @brief Shadow cache configuration structure */
+struct cache_config_t
+{
+    /** Use the shadow cache */
+    bool enabled;
+    /** Time to live of the cached values of CACHE_POLICY_TTL commands, in milliseconds */
+    unsigned ttl_ms;
+    /** Commands with CACHE_POLICY_STATIC */
+    std::vector<std::string> static_cmds;
+    /** Commands with CACHE_POLICY_BYPASS */
+    std::vector<std::string> bypass_cmds;
+    /** Stream the transaction and cache statistics are printed to when the Command object is destroyed, nullptr not to print them */
+    std::ostream * stats_stream;
+};
+
+/** @brief Transaction and shadow cache statistics */
+struct cache_stats_t
+{
+    /** Reads sent to the device, not counting the retries */
+    size_t device_reads;
+    /** Writes sent to the device, not counting the retries */
+    size_t device_writes;
+    /** Reads served from the cache */
+    size_t hits;
+    /** Reads of cached commands which had to be sent to the device */
+    size_t misses;
+    /** Reads of CACHE_POLICY_BYPASS commands */
+    size_t bypassed;
+};
 
 /**
  * @brief Class for executing a single command
@@ -22,18 +67,51 @@ class Command
         /** @brief Bypass range check state */
         bool bypass_range_check;
 
-        /** @brief Pointer to the super_print_arg() function from the command_map shared object */
-        print_args_fptr print_args;
+        /** @brief Command map dl handle */
+        dl_handle_t cmd_map_handle;
+
+        /** @brief Whether the device has been initialised, see open_device() */
+        bool is_device_open = false;
+
+        /** @brief Pointer to the super_print_arg() function from the command_map shared object, resolved on first use */
+        print_args_fptr print_args = nullptr;
 
-        /** @brief Pointer to the check_range() function from the command_map shared object */
-        check_range_fptr check_range;
+        /** @brief Value of a command held by the shadow cache */
+        struct cache_entry_t
+        {
+            /** Encoded values, without the status byte */
+            std::vector<uint8_t> data;
+            /** Time the values have been read from or written to the device */
+            std::chrono::steady_clock::time_point time;
+        };
+
+        /** @brief Shadow cache configuration */
+        cache_config_t cache_config = {false, 0, {}, {}, nullptr};
+
+        /** @brief Cache policy of the commands which don't use the default one, see get_cache_policy() */
+        std::unordered_map<uint16_t, cache_policy_t> cache_policies;
+
+        /** @brief Shadow cache, keyed by resource and command ID */
+        std::unordered_map<uint16_t, cache_entry_t> cache;
+
+        /** @brief Transaction and shadow cache statistics */
+        cache_stats_t stats = {0, 0, 0, 0, 0};
+
+        /**
+         * @brief Get the cache policy of a command
+         *
+         * @param _cmd          Pointer to the command information
+         * @note Commands starting with SPECIAL_CMD_ and TEST_ are never cached
+         */
+        cache_policy_t get_cache_policy(const cmd_t * _cmd) const;
 
     public:
 
         /**
          * @brief Construct a new Command object.
          *
-         * Will initialise a host (master) interface.
+         * The host (master) interface is only initialised before the first transaction,
+         * so nothing is sent to the device by the commands which fail to parse or hit the shadow cache.
          *
          * @param _dev          Pointer to the Device class object
          * @param _bypass_range Bypass range check state
@@ -41,6 +119,61 @@ class Command
          */
         Command(Device * _dev, bool _bypass_range, dl_handle_t _handle);
 
+        /**
+         * @brief Destroy the Command object
+         *
+         * Prints the statistics if requested with configure_cache().
+         */
+        ~Command();
+
+        /**
+         * @brief Configure the shadow cache
+         *
+         * When the cache is enabled, the values written are kept on the host (write-through)
+         * and the reads are served from the cache until they are older than the time to live,
+         * or forever for the static commands.
+         *
+         * @param config        Shadow cache configuration
+         * @note Throws host_app_error if a command in the configuration does not exist
+         */
+        void configure_cache(const cache_config_t & config);
+
+        /** @brief Drop all the values held by the shadow cache */
+        void invalidate_cache();
+
+        /**
+         * @brief Drop the value of a single command from the shadow cache
+         *
+         * @param _cmd          Pointer to the command information
+         */
+        void invalidate_cache(const cmd_t * _cmd);
+
+        /** @brief Get the transaction and shadow cache statistics */
+        const cache_stats_t & get_cache_stats() const {return stats;};
+
+        /**
+         * @brief Print the transaction and shadow cache statistics, and the bus lock wait time if the device is shared
+         *
+         * @param os            Stream to print to
+         */
+        void print_cache_stats(std::ostream & os) const;
+
+        /**
+         * @brief Initialise the device, if it has not been initialised yet
+         *
+         * This is done before the first transaction, it only has to be called to connect to the device in advance.
+         * @note Throws host_app_error if the device can't be reached
+         */
+        void open_device();
+
+        /**
+         * @brief Get the arbiter of the device, to hold it for several commands with BusArbiterLock
+         *
+         * @return              nullptr if the device is not shared with other processes
+         * @note The device is initialised first, see open_device()
+         */
+        BusArbiter * get_arbiter();
+
         /**
          * @brief Initialise command information
          *
@@ -73,6 +206,80 @@ class Command
          */
         control_ret_t command_set(const cmd_param_t * values);
 
+        /**
+         * @brief Executes a get command with an already encoded payload
+         *
+         * @param _cmd          Pointer to the command information
+         * @param data          Buffer to store the status byte followed by the values read from the device
+         * @param data_len      Size of the buffer, including the status byte
+         * @note                Used to run commands resolved in advance, without changing the current command
+         * @note                Served from the shadow cache if it holds a valid value
+         */
+        control_ret_t command_get_bytes(const cmd_t * _cmd, uint8_t * data, size_t data_len);
+
+        /**
+         * @brief Executes a set command with an already encoded payload
+         *
+         * @param _cmd          Pointer to the command information
+         * @param data          Byte array containing the values to write
+         * @param data_len      Length of the byte array
+         * @note                Values are not range checked, use check_values_range() beforehand
+         * @note                The shadow cache is updated once the device has acknowledged the write,
+         * and dropped completely after a SPECIAL_CMD_ or TEST_ command
+         */
+        control_ret_t command_set_bytes(const cmd_t * _cmd, const uint8_t * data, size_t data_len);
+
+        /**
+         * @brief Send a get command once, without waiting for a busy resource
+         *
+         * @param _cmd          Pointer to the command information
+         * @param data          Buffer to store the status byte followed by the values read from the device
+         * @param data_len      Size of the buffer, including the status byte
+         * @param attempt       Number of this attempt, starting at 1. Only the first one can be served from
+         * the shadow cache and is counted in the statistics
+         * @return              SERVICER_COMMAND_RETRY if the resource is busy and the read has to be sent again,
+         * otherwise the result of command_get_bytes()
+         * @note                Throws host_app_error once the resource has been busy for COMMAND_MAX_ATTEMPTS attempts
+         */
+        control_ret_t command_get_bytes_once(const cmd_t * _cmd, uint8_t * data, size_t data_len, unsigned attempt);
+
+        /**
+         * @brief Send a set command once, without waiting for a busy resource
+         *
+         * @param _cmd          Pointer to the command information
+         * @param data          Byte array containing the values to write
+         * @param data_len      Length of the byte array
+         * @param attempt       Number of this attempt, starting at 1. Only the first one is counted in the statistics
+         * @return              SERVICER_COMMAND_RETRY if the resource is busy and the write has to be sent again,
+         * otherwise the result of command_set_bytes()
+         * @note                Throws host_app_error once the resource has been busy for COMMAND_MAX_ATTEMPTS attempts
+         */
+        control_ret_t command_set_bytes_once(const cmd_t * _cmd, const uint8_t * data, size_t data_len, unsigned attempt);
+
+        /**
+         * @brief Check the values are in range, unless the range check is bypassed
+         *
+         * @param _cmd          Pointer to the command information
+         * @param values        Values to check
+         * @note                Throws host_app_error if a value is out of range
+         */
+        void check_values_range(const cmd_t * _cmd, const cmd_param_t * values);
+
+        /**
+         * @brief Get the range check function to use for this session
+         *
+         * @return              check_values_in_range(), nullptr if the range check is bypassed
+         */
+        check_range_fptr get_check_range();
+
+        /**
+         * @brief Print the command name followed by the values
+         *
+         * @param _cmd          Pointer to the command information
+         * @param values        Values to print
+         */
+        void print_values(const cmd_t * _cmd, cmd_param_t * values);
+
         /**
          * @brief Low level get command function.
          *
@@ -127,6 +334,22 @@ class Command
         cmd_param_t cmd_arg_str_to_val(const char * str);
 };
 
+/**
+ * @brief Get a key which identifies a command on the device
+ *
+ * @param cmd           Pointer to the command information
+ * @return              Resource ID in the upper byte and command ID in the lower byte
+ */
+inline uint16_t command_key(const cmd_t * cmd) {return static_cast<uint16_t>((cmd->res_id << 8) | cmd->cmd_id);}
+
+/**
+ * @brief Check if a command can depend on or change the state of other commands
+ *
+ * @param cmd           Pointer to the command information
+ * @return              true for commands starting with SPECIAL_CMD_ or TEST_
+ */
+bool is_order_sensitive_cmd(const cmd_t * cmd);
+
 /**
  * @brief Get string with type name for the particular param type
  *
@@ -134,4 +357,41 @@ class Command
  */
 std::string command_param_type_name(cmd_param_type_t type);
 
+/**
+ * @brief Get number of bytes for the particular param type
+ *
+ * @param type          Command type
+ */
+size_t command_param_type_size(cmd_param_type_t type);
+
+/**
+ * @brief Convert single value from bytes to cmd_param_t
+ *
+ * @param type          Command type
+ * @param data          Byte array containing the data to read
+ * @param index         Index of the value in the byte array
+ */
+cmd_param_t command_param_from_bytes(cmd_param_type_t type, const uint8_t * data, unsigned index);
+
+/**
+ * @brief Convert single value from cmd_param_t to bytes
+ *
+ * @param type          Command type
+ * @param data          Byte array to write the data to
+ * @param index         Index of the value in the byte array
+ * @param value         Value to convert
+ */
+void command_param_to_bytes(cmd_param_type_t type, uint8_t * data, unsigned index, const cmd_param_t value);
+
+/**
+ * @brief Convert command line argument from string to cmd_param_t
+ *
+ * @param type          Command type
+ * @param str           String storing the command line argument to convert
+ * @param value         Converted value
+ * @param error         Error message, set if the conversion fails
+ * @return              true if the conversion succeeded
+ */
+bool command_param_from_str(cmd_param_type_t type, const std::string str, cmd_param_t & value, std::string & error);
+
 #endif
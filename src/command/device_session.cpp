@@ -0,0 +1,172 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "device_session.hpp"
+#include <deque>
+
+using namespace std;
+
+/** @brief Request queued to a DeviceSession */
+struct session_request_t
+{
+    /** Runs one step of the request on the I/O thread and sets the result, returns true once the request is complete */
+    function<bool(Command *, control_ret_t &)> step;
+    /** Result slot of this request */
+    promise<control_ret_t> result;
+    /** Request submitted before this one in the submission list */
+    session_request_t * next;
+};
+
+DeviceSession::DeviceSession(Command * _command) :
+    command(_command)
+{
+    for(auto & list : submitted)
+    {
+        list.store(nullptr, memory_order_relaxed);
+    }
+    io_thread = thread(&DeviceSession::io_loop, this);
+}
+
+DeviceSession::~DeviceSession()
+{
+    {
+        lock_guard<mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    idle_cv.notify_one();
+    io_thread.join();
+}
+
+future<control_ret_t> DeviceSession::run(function<control_ret_t(Command *)> task, session_priority_t priority)
+{
+    return submit(new session_request_t{[task](Command * cmd, control_ret_t & ret) {ret = task(cmd); return true;}, promise<control_ret_t>(), nullptr}, priority);
+}
+
+future<control_ret_t> DeviceSession::run_steps(function<bool(Command *)> step, session_priority_t priority)
+{
+    return submit(new session_request_t{[step](Command * cmd, control_ret_t & ret) {ret = CONTROL_SUCCESS; return step(cmd);}, promise<control_ret_t>(), nullptr}, priority);
+}
+
+future<control_ret_t> DeviceSession::submit(session_request_t * request, session_priority_t priority)
+{
+    future<control_ret_t> result = request->result.get_future();
+
+    atomic<session_request_t *> & list = submitted[priority];
+    session_request_t * head = list.load(memory_order_relaxed);
+    do
+    {
+        request->next = head;
+    } while(!list.compare_exchange_weak(head, request, memory_order_release, memory_order_relaxed));
+
+    if(head == nullptr)
+    {
+        // The I/O thread may be waiting, taking the lock makes sure it sees the request or gets the notification
+        lock_guard<mutex> lock(idle_mutex);
+        idle_cv.notify_one();
+    }
+    return result;
+}
+
+bool DeviceSession::has_submitted() const
+{
+    for(const auto & list : submitted)
+    {
+        if(list.load(memory_order_relaxed) != nullptr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeviceSession::io_loop()
+{
+    // Requests taken from the submission lists, oldest first, only used by this thread
+    deque<session_request_t *> queues[SESSION_NUM_PRIORITIES];
+    while(true)
+    {
+        for(int p = 0; p < SESSION_NUM_PRIORITIES; p++)
+        {
+            // The list is newest first, so it is reversed to queue the requests in submission order
+            session_request_t * batch = submitted[p].exchange(nullptr, memory_order_acquire);
+            const size_t queued = queues[p].size();
+            for(; batch != nullptr; batch = batch->next)
+            {
+                queues[p].insert(queues[p].begin() + queued, batch);
+            }
+        }
+
+        deque<session_request_t *> * queue = nullptr;
+        for(auto & q : queues)
+        {
+            if(!q.empty())
+            {
+                queue = &q;
+                break;
+            }
+        }
+        if(queue == nullptr)
+        {
+            unique_lock<mutex> lock(idle_mutex);
+            idle_cv.wait(lock, [this]() {return stopping || has_submitted();});
+            if(stopping && !has_submitted())
+            {
+                return;
+            }
+            continue;
+        }
+
+        // Run a single step, so the submission lists are checked again before the next one
+        session_request_t * request = queue->front();
+        try
+        {
+            control_ret_t ret;
+            if(!request->step(command, ret))
+            {
+                continue;
+            }
+            request->result.set_value(ret);
+        }
+        catch(...)
+        {
+            request->result.set_exception(current_exception());
+        }
+        queue->pop_front();
+        delete request;
+    }
+}
+
+SessionCommand::SessionCommand(DeviceSession * _session, const string & cmd_name) :
+    session(_session), cmd([&cmd_name]() {cmd_t new_cmd; init_cmd(&new_cmd, cmd_name); return new_cmd;}())
+{
+}
+
+future<control_ret_t> SessionCommand::get_async(cmd_param_t * values, session_priority_t priority) const
+{
+    return session->run([this, values](Command * command)
+    {
+        vector<uint8_t> data(command_param_type_size(cmd.type) * cmd.num_values + 1); // one extra for the status
+        control_ret_t ret = command->command_get_bytes(&cmd, data.data(), data.size());
+        for(unsigned i = 0; i < cmd.num_values; i++)
+        {
+            values[i] = command_param_from_bytes(cmd.type, &data[1], i);
+        }
+        return ret;
+    }, priority);
+}
+
+future<control_ret_t> SessionCommand::set_async(const cmd_param_t * values, session_priority_t priority) const
+{
+    vector<cmd_param_t> params(values, values + cmd.num_values);
+    vector<uint8_t> data(command_param_type_size(cmd.type) * cmd.num_values);
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        command_param_to_bytes(cmd.type, data.data(), i, params[i]);
+    }
+    return session->run([this, params, data](Command * command)
+    {
+        // The range check of the command_map is not thread safe, so it only runs on the I/O thread
+        command->check_values_range(&cmd, params.data());
+        return command->command_set_bytes(&cmd, data.data(), data.size());
+    }, priority);
+}
@@ -0,0 +1,195 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef DEVICE_SESSION_H_
+#define DEVICE_SESSION_H_
+
+#include "command.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Enum for the priority classes of the session requests
+ *
+ * SESSION_PRIORITY_CONTROL requests run before the SESSION_PRIORITY_BULK ones, and also
+ * between the steps of a bulk request, so they only wait for the step which is running.
+ */
+enum session_priority_t {SESSION_PRIORITY_CONTROL, SESSION_PRIORITY_BULK, SESSION_NUM_PRIORITIES};
+
+/** @brief Request queued to a DeviceSession, see device_session.cpp */
+struct session_request_t;
+
+/**
+ * @brief Class for sharing a device between threads
+ *
+ * All the transactions are run by a single I/O thread, which owns the Command object, its
+ * shadow cache and the device. Any thread can submit requests: they are pushed to a lock
+ * free submission list of their priority class and run in the order they were submitted
+ * within the class. Each request has its own result, which the submitting thread waits for,
+ * and the errors thrown while running a request are rethrown by the thread waiting for it.
+ *
+ * A request made of steps, such as a chunked buffer transfer, keeps the other requests of
+ * its class waiting until it completes, but the higher priority requests run between its steps.
+ */
+class DeviceSession
+{
+    private:
+
+        /** @brief Pointer to the Command class object, only used by the I/O thread */
+        Command * command;
+
+        /** @brief Requests of each priority class submitted and not taken by the I/O thread yet, newest first */
+        std::atomic<session_request_t *> submitted[SESSION_NUM_PRIORITIES];
+
+        /** @brief Protects stopping and the wait of the I/O thread for requests */
+        std::mutex idle_mutex;
+
+        /** @brief Wakes the I/O thread up when a request is submitted to the empty list */
+        std::condition_variable idle_cv;
+
+        /** @brief Set when the session is destroyed */
+        bool stopping = false;
+
+        /** @brief Thread running the requests */
+        std::thread io_thread;
+
+        /** @brief Check if a request has been submitted and not taken by the I/O thread yet */
+        bool has_submitted() const;
+
+        /**
+         * @brief Queue a request to the I/O thread
+         *
+         * @param request       Request to run, deleted by the I/O thread once complete
+         * @param priority      Priority class of the request
+         * @return              Result of the request
+         */
+        std::future<control_ret_t> submit(session_request_t * request, session_priority_t priority);
+
+        /** @brief Run the requests by priority until the session is destroyed */
+        void io_loop();
+
+    public:
+
+        /**
+         * @brief Construct a new DeviceSession object and start the I/O thread
+         *
+         * @param _command      Pointer to the Command class object, which must only be used through the session from now on
+         */
+        DeviceSession(Command * _command);
+
+        /**
+         * @brief Destroy the DeviceSession object
+         *
+         * The requests already submitted are run before the I/O thread stops.
+         */
+        ~DeviceSession();
+
+        DeviceSession(const DeviceSession &) = delete;
+        DeviceSession & operator=(const DeviceSession &) = delete;
+
+        /**
+         * @brief Submit a task which uses the Command object
+         *
+         * The task runs on the I/O thread, so several transactions which must not be
+         * interleaved with the ones of other threads can be submitted as a single task.
+         *
+         * @param task          Function to run with the Command object
+         * @param priority      Priority class of the task
+         * @return              Result of the task
+         */
+        std::future<control_ret_t> run(std::function<control_ret_t(Command *)> task, session_priority_t priority = SESSION_PRIORITY_CONTROL);
+
+        /**
+         * @brief Submit a task made of steps which uses the Command object
+         *
+         * The step is called again until it returns true, and the higher priority requests
+         * run between two calls, so each step should only make a few transactions.
+         *
+         * @param step          Function to run one step with the Command object, returns true once the task is complete
+         * @param priority      Priority class of the task
+         * @return              Result of the task, CONTROL_SUCCESS unless a step throws
+         */
+        std::future<control_ret_t> run_steps(std::function<bool(Command *)> step, session_priority_t priority = SESSION_PRIORITY_BULK);
+};
+
+/**
+ * @brief Handle for reading and writing a single command through a DeviceSession
+ *
+ * The command is resolved once when the handle is constructed and never changes,
+ * so a handle can be used by any thread without locks.
+ */
+class SessionCommand
+{
+    private:
+
+        /** @brief Session running the transactions */
+        DeviceSession * const session;
+
+        /** @brief Command information */
+        const cmd_t cmd;
+
+    public:
+
+        /**
+         * @brief Construct a new SessionCommand object
+         *
+         * @param _session      Session running the transactions
+         * @param _cmd          Command information
+         */
+        SessionCommand(DeviceSession * _session, const cmd_t & _cmd) : session(_session), cmd(_cmd) {};
+
+        /**
+         * @brief Construct a new SessionCommand object
+         *
+         * @param _session      Session running the transactions
+         * @param cmd_name      Command name, in any case
+         * @note Throws host_app_error if the command does not exist
+         */
+        SessionCommand(DeviceSession * _session, const std::string & cmd_name);
+
+        /** @brief Get the command information */
+        const cmd_t & get_cmd() const {return cmd;};
+
+        /**
+         * @brief Submit a read of the command
+         *
+         * @param values        Array of cmd.num_values values, set before the result is ready
+         * @param priority      Priority class of the read
+         * @return              Result of the read
+         * @note The handle and the values must stay valid until the result is ready
+         */
+        std::future<control_ret_t> get_async(cmd_param_t * values, session_priority_t priority = SESSION_PRIORITY_CONTROL) const;
+
+        /**
+         * @brief Submit a write of the command
+         *
+         * The values are encoded by the calling thread and range checked by the I/O thread.
+         * @param values        Array of cmd.num_values values, copied before returning
+         * @param priority      Priority class of the write
+         * @return              Result of the write
+         * @note The handle must stay valid until the result is ready
+         */
+        std::future<control_ret_t> set_async(const cmd_param_t * values, session_priority_t priority = SESSION_PRIORITY_CONTROL) const;
+
+        /**
+         * @brief Read the command and wait for the values
+         *
+         * @param values        Array of cmd.num_values values
+         * @param priority      Priority class of the read
+         */
+        control_ret_t get(cmd_param_t * values, session_priority_t priority = SESSION_PRIORITY_CONTROL) const {return get_async(values, priority).get();};
+
+        /**
+         * @brief Write the command and wait for the device to acknowledge it
+         *
+         * @param values        Array of cmd.num_values values
+         * @param priority      Priority class of the write
+         */
+        control_ret_t set(const cmd_param_t * values, session_priority_t priority = SESSION_PRIORITY_CONTROL) const {return set_async(values, priority).get();};
+};
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "bus_arbiter.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#if (defined(__linux__) || defined(__APPLE__))
+#include <fcntl.h>          // open
+#include <signal.h>         // kill
+#include <sys/mman.h>       // mmap
+#include <sys/stat.h>       // fstat, fchmod
+#include <unistd.h>         // ftruncate, getpid
+#include <cerrno>
+#endif
+
+using namespace std;
+using arbiter_clock_t = chrono::steady_clock;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "The lock file needs lock free atomics");
+
+/** @brief Time after which a ticket which has not been published is considered abandoned */
+#define BUS_ARBITER_PUBLISH_TIMEOUT_MS 1000
+
+/**
+ * @brief Table shared by the processes through the lock file
+ *
+ * A file full of zeros is a free lock, so a new lock file does not need to be initialised.
+ */
+struct bus_lock_table_t
+{
+    /** Next ticket to give to a process asking for the device */
+    atomic<uint32_t> next_ticket;
+    /** Ticket of the process allowed to use the device */
+    atomic<uint32_t> now_serving;
+    /** Ticket in the upper half and process ID in the lower half, indexed by ticket */
+    atomic<uint64_t> owners[BUS_ARBITER_MAX_WAITERS];
+};
+
+#if (defined(__linux__) || defined(__APPLE__))
+
+/** @brief Check if a process has exited */
+static bool is_process_dead(uint32_t pid)
+{
+    return (kill(static_cast<pid_t>(pid), 0) != 0) && (errno == ESRCH);
+}
+
+void BusArbiter::lock()
+{
+    if(depth++ != 0)
+    {
+        return;
+    }
+    const arbiter_clock_t::time_point start = arbiter_clock_t::now();
+    ticket = table->next_ticket.fetch_add(1, memory_order_relaxed);
+    table->owners[ticket % BUS_ARBITER_MAX_WAITERS].store((static_cast<uint64_t>(ticket) << 32) | static_cast<uint32_t>(getpid()), memory_order_release);
+
+    uint32_t serving = table->now_serving.load(memory_order_acquire);
+    uint32_t last_serving = serving;
+    arbiter_clock_t::time_point serving_since = start;
+    unsigned polls = 0;
+    while(serving != ticket)
+    {
+        // Skip the process ahead in the queue if it has died, or if it never published its ticket
+        const uint64_t owner = table->owners[serving % BUS_ARBITER_MAX_WAITERS].load(memory_order_acquire);
+        const bool is_published = (static_cast<uint32_t>(owner >> 32) == serving);
+        const arbiter_clock_t::time_point now = arbiter_clock_t::now();
+        if(serving != last_serving)
+        {
+            last_serving = serving;
+            serving_since = now;
+        }
+        if((is_published && is_process_dead(static_cast<uint32_t>(owner))) ||
+           (!is_published && (now - serving_since > chrono::milliseconds(BUS_ARBITER_PUBLISH_TIMEOUT_MS))))
+        {
+            table->now_serving.compare_exchange_strong(serving, serving + 1, memory_order_acq_rel);
+            continue;
+        }
+
+        // Transactions are short, so the first polls only yield
+        if(++polls < 100)
+        {
+            this_thread::yield();
+        }
+        else
+        {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+        serving = table->now_serving.load(memory_order_acquire);
+    }
+
+    const uint64_t wait_us = chrono::duration_cast<chrono::microseconds>(arbiter_clock_t::now() - start).count();
+    stats.acquisitions++;
+    stats.contended += (polls != 0) ? 1 : 0;
+    stats.total_wait_us += wait_us;
+    stats.max_wait_us = (wait_us > stats.max_wait_us) ? wait_us : stats.max_wait_us;
+}
+
+void BusArbiter::unlock()
+{
+    if((depth == 0) || (--depth != 0))
+    {
+        return;
+    }
+    uint32_t serving = ticket;
+    table->now_serving.compare_exchange_strong(serving, ticket + 1, memory_order_release, memory_order_relaxed);
+}
+
+BusArbiter::~BusArbiter()
+{
+    if(depth != 0)
+    {
+        depth = 1;
+        unlock();
+    }
+    munmap(table, sizeof(bus_lock_table_t));
+}
+
+control_ret_t open_bus_arbiter(const string & device_key, bool is_requested, BusArbiter ** arbiter)
+{
+    *arbiter = nullptr;
+    const char * env = getenv(BUS_ARBITER_ENV);
+    if(!is_requested && ((env == nullptr) || (string(env) != "1")))
+    {
+        return CONTROL_SUCCESS;
+    }
+
+    const char * dir = getenv(BUS_ARBITER_DIR_ENV);
+    const string lock_path = string((dir != nullptr) ? dir : "/tmp") + "/xvf_bus_" + device_key + ".lock";
+    int fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0666);
+    if(fd < 0)
+    {
+        cerr << "Could not open the bus lock file " << lock_path << endl;
+        return CONTROL_ERROR;
+    }
+    // The processes sharing the device can belong to different users
+    fchmod(fd, 0666);
+
+    // Growing the file fills it with zeros, it is never shrunk as other processes can be using it
+    struct stat st;
+    bool is_sized = (fstat(fd, &st) == 0) &&
+                    ((static_cast<size_t>(st.st_size) >= sizeof(bus_lock_table_t)) || (ftruncate(fd, sizeof(bus_lock_table_t)) == 0));
+    void * addr = (is_sized) ? mmap(nullptr, sizeof(bus_lock_table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        cerr << "Could not map the bus lock file " << lock_path << endl;
+        return CONTROL_ERROR;
+    }
+    *arbiter = new BusArbiter(static_cast<bus_lock_table_t *>(addr));
+    return CONTROL_SUCCESS;
+}
+
+#elif defined(_WIN32)
+
+void BusArbiter::lock() {}
+
+void BusArbiter::unlock() {}
+
+BusArbiter::~BusArbiter() {}
+
+control_ret_t open_bus_arbiter(const string & device_key, bool is_requested, BusArbiter ** arbiter)
+{
+    *arbiter = nullptr;
+    const char * env = getenv(BUS_ARBITER_ENV);
+    if(is_requested || ((env != nullptr) && (string(env) == "1")))
+    {
+        cerr << "Bus arbitration is not supported on Windows" << endl;
+        return CONTROL_ERROR;
+    }
+    return CONTROL_SUCCESS;
+}
+
+#else
+#error "Unknown Operating System"
+#endif
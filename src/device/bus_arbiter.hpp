@@ -0,0 +1,118 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef BUS_ARBITER_H_
+#define BUS_ARBITER_H_
+
+#include <cstdint>
+#include <string>
+extern "C"
+#include "device_control_shared.h"
+
+/** @brief Largest number of processes which can wait for the same device */
+#define BUS_ARBITER_MAX_WAITERS 256
+
+/** @brief Environment variable which enables the arbitration in every application, when set to 1 */
+#define BUS_ARBITER_ENV "XVF_BUS_ARBITRATION"
+
+/** @brief Environment variable holding the directory of the lock files, /tmp by default */
+#define BUS_ARBITER_DIR_ENV "XVF_BUS_LOCK_DIR"
+
+/** @brief Statistics of the time spent waiting for the device */
+struct bus_arbiter_stats_t
+{
+    /** Number of times the device has been taken, not counting the nested sections */
+    uint64_t acquisitions;
+    /** Number of times another process was holding the device */
+    uint64_t contended;
+    /** Total time spent waiting for the device, in microseconds */
+    uint64_t total_wait_us;
+    /** Longest time spent waiting for the device, in microseconds */
+    uint64_t max_wait_us;
+};
+
+/**
+ * @brief Class for sharing a device with the other processes of the host
+ *
+ * The processes take the device in turns with a ticket lock kept in a lock file shared by all of them,
+ * so they get it in the order they asked for it. A process holding or waiting for the device which
+ * dies is skipped by the next one in the queue.
+ *
+ * The device drivers take the device for each transaction. The applications take it around
+ * the sequences of transactions which must not be interleaved with other processes, such as
+ * a DFU session, and the transactions inside such a section don't take it again.
+ *
+ * @note The methods are virtual, so the applications can call them through the device driver which created the object.
+ * @note An object must only be used by one thread at a time.
+ */
+class BusArbiter
+{
+    private:
+
+        /** @brief Shared table of the lock file */
+        struct bus_lock_table_t * table;
+
+        /** @brief Ticket of this process while it holds the device */
+        uint32_t ticket = 0;
+
+        /** @brief Number of nested sections holding the device */
+        unsigned depth = 0;
+
+        /** @brief Waiting statistics */
+        bus_arbiter_stats_t stats = {0, 0, 0, 0};
+
+        /** @brief Construct a new BusArbiter object on a mapped lock file */
+        BusArbiter(struct bus_lock_table_t * _table) : table(_table) {};
+
+        friend control_ret_t open_bus_arbiter(const std::string & device_key, bool is_requested, BusArbiter ** arbiter);
+
+    public:
+
+        /** @brief Take the device, waiting for the processes which asked for it first */
+        virtual void lock();
+
+        /** @brief Give the device back once the outermost section ends */
+        virtual void unlock();
+
+        /** @brief Get the waiting statistics */
+        virtual bus_arbiter_stats_t get_stats() const {return stats;};
+
+        /** @brief Destroy the BusArbiter object and give the device back if still held */
+        virtual ~BusArbiter();
+};
+
+/**
+ * @brief Open the arbitration of a device if it is enabled
+ *
+ * @param device_key    Name identifying the device on the host, such as the protocol and address
+ * @param is_requested  Enable the arbitration even when BUS_ARBITER_ENV is not set
+ * @param arbiter       Set to the new BusArbiter object, or nullptr if the arbitration is not enabled
+ * @return              CONTROL_ERROR if the lock file could not be opened
+ */
+control_ret_t open_bus_arbiter(const std::string & device_key, bool is_requested, BusArbiter ** arbiter);
+
+/** @brief Hold the device of a BusArbiter for the lifetime of the object, does nothing without arbitration */
+class BusArbiterLock
+{
+    private:
+
+        /** @brief Arbiter of the device, can be nullptr */
+        BusArbiter * arbiter;
+
+    public:
+
+        /**
+         * @brief Construct a new BusArbiterLock object and take the device
+         *
+         * @param _arbiter      Arbiter of the device, can be nullptr
+         */
+        explicit BusArbiterLock(BusArbiter * _arbiter) : arbiter(_arbiter) {if(arbiter != nullptr) {arbiter->lock();}};
+
+        /** @brief Destroy the BusArbiterLock object and give the device back */
+        ~BusArbiterLock() {if(arbiter != nullptr) {arbiter->unlock();}};
+
+        BusArbiterLock(const BusArbiterLock &) = delete;
+        BusArbiterLock & operator=(const BusArbiterLock &) = delete;
+};
+
+#endif
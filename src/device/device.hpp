@@ -6,6 +6,7 @@
 
 extern "C"
 #include "device_control_shared.h"
+#include "bus_arbiter.hpp"
 #include <memory>
 #include <iostream>
 
@@ -26,6 +27,12 @@ class Device
          */
         bool device_initialised = false;
 
+        /** @brief Arbitration enabled with enable_arbitration() */
+        bool arbitration_requested = false;
+
+        /** @brief Arbiter sharing the device with other processes, set by device_init() if the arbitration is enabled */
+        BusArbiter * arbiter = nullptr;
+
     public:
 
         /**
@@ -38,6 +45,21 @@ class Device
         /** @brief Initialise a host (master) interface */
         virtual control_ret_t device_init();
 
+        /**
+         * @brief Share the device with the other processes which enable the arbitration
+         *
+         * @note Has to be called before device_init(), the arbitration is also enabled by setting BUS_ARBITER_ENV to 1
+         * @see BusArbiter
+         */
+        void enable_arbitration() {arbitration_requested = true;};
+
+        /**
+         * @brief Get the arbiter of the device, to hold it for several transactions with BusArbiterLock
+         *
+         * @return              nullptr if the arbitration is not enabled
+         */
+        BusArbiter * get_arbiter() const {return arbiter;};
+
         /**
          * @brief Request to read from a controllable resource inside the device
          * 
@@ -18,18 +18,25 @@ control_ret_t Device::device_init()
     {
         ret = control_init_i2c(device_info[0]);
         device_initialised = true;
+        if(ret == CONTROL_SUCCESS)
+        {
+            // Each I2C address has its own lock, so several devices on the bus can be used in parallel
+            ret = open_bus_arbiter("i2c_" + to_string(device_info[0]), arbitration_requested, &arbiter);
+        }
     }
     return ret;
 }
 
 control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_read_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
 
 control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_write_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
@@ -38,6 +45,8 @@ Device::~Device()
 {
     if(device_initialised)
     {
+        delete arbiter;
+        arbiter = nullptr;
         control_cleanup_i2c();
         device_initialised = false;
     }
@@ -23,18 +23,24 @@ control_ret_t Device::device_init()
                                   static_cast<bcm2835SPIClockDivider>(device_info[1]),
                                   intertransaction_delay_ns);
         device_initialised = true;
+        if(ret == CONTROL_SUCCESS)
+        {
+            ret = open_bus_arbiter("spi", arbitration_requested, &arbiter);
+        }
     }
     return ret;
 }
 
 control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_read_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
 
 control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_write_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
@@ -43,6 +49,8 @@ Device::~Device()
 {
     if(device_initialised)
     {
+        delete arbiter;
+        arbiter = nullptr;
         control_cleanup_spi();
         device_initialised = false;
     }
@@ -29,7 +29,8 @@ control_ret_t Device::device_init()
             if(ret == CONTROL_SUCCESS)
             {
                 device_initialised = true;
-                cout << "Device (USB)::device_init() -- Found device VID: " << device_info[offset+1] << " PID: " << device_info[offset+2] << " interface: " << device_info[offset+3] << endl;
+                cerr << "Device (USB)::device_init() -- Found device VID: " << device_info[offset+1] << " PID: " << device_info[offset+2] << " interface: " << device_info[offset+3] << endl;
+                ret = open_bus_arbiter("usb_" + to_string(device_info[offset+1]) + "_" + to_string(device_info[offset+2]), arbitration_requested, &arbiter);
                 break;
             }
         }
@@ -48,12 +49,14 @@ control_ret_t Device::device_init()
 
 control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_read_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
 
 control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     control_ret_t ret = control_write_command(res_id, cmd_id, payload, payload_len);
     return ret;
 }
@@ -62,6 +65,8 @@ Device::~Device()
 {
     if(device_initialised)
     {
+        delete arbiter;
+        arbiter = nullptr;
         control_cleanup_usb();
         device_initialised = false;
     }
@@ -20,8 +20,12 @@ set(COMMON_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/dfu_main.cpp
     ${CMAKE_CURRENT_LIST_DIR}/dfu_commands.cpp
     ${CMAKE_CURRENT_LIST_DIR}/dfu_operations.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/dfu_multi_target.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/dfu_config_cache.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/dfu_telemetry.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../utils/utils.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../utils/platform_support.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../utils/app_options.cpp
 )
 set(COMMON_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/../utils
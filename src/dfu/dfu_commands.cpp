@@ -5,103 +5,102 @@
 
 using namespace std;
 
-control_ret_t CommandList::command_get(Device * device, string cmd_name, uint8_t * values)
+void CommandList::set_cmd_info(dfu_cmd_t cmd, int id, int length)
 {
-    int cmd_id = get_cmd_id(cmd_name) | 0x80; // setting 8th bit for read commands
-    size_t num_values = get_cmd_length(cmd_name);
-    size_t data_len = num_values + 1; // one extra for the status
-    uint8_t * data = new uint8_t[data_len];
+    commands[cmd].cmd_id = id;
+    commands[cmd].num_values = length;
+    commands[cmd].payload.assign(length + 1, 0); // one extra for the status
+}
 
-    control_ret_t ret = device->device_get(get_dfu_controller_servicer_resid(), cmd_id, data, data_len);
+control_ret_t CommandList::command_get(Device * device, dfu_cmd_t cmd, uint8_t * values)
+{
+    dfu_cmd_desc_t * desc = &commands[cmd];
+    control_cmd_t cmd_id = desc->cmd_id | 0x80; // setting 8th bit for read commands
+    size_t data_len = desc->num_values + 1; // one extra for the status
+    uint8_t * data = desc->payload.data();
+
+    control_ret_t ret = device->device_get(dfu_controller_servicer_resid, cmd_id, data, data_len);
     int read_attempts = 1;
 
     while(1)
     {
         if(read_attempts == 1000)
         {
-            cerr << "Resource could not respond to the " << cmd_name << " read command."
+            cerr << "Resource could not respond to the " << commandNames[cmd] << " read command."
             << endl << "Check the audio loop is active." << endl;
             exit(HOST_APP_ERROR);
         }
         if(data[0] == CONTROL_SUCCESS)
         {
-            for (unsigned i = 0; i < num_values; i++)
+            if(values != &data[1])
             {
-                memcpy(&values[i], &data[1] + i, 1);
+                memcpy(values, &data[1], desc->num_values);
             }
             break;
         }
         else if(data[0] == SERVICER_COMMAND_RETRY)
         {
-            ret = device->device_get(get_dfu_controller_servicer_resid(), cmd_id, data, data_len);
+            ret = device->device_get(dfu_controller_servicer_resid, cmd_id, data, data_len);
             read_attempts++;
         }
         else
         {
-            check_cmd_error(cmd_name, "read", static_cast<control_ret_t>(data[0]));
+            check_cmd_error(commandNames[cmd], "read", static_cast<control_ret_t>(data[0]));
         }
     }
 
-    delete []data;
-    check_cmd_error(cmd_name, "read", ret);
+    check_cmd_error(commandNames[cmd], "read", ret);
     return ret;
 };
 
-control_ret_t CommandList::command_set(Device * device, string cmd_name, uint8_t * values)
+control_ret_t CommandList::try_command_set(Device * device, dfu_cmd_t cmd, const uint8_t * values)
 {
-    int cmd_id = get_cmd_id(cmd_name); // setting 8th bit for read commands
-    size_t num_values = get_cmd_length(cmd_name);
-    size_t data_len = num_values;
-    uint8_t * data = new uint8_t[data_len];
+    dfu_cmd_desc_t * desc = &commands[cmd];
+    size_t data_len = desc->num_values;
+    uint8_t * data = &desc->payload[1];
 
-    for (unsigned i = 0; i < num_values; i++)
+    if(values != data)
     {
-        memcpy(data + i, &values[i], 1);
+        memcpy(data, values, data_len);
     }
 
-    control_ret_t ret = device->device_set(get_dfu_controller_servicer_resid(), cmd_id, data, data_len);
+    control_ret_t ret = device->device_set(dfu_controller_servicer_resid, desc->cmd_id, data, data_len);
     int write_attempts = 1;
 
-    while(1)
+    while(ret == SERVICER_COMMAND_RETRY)
     {
         if(write_attempts == 1000)
         {
-            cerr << "Resource could not respond to the " << cmd_name << " write command."
+            cerr << "Resource could not respond to the " << commandNames[cmd] << " write command."
             << endl << "Check the audio loop is active." << endl;
             exit(HOST_APP_ERROR);
         }
-        if(ret == CONTROL_SUCCESS)
-        {
-            break;
-        }
-        else if(ret == SERVICER_COMMAND_RETRY)
-        {
-            ret = device->device_set(get_dfu_controller_servicer_resid(), cmd_id, data, data_len);
-            write_attempts++;
-        }
-        else
-        {
-            check_cmd_error(cmd_name, "write", ret);
-        }
+        ret = device->device_set(dfu_controller_servicer_resid, desc->cmd_id, data, data_len);
+        write_attempts++;
     }
 
-    delete []data;
-    check_cmd_error(cmd_name, "write", ret);
     return ret;
 };
 
-void CommandList::add_command(YAML::Node yaml_info, const string cmd_name, uint8_t is_verbose)
+control_ret_t CommandList::command_set(Device * device, dfu_cmd_t cmd, const uint8_t * values)
+{
+    control_ret_t ret = try_command_set(device, cmd, values);
+    check_cmd_error(commandNames[cmd], "write", ret);
+    return ret;
+};
+
+void CommandList::add_command(YAML::Node yaml_info, dfu_cmd_t cmd, uint8_t is_verbose)
 {
+    const string cmd_name = commandNames[cmd];
     for (const auto& command : yaml_info)
     {
         if (command["cmd"].as<string>().find(cmd_name) != string::npos)
         {
             int cmd_id = command["index"].as<int>();
             int cmd_num_values = command["number_of_values"].as<int>();
-            set_cmd_id(cmd_name, cmd_id);
-            set_cmd_length(cmd_name, cmd_num_values);
+            set_cmd_info(cmd, cmd_id, cmd_num_values);
             if (is_verbose) {
-                cout << "Added command " << cmd_name << " with ID " << CommandIDs[cmd_name] << " and number of values " << cmd_num_values << endl;
+                cout << "Added command " << cmd_name << " with ID " << cmd_id << " and number of values " << cmd_num_values << endl;
             }
             return;
         }
@@ -136,13 +135,13 @@ void CommandList::parse_dfu_cmds_yaml(string yaml_file_full_path, uint8_t is_ver
         YAML::Node dedicated_commands = node.second["dedicated_commands"];
         if (dedicated_commands.IsSequence())
         {
-            for (const auto& cmd_name : commandNames)
+            for (int cmd = 0; cmd < DFU_NUM_COMMANDS; cmd++)
             {
-                add_command(dedicated_commands, cmd_name, is_verbose);
+                add_command(dedicated_commands, static_cast<dfu_cmd_t>(cmd), is_verbose);
             }
         }
     }
-    if (get_dfu_controller_servicer_resid() == -1)
+    if (get_dfu_controller_servicer_resid() == INVALID_DFU_CONTROLLER_SERVICER_RESID)
     {
         cerr << "DFU_CONTROLLER_SERVICER_RESID not set. Check the YAML file: " << yaml_file_full_path << endl;
         exit(HOST_APP_ERROR);
@@ -1,8 +1,11 @@
 // Copyright 2024 XMOS LIMITED.
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
+#ifndef DFU_COMMANDS_H_
+#define DFU_COMMANDS_H_
+
 #include "utils.hpp"
-#include <map>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 /**
@@ -49,6 +52,12 @@
 /** @brief Number of bytes used to indicate the length of the transfer block length */
 #define DFU_TRANSFER_BLOCK_LENGTH_BYTES 2
 
+/**
+ * @brief Maximum number of values of the DFU_DNLOAD command
+ * @note The device control protocol stores the payload length in a single byte
+ **/
+#define DFU_DNLOAD_MAX_LENGTH 255
+
 /** @brief Invalid value for transport block number */
 #define INVALID_TRANSPORT_BLOCK_NUM 0xFFFF
 
@@ -88,8 +97,31 @@ static const char *dfu_status_names[] = {
         "Device stalled an unexpected request"
 };
 
-/** @brief List of supported DFU commands */
-static std::string commandNames[] =
+/** @brief Value used to mark the DFU controller servicer resource ID as not set */
+#define INVALID_DFU_CONTROLLER_SERVICER_RESID 0xFFFF
+
+/**
+ * @brief List of supported DFU commands
+ * @note The order has to match commandNames
+ **/
+enum dfu_cmd_t
+{
+    DFU_DETACH,
+    DFU_DNLOAD,
+    DFU_UPLOAD,
+    DFU_GETSTATUS,
+    DFU_CLRSTATUS,
+    DFU_GETSTATE,
+    DFU_ABORT,
+    DFU_SETALTERNATE,
+    DFU_TRANSFERBLOCK,
+    DFU_GETVERSION,
+    DFU_REBOOT,
+    DFU_NUM_COMMANDS
+};
+
+/** @brief Names of the supported DFU commands, indexed by dfu_cmd_t */
+static const char * commandNames[DFU_NUM_COMMANDS] =
 {
     "DFU_DETACH",
     "DFU_DNLOAD",
@@ -104,38 +136,42 @@ static std::string commandNames[] =
     "DFU_REBOOT"
 };
 
-class CommandList
+/** @brief Information needed to send a single DFU command */
+struct dfu_cmd_desc_t
 {
+    /** Command ID */
+    control_cmd_t cmd_id;
+    /** Number of bytes the command reads/writes */
+    size_t num_values;
     /**
-    * @brief Dictionaries storing command IDs of the DFU commands
--   * @note The values are read from the DFU yaml file
-    **/
-    std::map<std::string, int>CommandIDs;
+     * @brief Payload buffer with one extra byte at the start for the read status
+     * @note The buffer is allocated once, when the command is added
+     **/
+    std::vector<uint8_t> payload;
+};
+
+class CommandList
+{
     /**
-    * @brief Dictionaries storing command lengths of the DFU commands
--   * @note The values are read from the DFU yaml file
+    * @brief Table of the DFU commands, indexed by dfu_cmd_t
+    * @note The values are read from the DFU yaml file
     **/
-    std::map<std::string, int>CommandLengths;
+    dfu_cmd_desc_t commands[DFU_NUM_COMMANDS] = {};
     /** @brief Resource ID of DFU controller servicer
     * @note The value is read from the DFU yaml file
     **/
-    uint16_t dfu_controller_servicer_resid;
+    uint16_t dfu_controller_servicer_resid = INVALID_DFU_CONTROLLER_SERVICER_RESID;
 
     public:
 
     /**
-    * @brief Set function for command ID
-    * @param cmd_name      Command name
+    * @brief Set function for command ID and length
+    * @param cmd           Command
     * @param id            Command ID
-    **/
-    void set_cmd_id(std::string cmd_name, int id) {CommandIDs[cmd_name] = id;};
-
-    /**
-    * @brief Set function for command length
-    * @param cmd_name      Command name
     * @param length        Command length
+    * @note This allocates the payload buffer of the command
     **/
-    void set_cmd_length(std::string cmd_name, int length) {CommandLengths[cmd_name] = length;};
+    void set_cmd_info(dfu_cmd_t cmd, int id, int length);
 
     /**
     * @brief Set function for DFU controller servicer resource ID
@@ -145,46 +181,75 @@ class CommandList
 
     /**
     * @brief Get function for command ID
-    * @param cmd_name      Command name
+    * @param cmd           Command
     *
     * @return              Command ID
     **/
-    int get_cmd_id(std::string cmd_name) {return CommandIDs[cmd_name];};
+    int get_cmd_id(dfu_cmd_t cmd) const {return commands[cmd].cmd_id;};
 
     /**
     * @brief Get function for command length
-    * @param cmd_name      Command name
+    * @param cmd           Command
     *
     * @return              Command length
     **/
-    int get_cmd_length(std::string cmd_name) {return CommandLengths[cmd_name];};
+    int get_cmd_length(dfu_cmd_t cmd) const {return commands[cmd].num_values;};
+
+    /**
+    * @brief Get function for command name
+    * @param cmd           Command
+    *
+    * @return              Command name
+    **/
+    const char * get_cmd_name(dfu_cmd_t cmd) const {return commandNames[cmd];};
+
+    /**
+    * @brief Get the preallocated buffer for the command values
+    * @param cmd           Command
+    *
+    * @return              Buffer of get_cmd_length() bytes
+    * @note Passing this buffer to command_get() and command_set() avoids copying the values
+    **/
+    uint8_t * get_cmd_values(dfu_cmd_t cmd) {return &commands[cmd].payload[1];};
+
     /**
     * @brief Get function for DFU controller servicer resource ID
     *
     * @return               Resource ID
     **/
-    uint16_t get_dfu_controller_servicer_resid() {return dfu_controller_servicer_resid;};
+    uint16_t get_dfu_controller_servicer_resid() const {return dfu_controller_servicer_resid;};
 
     /**
     * @brief Executes a single get command
      *
     * @param device        Pointer to the Device class object
-    * @param cmd_name      Command name
+    * @param cmd           Command
     * @param values        Buffer storing the read values
     *
     * @return              device control status
     */
-    control_ret_t command_get(Device * device, std::string cmd_name, uint8_t * values);
+    control_ret_t command_get(Device * device, dfu_cmd_t cmd, uint8_t * values);
 
     /**
     * @brief Executes a single set command
      *
     * @param device        Pointer to the Device class object
-    * @param cmd_name      Command name
+    * @param cmd           Command
     * @param values        Buffer storing the values to write
     * @return              device control status
     */
-    control_ret_t command_set(Device * device, std::string cmd_name, uint8_t * values);
+    control_ret_t command_set(Device * device, dfu_cmd_t cmd, const uint8_t * values);
+
+    /**
+    * @brief Executes a single set command and returns the device errors to the caller
+     *
+    * @param device        Pointer to the Device class object
+    * @param cmd           Command
+    * @param values        Buffer storing the values to write
+    * @return              device control status
+    * @note Unlike command_set(), the application is not terminated if the device rejects the command
+    */
+    control_ret_t try_command_set(Device * device, dfu_cmd_t cmd, const uint8_t * values);
 
     /**
     * @brief Parse a YAML file with the list of DFU commands
@@ -195,11 +260,13 @@ class CommandList
     void parse_dfu_cmds_yaml(std::string yaml_file_full_path, uint8_t is_verbose=0);
 
     /**
-    * @brief Add a command with a given name to the list of commands
+    * @brief Add a command to the list of commands
      *
     * @param yaml_info     Data read from YAML file
-    * @param cmd_name      Command name
+    * @param cmd           Command
     * @param is_verbose    Flag to indicate if verbose mode is enabled
     */
-    void add_command(YAML::Node yaml_info, const std::string cmd_name, uint8_t is_verbose=0);
+    void add_command(YAML::Node yaml_info, dfu_cmd_t cmd, uint8_t is_verbose=0);
 };
+
+#endif
@@ -0,0 +1,227 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include <chrono>
+#include <cstdio>           // rename, remove
+#include <fstream>
+#include <fcntl.h>          // open
+#include <unistd.h>         // close, getpid
+#include <sys/mman.h>       // mmap
+#include <sys/stat.h>       // stat
+#include "dfu_config_cache.hpp"
+
+using namespace std;
+
+/** @brief Magic number at the start of the cache, "XDFC" */
+#define DFU_CONFIG_CACHE_MAGIC 0x43464458
+
+/** @brief Version of the cache layout, increment it when changing any of the structures below */
+#define DFU_CONFIG_CACHE_VERSION 1
+
+/** @brief Information used to detect changes of a YAML file */
+struct dfu_file_key_t
+{
+    /** Modification time in nanoseconds */
+    int64_t mtime_ns;
+    /** Size in bytes */
+    uint64_t size;
+    /** FNV-1a hash of the content */
+    uint64_t hash;
+};
+
+/** @brief Header of the cache */
+struct dfu_config_cache_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    dfu_file_key_t transport_key;
+    dfu_file_key_t cmds_key;
+    int32_t i2c_address;
+    int32_t spi_mode;
+    uint16_t dfu_controller_servicer_resid;
+    uint16_t num_commands;
+};
+
+/** @brief Single command entry of the cache, the entries follow the header in dfu_cmd_t order */
+struct dfu_config_cache_cmd_t
+{
+    uint16_t cmd_id;
+    uint16_t num_values;
+};
+
+/**
+ * @brief Computes the key of a file
+ *
+ * @return true if the file could be read, false otherwise
+ */
+static bool get_file_key(const string path, dfu_file_key_t &key)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    key.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    key.size = st.st_size;
+
+    ifstream rf(path, ios::in | ios::binary);
+    if (!rf) {
+        return false;
+    }
+    uint64_t hash = 0xcbf29ce484222325; // FNV-1a offset basis
+    char buffer[4096];
+    while (rf) {
+        rf.read(buffer, sizeof(buffer));
+        for (streamsize i = 0; i < rf.gcount(); i++) {
+            hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 0x100000001b3; // FNV-1a prime
+        }
+    }
+    key.hash = hash;
+    return true;
+}
+
+static bool keys_match(const dfu_file_key_t &a, const dfu_file_key_t &b)
+{
+    return (a.mtime_ns == b.mtime_ns) && (a.size == b.size) && (a.hash == b.hash);
+}
+
+bool load_dfu_config_cache(const string cache_path, const string transport_path, const string cmds_path,
+                           dfu_transport_config_t &transport, CommandList* command_list)
+{
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    const size_t expected_size = sizeof(dfu_config_cache_header_t) + DFU_NUM_COMMANDS * sizeof(dfu_config_cache_cmd_t);
+    if ((fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) != expected_size)) {
+        close(fd);
+        return false;
+    }
+    void * map = mmap(NULL, expected_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    bool is_valid = false;
+    const dfu_config_cache_header_t * header = static_cast<const dfu_config_cache_header_t *>(map);
+    dfu_file_key_t transport_key, cmds_key;
+    if ((header->magic == DFU_CONFIG_CACHE_MAGIC) &&
+        (header->version == DFU_CONFIG_CACHE_VERSION) &&
+        (header->num_commands == DFU_NUM_COMMANDS) &&
+        get_file_key(transport_path, transport_key) && keys_match(transport_key, header->transport_key) &&
+        get_file_key(cmds_path, cmds_key) && keys_match(cmds_key, header->cmds_key))
+    {
+        transport.i2c_address = header->i2c_address;
+        transport.spi_mode = header->spi_mode;
+        command_list->set_dfu_controller_servicer_resid(header->dfu_controller_servicer_resid);
+        const dfu_config_cache_cmd_t * cmds = reinterpret_cast<const dfu_config_cache_cmd_t *>(header + 1);
+        for (int cmd = 0; cmd < DFU_NUM_COMMANDS; cmd++)
+        {
+            command_list->set_cmd_info(static_cast<dfu_cmd_t>(cmd), cmds[cmd].cmd_id, cmds[cmd].num_values);
+        }
+        is_valid = true;
+    }
+    munmap(map, expected_size);
+    return is_valid;
+}
+
+bool save_dfu_config_cache(const string cache_path, const string transport_path, const string cmds_path,
+                           const dfu_transport_config_t &transport, const CommandList* command_list)
+{
+    dfu_config_cache_header_t header = {};
+    header.magic = DFU_CONFIG_CACHE_MAGIC;
+    header.version = DFU_CONFIG_CACHE_VERSION;
+    if (!get_file_key(transport_path, header.transport_key) || !get_file_key(cmds_path, header.cmds_key)) {
+        return false;
+    }
+    header.i2c_address = transport.i2c_address;
+    header.spi_mode = transport.spi_mode;
+    header.dfu_controller_servicer_resid = command_list->get_dfu_controller_servicer_resid();
+    header.num_commands = DFU_NUM_COMMANDS;
+
+    // Write into a temporary file first, so a reader never sees a partially written cache
+    const string tmp_path = cache_path + "." + to_string(getpid());
+    ofstream wf(tmp_path, ios::out | ios::binary | ios::trunc);
+    if (!wf) {
+        return false;
+    }
+    wf.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int cmd = 0; cmd < DFU_NUM_COMMANDS; cmd++)
+    {
+        dfu_config_cache_cmd_t entry;
+        entry.cmd_id = command_list->get_cmd_id(static_cast<dfu_cmd_t>(cmd));
+        entry.num_values = command_list->get_cmd_length(static_cast<dfu_cmd_t>(cmd));
+        wf.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    }
+    wf.close();
+    if (!wf.good() || (rename(tmp_path.c_str(), cache_path.c_str()) != 0)) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** @brief Exits if the file is not found */
+static void check_yaml_file_found(const string path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        cerr << "File \'" << path << "\' not found" << endl;
+        exit(HOST_APP_ERROR);
+    }
+}
+
+bool load_dfu_transport_config(const string config_dir, dfu_transport_config_t &transport, CommandList* command_list, uint8_t is_verbose)
+{
+    const string transport_path = config_dir + "/" + DFU_TRANSPORT_CONFIG_YAML;
+    const string cmds_path = config_dir + "/" + DFU_CMDS_YAML;
+    const string cache_path = config_dir + "/" + DFU_CONFIG_CACHE;
+    auto start = chrono::steady_clock::now();
+
+    if (load_dfu_config_cache(cache_path, transport_path, cmds_path, transport, command_list))
+    {
+        if (is_verbose) {
+            auto elapsed_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+            cout << "Loaded DFU configuration from " << cache_path << " in " << elapsed_us << " us" << endl;
+        }
+        return true;
+    }
+
+    // Load YAML file with transport settings
+    if (is_verbose) {
+        cout << "Parsing YAML file " << transport_path << endl;
+    }
+    check_yaml_file_found(transport_path);
+    YAML::Node config = YAML::LoadFile(transport_path);
+    transport.i2c_address = config["I2C_ADDRESS"].as<int>();
+    transport.spi_mode = config["SPI_MODE"].as<int>();
+    return false;
+}
+
+void load_dfu_cmds_config(const string config_dir, const dfu_transport_config_t &transport, CommandList* command_list, bool is_cached, uint8_t is_verbose)
+{
+    if (is_cached) {
+        return;
+    }
+    const string transport_path = config_dir + "/" + DFU_TRANSPORT_CONFIG_YAML;
+    const string cmds_path = config_dir + "/" + DFU_CMDS_YAML;
+    const string cache_path = config_dir + "/" + DFU_CONFIG_CACHE;
+    auto start = chrono::steady_clock::now();
+
+    // Load YAML file with DFU commands info
+    if (is_verbose) {
+        cout << "Parsing YAML file " << cmds_path << endl;
+    }
+    check_yaml_file_found(cmds_path);
+    command_list->parse_dfu_cmds_yaml(cmds_path, is_verbose);
+
+    if (is_verbose) {
+        auto elapsed_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        cout << "Parsed YAML file " << cmds_path << " in " << elapsed_us << " us" << endl;
+    }
+    // The cache is only an optimisation, so failing to write it is not an error
+    if (!save_dfu_config_cache(cache_path, transport_path, cmds_path, transport, command_list) && is_verbose) {
+        cout << "Could not write " << cache_path << endl;
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef DFU_CONFIG_CACHE_H_
+#define DFU_CONFIG_CACHE_H_
+
+#include "dfu_commands.hpp"
+
+/** @brief Name of the transport configuration YAML file */
+#define DFU_TRANSPORT_CONFIG_YAML "transport_config.yaml"
+
+/** @brief Name of the DFU commands YAML file */
+#define DFU_CMDS_YAML "dfu_cmds.yaml"
+
+/** @brief Name of the binary cache of the YAML files */
+#define DFU_CONFIG_CACHE "dfu_config.cache"
+
+/** @brief Transport settings read from the transport configuration YAML file */
+struct dfu_transport_config_t
+{
+    /** I2C address of the device */
+    int i2c_address;
+    /** SPI mode */
+    int spi_mode;
+};
+
+/**
+ * @brief Loads the transport settings of the DFU configuration
+ *
+ * The configuration is loaded from a binary cache if the cache matches the modification time,
+ * size and hash of both YAML files, in which case the command list is filled as well.
+ * Otherwise only the transport configuration YAML file is parsed.
+ *
+ * @param config_dir    Directory storing the YAML files and the cache
+ * @param transport     Transport settings read from the configuration
+ * @param command_list  Pointer to the CommandList class object to fill
+ * @param is_verbose    Flag to indicate if verbose mode is enabled
+ *
+ * @return              true if the configuration has been loaded from the cache, false otherwise
+ * @note Will exit if the YAML file is not found
+ */
+bool load_dfu_transport_config(const std::string config_dir, dfu_transport_config_t &transport, CommandList* command_list, uint8_t is_verbose);
+
+/**
+ * @brief Loads the DFU commands of the DFU configuration
+ *
+ * If the configuration has not been loaded from the cache, the DFU commands YAML file is parsed
+ * and the cache is rewritten.
+ *
+ * @param config_dir    Directory storing the YAML files and the cache
+ * @param transport     Transport settings returned by load_dfu_transport_config()
+ * @param command_list  Pointer to the CommandList class object to fill
+ * @param is_cached     Value returned by load_dfu_transport_config()
+ * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @note Will exit if the YAML file is not found
+ */
+void load_dfu_cmds_config(const std::string config_dir, const dfu_transport_config_t &transport, CommandList* command_list, bool is_cached, uint8_t is_verbose);
+
+/**
+ * @brief Loads the DFU configuration from the binary cache
+ *
+ * @param cache_path        Path to the cache
+ * @param transport_path    Path to the transport configuration YAML file
+ * @param cmds_path         Path to the DFU commands YAML file
+ * @param transport         Transport settings read from the cache
+ * @param command_list      Pointer to the CommandList class object to fill
+ *
+ * @return                  true if the cache is valid and has been loaded, false otherwise
+ */
+bool load_dfu_config_cache(const std::string cache_path, const std::string transport_path, const std::string cmds_path,
+                           dfu_transport_config_t &transport, CommandList* command_list);
+
+/**
+ * @brief Writes the DFU configuration into the binary cache
+ *
+ * @param cache_path        Path to the cache
+ * @param transport_path    Path to the transport configuration YAML file
+ * @param cmds_path         Path to the DFU commands YAML file
+ * @param transport         Transport settings to store
+ * @param command_list      Pointer to the CommandList class object to store
+ *
+ * @return                  true if the cache has been written, false otherwise
+ */
+bool save_dfu_config_cache(const std::string cache_path, const std::string transport_path, const std::string cmds_path,
+                           const dfu_transport_config_t &transport, const CommandList* command_list);
+
+#endif
@@ -1,7 +1,9 @@
 // Copyright 2024 XMOS LIMITED.
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
-#include "dfu_operations.hpp"
+#include "dfu_multi_target.hpp"
+#include "dfu_config_cache.hpp"
+#include "app_options.hpp"
 #include <sys/stat.h> // stat
 
 using namespace std;
@@ -18,6 +20,10 @@ opt_t options[] = {
     {"--upload-factory",          "-uf",       "upload factory image and save it in the specified path"                                                             },
     {"--upload-upgrade",          "-uu",       "upload upgrade image and save it in the specified path"                                                             },
     {"--reboot",                  "-r",        "reboot device"                                                                                                      },
+    {"--targets",                 "-t",        "comma-separated list of I2C addresses to update in parallel, e.g. 0x2C,0x2D. Option valid only with download and reboot commands. Each target is rebooted after the download"},
+    {"--block-size",              "-bs",       "largest transfer block size in bytes to try for the download, or max. If the device rejects it, smaller sizes are tried down to the size in dfu_cmds.yaml. Option valid only with download commands"},
+    {"--telemetry",               "-tm",       "save throughput, per-block latency and status polling statistics of the transfer in the specified JSON file. Option valid only with download and upload commands"},
+    {"--bus-lock",                "-bl",       "share the device with the other applications which use --bus-lock or set XVF_BUS_ARBITRATION=1, and hold it for the whole DFU session. The time spent waiting for it is printed at the end"},
 };
 size_t num_options = end(options) - begin(options);
 
@@ -137,17 +143,103 @@ uint16_t check_upload_start(int * argc, char ** argv)
 
     return stoi(block_number_str);
 }
-int main(int argc, char ** argv)
+
+vector<int> check_targets(int * argc, char ** argv)
+{
+    opt_t * opt = option_lookup("--targets", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, opt);
+    // return an empty list if the targets option is not found
+    if (index == 0) {
+        return vector<int>();
+    }
+    if (index + 1 >= *argc)
+    {
+        cerr << "Missing list of targets" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    vector<int> addresses = parse_dfu_targets(argv[index + 1]);
+    remove_opt(argc, argv, index, 2);
+
+    return addresses;
+}
+
+string check_telemetry(int * argc, char ** argv)
+{
+    opt_t * opt = option_lookup("--telemetry", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, opt);
+    // return an empty path if the telemetry option is not found
+    if (index == 0) {
+        return "";
+    }
+    if (index + 1 >= *argc)
+    {
+        cerr << "Missing telemetry report path" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    string report_path = argv[index + 1];
+    remove_opt(argc, argv, index, 2);
+
+    return report_path;
+}
+
+bool check_bus_lock(int * argc, char ** argv)
+{
+    opt_t * opt = option_lookup("--bus-lock", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, opt);
+    if (index == 0) {
+        return false;
+    }
+    remove_opt(argc, argv, index, 1);
+    return true;
+}
+
+size_t check_block_size(int * argc, char ** argv)
+{
+    opt_t * opt = option_lookup("--block-size", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, opt);
+    // return 0 if the block-size option is not found, so the size from the yaml file is used
+    if (index == 0) {
+        return 0;
+    }
+    if (index + 1 >= *argc)
+    {
+        cerr << "Missing block size" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const size_t max_block_size = DFU_DNLOAD_MAX_LENGTH - DFU_TRANSFER_BLOCK_LENGTH_BYTES;
+    string block_size_str = argv[index + 1];
+    size_t block_size = 0;
+    if (block_size_str == "max") {
+        block_size = max_block_size;
+    } else {
+        if (!isdigit(block_size_str[0])) {
+            cerr << "Value for block size is not an integer. Given value: " << block_size_str << endl;
+            exit(HOST_APP_ERROR);
+        }
+        block_size = stoul(block_size_str);
+        if (block_size == 0 || block_size > max_block_size)
+        {
+            cerr << "Block size must be between 1 and " << max_block_size << ". Given value: " << block_size_str << endl;
+            exit(HOST_APP_ERROR);
+        }
+    }
+    remove_opt(argc, argv, index, 2);
+
+    return block_size;
+}
+
+/** @brief Run the application, errors from the device layer are thrown as host_app_error */
+static int run_dfu_app(int argc, char ** argv)
 {
     if(argc == 1)
     {
         cout << "Use --help to get the list of options for this application." << endl;
         return 0;
     }
-    YAML::Node config;
     int* i2c_info = new int[1];
     int* spi_info = new int[2];
-    string yaml_file_name;
+    CommandList* command_list = new CommandList();
+    dfu_transport_config_t transport;
 
     // Check if --use option is used
     string device_dl_name = get_device_lib_name(&argc, argv, options, num_options);
@@ -160,22 +252,17 @@ int main(int argc, char ** argv)
     // Check other optional arguments
     uint8_t is_verbose = check_verbose(&argc, argv);
     uint16_t start_block_number = check_upload_start(&argc, argv);
+    vector<int> target_addresses = check_targets(&argc, argv);
+    string report_path = check_telemetry(&argc, argv);
+    size_t block_size = check_block_size(&argc, argv);
+    bool bus_lock = check_bus_lock(&argc, argv);
 
-    // Load YAML file with transport settings
-    yaml_file_name = get_executable_path() + "/transport_config.yaml";
-    if (is_verbose) {
-        cout << "Parsing YAML file " << yaml_file_name << endl;
-    }
-    if (is_file_found(yaml_file_name)) {
-        config = YAML::LoadFile(yaml_file_name);
-        // Read I2C parameters from YAML file
-        i2c_info[0] = config["I2C_ADDRESS"].as<int>();
-        spi_info[0] = config["SPI_MODE"].as<int>();
-        spi_info[1] = 1024;
-    } else {
-        cerr << "File \'" << yaml_file_name << "\' not found" << endl;
-        exit(HOST_APP_ERROR);
-    }
+    // Load transport settings, from the binary cache if it is up to date
+    const string config_dir = get_executable_path();
+    bool is_config_cached = load_dfu_transport_config(config_dir, transport, command_list, is_verbose);
+    i2c_info[0] = transport.i2c_address;
+    spi_info[0] = transport.spi_mode;
+    spi_info[1] = 1024;
 
     // Check first CLI commands which don't require access to the device
     const opt_t * opt = nullptr;
@@ -195,6 +282,66 @@ int main(int argc, char ** argv)
         }
     }
 
+    // Run the operation on several targets, each target opens its own connection to the device
+    if (!target_addresses.empty())
+    {
+        if(next_cmd[0] != '-')
+        {
+            cerr << "Missing command for the targets" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        opt = option_lookup(next_cmd, options, num_options);
+        if (opt->long_name != "--download" && opt->long_name != "--reboot")
+        {
+            cerr << "Option --targets is valid only with download and reboot commands" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        if (start_block_number != INVALID_TRANSPORT_BLOCK_NUM)
+        {
+            cerr << "Option--upload-start is valid only with upload commands" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        if (!report_path.empty() && opt->long_name != "--download")
+        {
+            cerr << "Option --telemetry is valid only with download and upload commands" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        if (block_size != 0 && opt->long_name != "--download")
+        {
+            cerr << "Option --block-size is valid only with download commands" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        load_dfu_cmds_config(config_dir, transport, command_list, is_config_cached, is_verbose);
+
+        uint8_t * image = nullptr;
+        size_t image_size = 0;
+        dfu_multi_op_t op = DFU_MULTI_REBOOT;
+        if (opt->long_name == "--download")
+        {
+            int arg_indx = cmd_indx + 1;
+            if (arg_indx >= argc)
+            {
+                cerr << "Missing file path" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            // The image is read only once and shared by all the targets
+            image = load_shared_image(argv[arg_indx], image_size);
+            if (image == nullptr) {
+                return -1;
+            }
+            cout << "Download upgrade image " << argv[arg_indx] << " to " << target_addresses.size() << " targets" << endl;
+            op = DFU_MULTI_DOWNLOAD;
+        }
+
+        string device_dl_path = get_dynamic_lib_path(device_dl_name);
+        dl_handle_t device_handle = get_dynamic_lib(device_dl_path);
+        device_fptr make_dev = get_device_fptr(device_handle);
+
+        control_ret_t ret = multi_target_operation(make_dev, command_list, target_addresses, op, image, image_size, is_verbose, report_path, block_size, bus_lock);
+        release_shared_image(image, image_size);
+        return (ret == CONTROL_SUCCESS) ? 0 : HOST_APP_ERROR;
+    }
+
     // Load dynamic library with transport drivers
     int * device_init_info = NULL;
     if(device_dl_name == device_i2c_dl_name)
@@ -209,6 +356,9 @@ int main(int argc, char ** argv)
 
     device_fptr make_dev = get_device_fptr(device_handle);
     Device * device = make_dev(device_init_info);
+    if (bus_lock) {
+        device->enable_arbitration();
+    }
 
     control_ret_t ret = device->device_init();
     if (ret != CONTROL_SUCCESS)
@@ -216,18 +366,10 @@ int main(int argc, char ** argv)
         cerr << "Could not connect to the device: error " << ret << endl;
         exit(HOST_APP_ERROR);
     }
-    CommandList* command_list = new CommandList();
-    // Load YAML file with DFU commands info
-    yaml_file_name = get_executable_path() + "/dfu_cmds.yaml";
-    if (is_verbose) {
-        cout << "Parsing YAML file " << yaml_file_name << endl;
-    }
-    if (is_file_found(yaml_file_name)) {
-        command_list->parse_dfu_cmds_yaml(yaml_file_name, is_verbose);
-    } else {
-        cerr << "File \'" << yaml_file_name << "\' not found" << endl;
-        exit(HOST_APP_ERROR);
-    }
+    // Hold the device for the whole session, so the transactions of other processes can't corrupt it
+    BusArbiterLock section(device->get_arbiter());
+    // Load DFU commands info, unless already loaded from the binary cache
+    load_dfu_cmds_config(config_dir, transport, command_list, is_config_cached, is_verbose);
 
     // Check CLI options which require access to the device
     next_cmd = argv[cmd_indx];
@@ -244,6 +386,20 @@ int main(int argc, char ** argv)
                 exit(HOST_APP_ERROR);
             }
         }
+        // Check if block-size is used in combination with download commands
+        if (block_size != 0 && opt->long_name != "--download")
+        {
+            cerr << "Option --block-size is valid only with download commands" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        // Check if telemetry is used in combination with transfer commands
+        if (!report_path.empty()) {
+            if (opt->long_name != "--download" && opt->long_name != "--upload-factory" && opt->long_name != "--upload-upgrade")
+            {
+                cerr << "Option --telemetry is valid only with download and upload commands" << endl;
+                exit(HOST_APP_ERROR);
+            }
+        }
 
         if (opt->long_name == "--version")
         {
@@ -273,7 +429,7 @@ int main(int argc, char ** argv)
                 image_path = argv[arg_indx];
             }
             if (is_file_found(image_path)) {
-                download_operation(device, command_list, image_path, is_verbose);
+                download_operation(device, command_list, image_path, is_verbose, report_path, block_size);
             } else {
                 cerr << "File at path \'" << argv[arg_indx] << "\' not found" << endl;
                 return -1;
@@ -297,11 +453,28 @@ int main(int argc, char ** argv)
                 set_transport_block(device, command_list, start_block_number, is_verbose);
             }
             if (!is_file_found(image_path)) {
-                upload_operation(device, command_list, image_path, is_verbose);
+                upload_operation(device, command_list, image_path, is_verbose, report_path);
             } else {
                 cerr << "File at path \'" << argv[arg_indx] << "\' already exists" << endl;
                 return -1;
             }
         }
     }
+    if (device->get_arbiter() != nullptr) {
+        print_bus_arbiter_stats(device->get_arbiter()->get_stats(), cout);
+    }
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    try
+    {
+        return run_dfu_app(argc, argv);
+    }
+    catch(const host_app_error & e)
+    {
+        cerr << e.what() << endl;
+        return e.code;
+    }
 }
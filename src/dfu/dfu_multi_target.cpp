@@ -0,0 +1,234 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>         // fork
+#include <sys/mman.h>       // mmap
+#include <sys/wait.h>       // waitpid
+#include "dfu_multi_target.hpp"
+
+using namespace std;
+
+/** @brief Maximum value of a 7-bit I2C address */
+#define I2C_MAX_ADDRESS 0x7F
+
+/** @brief State of a single target of the multi-target operation */
+struct dfu_target_t
+{
+    /** I2C address of the target */
+    int address;
+    /** ID of the process handling the target */
+    pid_t pid;
+    /** Exit status of the process handling the target */
+    int exit_code;
+};
+
+vector<int> parse_dfu_targets(const string targets_str)
+{
+    vector<int> addresses;
+    stringstream ss(targets_str);
+    string address_str;
+    while (getline(ss, address_str, ','))
+    {
+        if (address_str.empty()) {
+            continue;
+        }
+        int address = -1;
+        try {
+            size_t pos = 0;
+            address = stoi(address_str, &pos, 0);
+            if (pos != address_str.length()) {
+                address = -1;
+            }
+        }
+        catch(const exception & ex)
+        {
+            static_cast<void>(ex);
+        }
+        if ((address < 0) || (address > I2C_MAX_ADDRESS)) {
+            cerr << "Target " << address_str << " is not a valid I2C address" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        for (int other : addresses) {
+            if (other == address) {
+                cerr << "Target " << address_str << " is given more than once" << endl;
+                exit(HOST_APP_ERROR);
+            }
+        }
+        addresses.push_back(address);
+    }
+    if (addresses.empty()) {
+        cerr << "Missing list of targets" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    return addresses;
+}
+
+uint8_t * load_shared_image(const string image_path, size_t &image_size)
+{
+    ifstream rf(image_path, ios::in | ios::binary);
+    if(!rf) {
+        cerr << "Cannot open file " << image_path << endl;
+        return nullptr;
+    }
+    rf.seekg (0, ios::end);
+    image_size = rf.tellg();
+    rf.seekg (0, ios::beg);
+
+    // mmap() does not accept zero length mappings
+    size_t map_size = (image_size) ? image_size : 1;
+    void * image = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (image == MAP_FAILED) {
+        cerr << "Could not allocate " << image_size << " bytes of shared memory" << endl;
+        return nullptr;
+    }
+    rf.read(static_cast<char *>(image), image_size);
+    if (!rf) {
+        cerr << "Could not read file " << image_path << endl;
+        munmap(image, map_size);
+        return nullptr;
+    }
+    rf.close();
+    // The image is only read from now on
+    mprotect(image, map_size, PROT_READ);
+    return static_cast<uint8_t *>(image);
+}
+
+void release_shared_image(uint8_t * image, size_t image_size)
+{
+    if (image != nullptr) {
+        munmap(image, (image_size) ? image_size : 1);
+    }
+}
+
+/**
+ * @brief Runs the DFU state machine for a single target
+ *
+ * @note This runs in the child process, the return value is used as exit status
+ */
+static int run_target(device_fptr make_dev, CommandList* command_list, int address,
+                      dfu_multi_op_t op, const uint8_t * image, size_t image_size, uint8_t is_verbose,
+                      const string report_path, size_t block_size, bool bus_lock)
+{
+    stringstream address_ss;
+    address_ss << "0x" << hex << uppercase << address;
+    const string prefix = "[" + address_ss.str() + "] ";
+
+    // The device object is created here, so each target has its own connection,
+    // make_Dev keeps the pointer which is valid until the child exits
+    int device_info[1] = {address};
+    Device * device = make_dev(device_info);
+    if (bus_lock) {
+        device->enable_arbitration();
+    }
+    control_ret_t ret = device->device_init();
+    if (ret != CONTROL_SUCCESS)
+    {
+        cerr << prefix << "Could not connect to the device: error " << ret << endl;
+        return HOST_APP_ERROR;
+    }
+    BusArbiterLock section(device->get_arbiter());
+
+    ret = set_alternate(device, command_list, DFU_ALT_UPGRADE_ID, is_verbose);
+    if (ret != CONTROL_SUCCESS) {
+        return ret;
+    }
+    if (!state_is_idle(device, command_list, is_verbose)) {
+        cerr << prefix << "Device is not in dfuIDLE state" << endl;
+        return HOST_APP_ERROR;
+    }
+    if (op == DFU_MULTI_DOWNLOAD)
+    {
+        cout << prefix << "Download upgrade image of " << image_size << " bytes" << endl;
+        DfuTelemetry telemetry("download", image_size);
+        ret = download_image(device, command_list, image, image_size, is_verbose, prefix, &telemetry, block_size);
+        if (ret != CONTROL_SUCCESS) {
+            return ret;
+        }
+        if (!report_path.empty()) {
+            // Add the address before the extension of the file name
+            string target_report_path = report_path;
+            size_t ext_pos = target_report_path.find_last_of('.');
+            size_t dir_pos = target_report_path.find_last_of('/');
+            if (ext_pos == string::npos || (dir_pos != string::npos && ext_pos < dir_pos)) {
+                ext_pos = target_report_path.length();
+            }
+            target_report_path.insert(ext_pos, "_" + address_ss.str());
+            if (!telemetry.write_json(target_report_path)) {
+                return HOST_APP_ERROR;
+            }
+            cout << prefix << "Telemetry report saved in " << target_report_path << endl;
+        }
+    }
+    ret = reboot_operation(device, command_list, is_verbose, prefix);
+    if (device->get_arbiter() != nullptr) {
+        print_bus_arbiter_stats(device->get_arbiter()->get_stats(), cout, prefix);
+    }
+    return ret;
+}
+
+control_ret_t multi_target_operation(device_fptr make_dev, CommandList* command_list, const vector<int> &addresses,
+                                     dfu_multi_op_t op, const uint8_t * image, size_t image_size, uint8_t is_verbose,
+                                     const string report_path, size_t block_size, bool bus_lock)
+{
+    vector<dfu_target_t> targets;
+    auto start = chrono::steady_clock::now();
+
+    // Flush the output before forking, so the buffered text is not printed by each child
+    cout << flush;
+    cerr << flush;
+    for (int address : addresses)
+    {
+        dfu_target_t target = {address, -1, HOST_APP_ERROR};
+        target.pid = fork();
+        if (target.pid == 0)
+        {
+            int ret = run_target(make_dev, command_list, address, op, image, image_size, is_verbose, report_path, block_size, bus_lock);
+            cout << flush;
+            cerr << flush;
+            _exit(ret & 0xFF);
+        }
+        if (target.pid < 0)
+        {
+            cerr << "Could not start the process for target 0x" << hex << address << dec << endl;
+        }
+        targets.push_back(target);
+    }
+
+    for (dfu_target_t &target : targets)
+    {
+        if (target.pid < 0) {
+            continue;
+        }
+        int status;
+        if (waitpid(target.pid, &status, 0) == target.pid)
+        {
+            if (WIFEXITED(status)) {
+                target.exit_code = WEXITSTATUS(status);
+            } else if (WIFSIGNALED(status)) {
+                target.exit_code = 128 + WTERMSIG(status);
+            }
+        }
+    }
+    auto elapsed_ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    size_t num_failed = 0;
+    cout << endl << "Summary:" << endl;
+    for (const dfu_target_t &target : targets)
+    {
+        cout << "  0x" << hex << uppercase << target.address << dec << ": ";
+        if (target.exit_code == 0) {
+            cout << "OK" << endl;
+        } else {
+            cout << "FAILED (exit code " << target.exit_code << ")" << endl;
+            num_failed++;
+        }
+    }
+    cout << targets.size() - num_failed << " of " << targets.size() << " targets "
+    << ((op == DFU_MULTI_DOWNLOAD) ? "updated" : "rebooted") << " in "
+    << elapsed_ms / 1000.0 << " s" << endl;
+
+    return (num_failed == 0) ? CONTROL_SUCCESS : CONTROL_ERROR;
+}
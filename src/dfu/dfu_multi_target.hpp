@@ -0,0 +1,71 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef DFU_MULTI_TARGET_H_
+#define DFU_MULTI_TARGET_H_
+
+#include "dfu_operations.hpp"
+#include <vector>
+
+/** @brief DFU operations which can be run on several targets at once */
+enum dfu_multi_op_t {DFU_MULTI_DOWNLOAD, DFU_MULTI_REBOOT};
+
+/**
+ * @brief Parses a comma-separated list of I2C addresses
+ *
+ * @param targets_str   String with the list of addresses, e.g. "0x2C,0x2D"
+ *
+ * @return              List of I2C addresses
+ * @note Will exit if any of the addresses is not valid
+ */
+std::vector<int> parse_dfu_targets(const std::string targets_str);
+
+/**
+ * @brief Reads an image into a shared memory buffer
+ *
+ * The buffer is mapped before any target process is created, so all the targets
+ * read the same physical pages and the file is read from the disk only once.
+ *
+ * @param image_path    Path to the image to read
+ * @param image_size    Size of the image in bytes
+ *
+ * @return              Pointer to the image, nullptr if the image could not be read
+ */
+uint8_t * load_shared_image(const std::string image_path, size_t &image_size);
+
+/**
+ * @brief Releases the buffer returned by load_shared_image()
+ *
+ * @param image         Pointer to the image
+ * @param image_size    Size of the image in bytes
+ */
+void release_shared_image(uint8_t * image, size_t image_size);
+
+/**
+ * @brief Runs a DFU operation on several I2C targets concurrently
+ *
+ * Each target is handled by a separate process which owns its own device connection,
+ * so a failure on one target does not abort the others.
+ * The download operation is followed by a reboot of the target, so the new image is
+ * running on all the successful targets once the operation has completed.
+ *
+ * @param make_dev      Function pointer to make_Dev() from the device shared object
+ * @param command_list  Pointer to the CommandList class object
+ * @param addresses     List of I2C addresses of the targets
+ * @param op            Operation to run on each target
+ * @param image         Pointer to the image to download, only used by DFU_MULTI_DOWNLOAD
+ * @param image_size    Size of the image in bytes
+ * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param report_path   Path to the JSON telemetry report, no report is written if empty
+ * @param block_size    Largest transfer block size to try in bytes, 0 to use the size from the DFU yaml file
+ * @param bus_lock      Share each target with other processes, it is held for the whole session of the target
+ * @note Each target writes its own telemetry report, the I2C address is added to the file name,
+ * e.g. report_0x2C.json
+ *
+ * @return              CONTROL_SUCCESS if all targets succeeded, CONTROL_ERROR otherwise
+ */
+control_ret_t multi_target_operation(device_fptr make_dev, CommandList* command_list, const std::vector<int> &addresses,
+                                     dfu_multi_op_t op, const uint8_t * image, size_t image_size, uint8_t is_verbose, const std::string report_path = "",
+                                     size_t block_size = 0, bool bus_lock = false);
+
+#endif
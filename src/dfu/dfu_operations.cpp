@@ -63,17 +63,21 @@ const string dfu_status_to_string(int status)
     return string(dfu_status_names[status]);
 }
 
-control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &status, uint8_t &state, uint8_t is_verbose)
+control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &status, uint8_t &state, uint8_t is_verbose, DfuTelemetry * telemetry)
 {
 
-    const string cmd_name = "DFU_GETSTATUS";
-    uint8_t values[command_list->get_cmd_length(cmd_name)];
+    const dfu_cmd_t cmd = DFU_GETSTATUS;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     if (is_verbose) {
         cout << "Send DFU_GETSTATUS message" << endl;
     }
-    control_ret_t cmd_ret = command_list->command_get(device, cmd_name, values);
+    auto poll_start = chrono::steady_clock::now();
+    control_ret_t cmd_ret = command_list->command_get(device, cmd, values);
+    if (telemetry != nullptr) {
+        telemetry->status_polled(poll_start, chrono::steady_clock::now());
+    }
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
     status = values[0];
@@ -85,7 +89,12 @@ control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &st
         cout << "DFU_GETSTATUS: Status: " << dfu_status_to_string(status) << ", State: " << dfu_state_to_string(state) << ", Timeout (ms) " << poll_timeout << endl;
     }
 
+    // Time spent waiting for the device is accounted separately from the time spent on the bus
+    auto sleep_start = chrono::steady_clock::now();
     std::this_thread::sleep_for(std::chrono::milliseconds(poll_timeout));
+    if (telemetry != nullptr) {
+        telemetry->poll_slept(sleep_start);
+    }
 
     return cmd_ret;
 }
@@ -93,13 +102,12 @@ control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &st
 control_ret_t clear_status(Device * device, CommandList* command_list, uint8_t is_verbose)
 {
     control_ret_t cmd_ret = CONTROL_SUCCESS;
-    string cmd_name = "DFU_CLRSTATUS";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t values[num_values];
+    const dfu_cmd_t cmd = DFU_CLRSTATUS;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     cout << "Send DFU_CLRSTATUS message" << endl;
-    cmd_ret = command_list->command_set(device, cmd_name, values);
+    cmd_ret = command_list->command_set(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
 
@@ -132,23 +140,23 @@ uint32_t state_is_idle(Device * device, CommandList* command_list, uint8_t is_ve
 control_ret_t set_alternate(Device * device, CommandList* command_list, uint8_t alternate, uint8_t is_verbose)
 {
     control_ret_t cmd_ret = CONTROL_SUCCESS;
-    string cmd_name = "DFU_SETALTERNATE";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t values[num_values];
+    const dfu_cmd_t cmd = DFU_SETALTERNATE;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     values[0] = alternate;
     if (is_verbose) {
         cout << "Send DFU_SETALTERNATE message with value " << unsigned(alternate) << endl;
     }
-    cmd_ret = command_list->command_set(device, cmd_name, values);
+    cmd_ret = command_list->command_set(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
 
     return cmd_ret;
 }
 
-control_ret_t download_operation(Device * device, CommandList* command_list, const string image_path, uint8_t is_verbose)
+control_ret_t download_operation(Device * device, CommandList* command_list, const string image_path, uint8_t is_verbose,
+                                 const string report_path, size_t block_size)
 {
     cout << "Download upgrade image " << image_path << endl;
     ifstream rf(image_path, ios::in | ios::binary);
@@ -156,47 +164,161 @@ control_ret_t download_operation(Device * device, CommandList* command_list, con
         cout << "Cannot open file!" << endl;
         return CONTROL_ERROR;
     }
-    uint8_t status;
-    uint8_t state;
     // Read file size
     rf.seekg (0, ios::end);
     size_t file_size = rf.tellg();
     // Set position to the beginning of the file
     rf.seekg (0, ios::beg);
+    uint8_t * image = new uint8_t[file_size];
+    rf.read((char*) image, file_size);
+    rf.close();
+
+    DfuTelemetry telemetry("download", file_size);
+    control_ret_t cmd_ret = download_image(device, command_list, image, file_size, is_verbose, "", &telemetry, block_size);
+    delete []image;
+    if (cmd_ret == CONTROL_SUCCESS && !report_path.empty()) {
+        if (!telemetry.write_json(report_path)) {
+            return CONTROL_ERROR;
+        }
+        cout << "Telemetry report saved in " << report_path << endl;
+    }
+    return cmd_ret;
+}
+
+/**
+ * @brief Get the transfer block sizes to try for a download, from the largest to the smallest
+ *
+ * @param default_size  Transfer block size from the DFU yaml file
+ * @param block_size    Largest transfer block size requested by the user, 0 if not set
+ *
+ * @return              List of block sizes, the last one is always the default one
+ */
+static vector<size_t> get_block_size_candidates(size_t default_size, size_t block_size)
+{
+    vector<size_t> candidates;
+    const size_t max_block_size = DFU_DNLOAD_MAX_LENGTH - DFU_TRANSFER_BLOCK_LENGTH_BYTES;
+    block_size = (block_size > max_block_size) ? max_block_size : block_size;
+    if (block_size != 0 && block_size < default_size) {
+        // A smaller size than the default one is used as it is
+        candidates.push_back(block_size);
+        return candidates;
+    }
+    while (block_size > default_size) {
+        candidates.push_back(block_size);
+        block_size = block_size * 3 / 4;
+    }
+    candidates.push_back(default_size);
+    return candidates;
+}
+
+/** @brief Give a command the length from the DFU yaml file back when the object goes out of scope */
+class CmdLengthRestore
+{
+    private:
+
+        CommandList * command_list;
+        const dfu_cmd_t cmd;
+        const int length;
+
+    public:
+
+        CmdLengthRestore(CommandList * _command_list, dfu_cmd_t _cmd) :
+            command_list(_command_list), cmd(_cmd), length(_command_list->get_cmd_length(_cmd)) {};
+
+        ~CmdLengthRestore()
+        {
+            if (command_list->get_cmd_length(cmd) != length) {
+                command_list->set_cmd_info(cmd, command_list->get_cmd_id(cmd), length);
+            }
+        };
+};
+
+control_ret_t download_image(Device * device, CommandList* command_list, const uint8_t * image, size_t image_size, uint8_t is_verbose,
+                             const string log_prefix, DfuTelemetry * telemetry, size_t block_size)
+{
+    uint8_t status;
+    uint8_t state;
     uint32_t total_bytes = 0;
     control_ret_t cmd_ret = CONTROL_SUCCESS;
     uint8_t is_state_not_dn_idle = 1;
-    string cmd_name = "DFU_DNLOAD";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t * values = new uint8_t[num_values];
-    const uint32_t transfer_block_size = num_values - DFU_TRANSFER_BLOCK_LENGTH_BYTES;
-    while (rf.good()) {
+    const dfu_cmd_t cmd = DFU_DNLOAD;
+    const int cmd_id = command_list->get_cmd_id(cmd);
+    const uint8_t default_num_values = command_list->get_cmd_length(cmd);
+    // The negotiated block size only applies to this download, the later operations use the one from the DFU yaml file
+    CmdLengthRestore length_restore(command_list, cmd);
+    vector<size_t> block_sizes = get_block_size_candidates(default_num_values - DFU_TRANSFER_BLOCK_LENGTH_BYTES, block_size);
+    size_t block_size_indx = 0;
+    // Block size is only negotiated with the first block, the following ones use the accepted size
+    bool is_negotiating = block_sizes.size() > 1;
+    uint32_t transfer_block_size = block_sizes[block_size_indx];
+    uint8_t num_values = transfer_block_size + DFU_TRANSFER_BLOCK_LENGTH_BYTES;
+    if (num_values != default_num_values) {
+        command_list->set_cmd_info(cmd, cmd_id, num_values);
+    }
+    uint8_t * values = command_list->get_cmd_values(cmd);
+    // When several targets share the terminal, progress is printed on separate lines every 10%
+    const bool is_multi_target = !log_prefix.empty();
+    uint32_t next_progress_step = 0;
+    // Progress line is based on the telemetry, so keep a local one if the caller doesn't need the report
+    DfuTelemetry local_telemetry("download", image_size);
+    if (telemetry == nullptr) {
+        telemetry = &local_telemetry;
+    }
+    // As with the file stream, the last block is sent once the end of the image has been reached
+    while (total_bytes <= image_size) {
 
         for (int i=0; i<DFU_TRANSFER_BLOCK_LENGTH_BYTES; i++)
         {
             values[i] = (transfer_block_size>>8*i) & 0xFF;
         }
-        rf.read((char*) &values[DFU_TRANSFER_BLOCK_LENGTH_BYTES], transfer_block_size);
+        size_t bytes_left = image_size - total_bytes;
+        size_t bytes_to_copy = (bytes_left < transfer_block_size) ? bytes_left : transfer_block_size;
+        memcpy(&values[DFU_TRANSFER_BLOCK_LENGTH_BYTES], &image[total_bytes], bytes_to_copy);
         is_state_not_dn_idle = 1;
         if (is_verbose) {
-            cout << "Send DFU_DNLOAD message with " << transfer_block_size << " bytes" << endl;
+            cout << log_prefix << "Send DFU_DNLOAD message with " << transfer_block_size << " bytes" << endl;
+        }
+        telemetry->block_start();
+        auto transfer_start = chrono::steady_clock::now();
+        if (is_negotiating) {
+            cmd_ret = command_list->try_command_set(device, cmd, values);
+            if (cmd_ret != CONTROL_SUCCESS && block_size_indx + 1 < block_sizes.size()) {
+                cout << log_prefix << "Block size of " << transfer_block_size << " bytes rejected with error " << cmd_ret
+                << ", try " << block_sizes[block_size_indx + 1] << " bytes" << endl;
+                // Leave the error state, if the device has entered it
+                if (get_status(device, command_list, status, state, is_verbose) == CONTROL_SUCCESS && state == DFU_STATE_dfuERROR) {
+                    clear_status(device, command_list, is_verbose);
+                }
+                telemetry->block_rejected();
+                block_size_indx++;
+                transfer_block_size = block_sizes[block_size_indx];
+                num_values = transfer_block_size + DFU_TRANSFER_BLOCK_LENGTH_BYTES;
+                command_list->set_cmd_info(cmd, cmd_id, num_values);
+                values = command_list->get_cmd_values(cmd);
+                continue;
+            }
+            check_cmd_error(command_list->get_cmd_name(cmd), "write", cmd_ret);
+            cout << log_prefix << "Using block size of " << transfer_block_size << " bytes" << endl;
+            is_negotiating = false;
+        } else {
+            cmd_ret = command_list->command_set(device, cmd, values);
         }
-        cmd_ret = command_list->command_set(device, cmd_name, values);
         if (cmd_ret != CONTROL_SUCCESS) {
-            cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+            cerr << log_prefix << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
             return cmd_ret;
         }
+        telemetry->block_transferred(bytes_to_copy, transfer_start);
         // Wait till device is in state dfuDNLOAD_IDLE
         while (is_state_not_dn_idle)
         {
-            if (get_status(device, command_list, status, state, is_verbose) ==  CONTROL_SUCCESS)
+            if (get_status(device, command_list, status, state, is_verbose, telemetry) ==  CONTROL_SUCCESS)
             {
                 switch(state) {
                     case DFU_STATE_dfuDNLOAD_IDLE:
                         is_state_not_dn_idle = 0;
                     break;
                     case DFU_STATE_dfuERROR:
-                        cerr << "DFU_GETSTATUS returned: Status: " << dfu_status_to_string(status) << ", State: " << dfu_state_to_string(state) << endl;
+                        cerr << log_prefix << "DFU_GETSTATUS returned: Status: " << dfu_status_to_string(status) << ", State: " << dfu_state_to_string(state) << endl;
                         clear_status(device, command_list, is_verbose);
                         exit(HOST_APP_ERROR);
                     break;
@@ -206,24 +328,34 @@ control_ret_t download_operation(Device * device, CommandList* command_list, con
                 }
             }
         }
-        cout << setprecision(2) << fixed;
-        cout << "\rDownloaded " << (float) total_bytes / file_size * 100 << "% of the image" << std::flush;
-        if (is_verbose) {
-            cout << endl;
-        }
+        telemetry->block_end();
         total_bytes += transfer_block_size;
+        const bool is_last_block = total_bytes > image_size;
+        if (is_multi_target) {
+            float progress = (image_size) ? (float) telemetry->get_total_bytes() / image_size * 100 : 100;
+            if (progress >= next_progress_step) {
+                cout << setprecision(2) << fixed << log_prefix << "Downloaded " << progress << "% of the image, "
+                << telemetry->get_throughput() / 1024 << " KiB/s" << endl;
+                next_progress_step += 10;
+            }
+        } else {
+            // The line is refreshed at most every 100 ms, unless every block is logged anyway
+            if (telemetry->print_live(cout, is_verbose || is_last_block) && is_verbose) {
+                cout << endl;
+            }
+        }
+    }
+    telemetry->finish();
+    if (!is_multi_target) {
+        cout << endl;
     }
-    cout << endl;
-
-
-    rf.close();
 
     // Send empty download message
-    cout << "Download completed. Send DFU_DNLOAD message with size zero" << endl;
-    memset(values, 0, command_list->get_cmd_length(cmd_name));
-    cmd_ret = command_list->command_set(device, cmd_name, values);
+    cout << log_prefix << "Download completed. Send DFU_DNLOAD message with size zero" << endl;
+    memset(values, 0, num_values);
+    cmd_ret = command_list->command_set(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << log_prefix << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
 
@@ -233,18 +365,18 @@ control_ret_t download_operation(Device * device, CommandList* command_list, con
     return CONTROL_SUCCESS;
 }
 
-control_ret_t upload_operation(Device * device, CommandList* command_list, const string image_path, uint8_t is_verbose)
+control_ret_t upload_operation(Device * device, CommandList* command_list, const string image_path, uint8_t is_verbose, const string report_path)
 {
     cout << "Uploading image to " << image_path << endl;
     ofstream wf(image_path, ios::out | ios::binary);
 
-    string cmd_name = "DFU_UPLOAD";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t values[num_values];
-    uint32_t transfer_block_num = 0;
+    const dfu_cmd_t cmd = DFU_UPLOAD;
+    uint8_t num_values = command_list->get_cmd_length(cmd);
+    uint8_t * values = command_list->get_cmd_values(cmd);
     uint32_t transfer_ongoing = 1;
     uint32_t transfer_block_size = 0;
     const uint16_t dfu_data_buffer_size = num_values - DFU_TRANSFER_BLOCK_LENGTH_BYTES;
+    DfuTelemetry telemetry("upload");
 
     if(!wf) {
         cout << "Cannot open file!" << endl;
@@ -255,53 +387,64 @@ control_ret_t upload_operation(Device * device, CommandList* command_list, const
         if (is_verbose) {
             cout << "Send DFU_UPLOAD message" << endl;
         }
-        control_ret_t cmd_ret = command_list->command_get(device, cmd_name, values);
+        telemetry.block_start();
+        auto transfer_start = chrono::steady_clock::now();
+        control_ret_t cmd_ret = command_list->command_get(device, cmd, values);
         if (cmd_ret != CONTROL_SUCCESS) {
-            cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+            cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
             return cmd_ret;
         }
         for (int i=0; i<DFU_TRANSFER_BLOCK_LENGTH_BYTES; i++)
         {
             transfer_block_size |= (values[i] << 8*i);
         }
+        telemetry.block_transferred(transfer_block_size, transfer_start);
         if (transfer_block_size) {
-            cout << "\rUploaded " << transfer_block_num+1 << " blocks of " << transfer_block_size << " bytes" << std::flush;
             wf.write((const char *) &values[DFU_TRANSFER_BLOCK_LENGTH_BYTES], transfer_block_size);
         }
-        if (is_verbose) {
-            cout << endl;
-        }
+        telemetry.block_end();
         // Wait till we receive a DFU_UPLOAD with no data
         if (transfer_block_size < dfu_data_buffer_size) {
-            cout << "\nReceived transport block with size " << transfer_block_size << " (smaller than "<< dfu_data_buffer_size << "): upload complete" << endl;
             transfer_ongoing = 0;
         }
-        transfer_block_num++;
+        // The line is refreshed at most every 100 ms, unless every block is logged anyway
+        if (telemetry.print_live(cout, is_verbose || !transfer_ongoing) && is_verbose) {
+            cout << endl;
+        }
+        if (!transfer_ongoing) {
+            cout << "\nReceived transport block with size " << transfer_block_size << " (smaller than "<< dfu_data_buffer_size << "): upload complete" << endl;
+        }
 
     }
+    telemetry.finish();
 
     wf.close();
     if(!wf.good()) {
         cerr << "Writing to file " << image_path << " failed" << endl;
         return CONTROL_ERROR;
     }
+    if (!report_path.empty()) {
+        if (!telemetry.write_json(report_path)) {
+            return CONTROL_ERROR;
+        }
+        cout << "Telemetry report saved in " << report_path << endl;
+    }
     return CONTROL_SUCCESS;
 }
 
-control_ret_t reboot_operation(Device * device, CommandList* command_list, uint8_t is_verbose)
+control_ret_t reboot_operation(Device * device, CommandList* command_list, uint8_t is_verbose, const string log_prefix)
 {
-    cout << "Reboot device" << endl;
+    cout << log_prefix << "Reboot device" << endl;
     control_ret_t cmd_ret = CONTROL_SUCCESS;
 
-    string cmd_name = "DFU_DETACH";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t values[num_values];
+    const dfu_cmd_t cmd = DFU_DETACH;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     if (is_verbose) {
-        cout << "Send DFU_DETACH message" << endl;
+        cout << log_prefix << "Send DFU_DETACH message" << endl;
     }
-    cmd_ret = command_list->command_set(device, cmd_name, values);
+    cmd_ret = command_list->command_set(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << log_prefix << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
 
@@ -313,18 +456,17 @@ control_ret_t set_transport_block(Device * device, CommandList* command_list, ui
     cout << "Set transport block number " << block_number << endl;
     control_ret_t cmd_ret = CONTROL_SUCCESS;
 
-    string cmd_name = "DFU_TRANSFERBLOCK";
-    uint8_t num_values = command_list->get_cmd_length(cmd_name);
-    uint8_t values[num_values];
+    const dfu_cmd_t cmd = DFU_TRANSFERBLOCK;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     values[0] = block_number&0xFF;
     values[1] = block_number>>8;
 
     if (is_verbose) {
         cout << "Send DFU_TRANSFERBLOCK message" << endl;
     }
-    cmd_ret = command_list->command_set(device, cmd_name, values);
+    cmd_ret = command_list->command_set(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
 
@@ -334,18 +476,18 @@ control_ret_t set_transport_block(Device * device, CommandList* command_list, ui
 control_ret_t get_version(Device * device, CommandList* command_list, uint8_t is_verbose)
 {
 
-    const string cmd_name = "DFU_GETVERSION";
-    uint8_t values[command_list->get_cmd_length(cmd_name)];
+    const dfu_cmd_t cmd = DFU_GETVERSION;
+    uint8_t * values = command_list->get_cmd_values(cmd);
     if (is_verbose) {
         cout << "Send DFU_GETVERSION message" << endl;
     }
-    control_ret_t cmd_ret = command_list->command_get(device, cmd_name, values);
+    control_ret_t cmd_ret = command_list->command_get(device, cmd, values);
     if (cmd_ret != CONTROL_SUCCESS) {
-        cerr << "Command " << cmd_name << " returned error " << cmd_ret << endl;
+        cerr << "Command " << command_list->get_cmd_name(cmd) << " returned error " << cmd_ret << endl;
         return cmd_ret;
     }
     cout << "DFU_GETVERSION: ";
-    for (int i=0; i<command_list->get_cmd_length(cmd_name); i++) {
+    for (int i=0; i<command_list->get_cmd_length(cmd); i++) {
         cout << unsigned(values[i]) << " ";
     }
     cout << endl;
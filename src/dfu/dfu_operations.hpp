@@ -1,7 +1,11 @@
 // Copyright 2024 XMOS LIMITED.
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
+#ifndef DFU_OPERATIONS_H_
+#define DFU_OPERATIONS_H_
+
 #include "dfu_commands.hpp"
+#include "dfu_telemetry.hpp"
 #include <iomanip>          // setprecision
 
 /**
@@ -28,10 +32,11 @@ const std::string dfu_status_to_string(int status);
  * @param status        Status read from the device
  * @param state         State read from the device
  * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param telemetry     Pointer to the DfuTelemetry object recording the transaction and the poll timeout, can be NULL
  *
  * @return              device control status
  */
-control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &status, uint8_t &state, uint8_t is_verbose);
+control_ret_t get_status(Device * device, CommandList* command_list, uint8_t &status, uint8_t &state, uint8_t is_verbose, DfuTelemetry * telemetry = nullptr);
 
 /**
  * @brief Executes a CLRSTATUS request
@@ -72,22 +77,47 @@ control_ret_t set_alternate(Device * device, CommandList* command_list, uint8_t
  * @param command_list  Pointer to the CommandList class object
  * @param image_path    Path to the image to download to the device
  * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param report_path   Path to the JSON telemetry report, no report is written if empty
+ * @param block_size    Largest transfer block size to try in bytes, 0 to use the size from the DFU yaml file
  *
  * @return              device control status
  */
-control_ret_t download_operation(Device * device, CommandList* command_list, const std::string image_path, uint8_t is_verbose);
+control_ret_t download_operation(Device * device, CommandList* command_list, const std::string image_path, uint8_t is_verbose,
+                                 const std::string report_path = "", size_t block_size = 0);
 
 /**
- * @brief Executes a download operation
+ * @brief Downloads an image which is already stored in memory
+ *
+ * @param device        Pointer to the Device class object
+ * @param command_list  Pointer to the CommandList class object
+ * @param image         Pointer to the image to download to the device
+ * @param image_size    Size of the image in bytes
+ * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param log_prefix    String printed at the start of each line, used to tell targets apart
+ * @param telemetry     Pointer to the DfuTelemetry object collecting the timing of the transfer, can be NULL
+ * @param block_size    Largest transfer block size to try in bytes, 0 to use the size from the DFU yaml file
+ * @note If log_prefix is not empty, the progress is printed on a new line every 10%
+ * @note If block_size is larger than the size from the DFU yaml file, the first block is sent with
+ * descending block sizes, a quarter smaller each time, until the device accepts one. The size from the
+ * DFU yaml file is always the last one tried.
+ *
+ * @return              device control status
+ */
+control_ret_t download_image(Device * device, CommandList* command_list, const uint8_t * image, size_t image_size, uint8_t is_verbose,
+                             const std::string log_prefix = "", DfuTelemetry * telemetry = nullptr, size_t block_size = 0);
+
+/**
+ * @brief Executes an upload operation
  *
  * @param device        Pointer to the Device class object
  * @param command_list  Pointer to the CommandList class object
  * @param image_path    Path to the image to upload from the device
  * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param report_path   Path to the JSON telemetry report, no report is written if empty
  *
  * @return              device control status
  */
-control_ret_t upload_operation(Device * device, CommandList* command_list, const std::string image_path, uint8_t is_verbose);
+control_ret_t upload_operation(Device * device, CommandList* command_list, const std::string image_path, uint8_t is_verbose, const std::string report_path = "");
 
 /**
  * @brief Executes a reboot operation
@@ -95,10 +125,11 @@ control_ret_t upload_operation(Device * device, CommandList* command_list, const
  * @param device        Pointer to the Device class object
  * @param command_list  Pointer to the CommandList class object
  * @param is_verbose    Flag to indicate if verbose mode is enabled
+ * @param log_prefix    String printed at the start of each line, used to tell targets apart
  *
  * @return              device control status
  */
-control_ret_t reboot_operation(Device * device, CommandList* command_list, uint8_t is_verbose);
+control_ret_t reboot_operation(Device * device, CommandList* command_list, uint8_t is_verbose, const std::string log_prefix = "");
 
 /**
  * @brief Sets a transport block number
@@ -122,3 +153,5 @@ control_ret_t set_transport_block(Device * device, CommandList* command_list, ui
  * @return              device control status
  */
 control_ret_t get_version(Device * device, CommandList* command_list, uint8_t is_verbose);
+
+#endif
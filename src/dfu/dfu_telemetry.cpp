@@ -0,0 +1,159 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include <fstream>
+#include <iomanip>
+#include "dfu_telemetry.hpp"
+
+using namespace std;
+
+/** @brief Minimum time between two prints of the live line */
+static const chrono::milliseconds live_print_period(100);
+
+uint64_t DfuTelemetry::to_ns(clock_t::duration d)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(d).count();
+}
+
+DfuTelemetry::DfuTelemetry(const string _operation, size_t _expected_bytes) :
+    operation(_operation), expected_bytes(_expected_bytes)
+{
+    start_time = clock_t::now();
+    block_start_time = start_time;
+    last_print_time = start_time - live_print_period;
+    end_time = start_time;
+}
+
+void DfuTelemetry::block_start()
+{
+    block_start_time = clock_t::now();
+}
+
+void DfuTelemetry::block_transferred(size_t bytes, clock_t::time_point start)
+{
+    uint64_t ns = to_ns(clock_t::now() - start);
+    transfer_ns += ns;
+    max_transfer_ns = (ns > max_transfer_ns) ? ns : max_transfer_ns;
+    total_bytes += bytes;
+}
+
+void DfuTelemetry::status_polled(clock_t::time_point start, clock_t::time_point end)
+{
+    poll_ns += to_ns(end - start);
+    num_polls++;
+}
+
+void DfuTelemetry::poll_slept(clock_t::time_point start)
+{
+    sleep_ns += to_ns(clock_t::now() - start);
+}
+
+void DfuTelemetry::block_end()
+{
+    uint64_t ns = to_ns(clock_t::now() - block_start_time);
+    min_block_ns = (ns < min_block_ns) ? ns : min_block_ns;
+    max_block_ns = (ns > max_block_ns) ? ns : max_block_ns;
+    sum_block_ns += ns;
+    uint64_t us = ns / 1000;
+    size_t bucket = 0;
+    while ((bucket < DFU_LATENCY_HISTOGRAM_BUCKETS - 1) && (us >= (1ULL << bucket)))
+    {
+        bucket++;
+    }
+    latency_histogram[bucket]++;
+    num_blocks++;
+}
+
+void DfuTelemetry::block_rejected()
+{
+    rejected_ns += to_ns(clock_t::now() - block_start_time);
+    num_rejected++;
+}
+
+void DfuTelemetry::finish()
+{
+    end_time = clock_t::now();
+}
+
+double DfuTelemetry::get_throughput() const
+{
+    clock_t::time_point end = (end_time > start_time) ? end_time : clock_t::now();
+    double elapsed_s = (to_ns(end - start_time) - rejected_ns) / 1e9;
+    return (elapsed_s > 0) ? total_bytes / elapsed_s : 0;
+}
+
+bool DfuTelemetry::print_live(ostream &os, bool force)
+{
+    clock_t::time_point now = clock_t::now();
+    if (!force && (now - last_print_time < live_print_period)) {
+        return false;
+    }
+    last_print_time = now;
+    double throughput = get_throughput();
+
+    os << setprecision(2) << fixed << "\r";
+    if (expected_bytes) {
+        os << "Downloaded " << static_cast<float>(total_bytes) / expected_bytes * 100 << "% of the image, ";
+    } else {
+        os << "Uploaded " << total_bytes << " bytes, ";
+    }
+    os << throughput / 1024 << " KiB/s";
+    if (expected_bytes && (throughput > 0)) {
+        double eta_s = (total_bytes < expected_bytes) ? (expected_bytes - total_bytes) / throughput : 0;
+        os << ", ETA " << setprecision(1) << eta_s << " s";
+    }
+    // Clear what is left from a longer previous line
+    os << "    " << flush;
+    return true;
+}
+
+bool DfuTelemetry::write_json(const string path) const
+{
+    ofstream wf(path, ios::out | ios::trunc);
+    if (!wf) {
+        cerr << "Could not open a file " << path << endl;
+        return false;
+    }
+    clock_t::time_point end = (end_time > start_time) ? end_time : clock_t::now();
+    double mean_block_us = (num_blocks) ? (sum_block_ns / 1e3) / num_blocks : 0;
+
+    wf << setprecision(6) << fixed;
+    wf << "{" << endl
+    << "  \"operation\": \"" << operation << "\"," << endl
+    << "  \"total_bytes\": " << total_bytes << "," << endl
+    << "  \"blocks\": " << num_blocks << "," << endl
+    << "  \"elapsed_s\": " << to_ns(end - start_time) / 1e9 << "," << endl
+    << "  \"throughput_bytes_per_s\": " << get_throughput() << "," << endl
+    << "  \"transfer\": {\"total_s\": " << transfer_ns / 1e9
+    << ", \"max_block_us\": " << max_transfer_ns / 1e3 << "}," << endl
+    << "  \"status_polls\": {\"count\": " << num_polls
+    << ", \"transaction_s\": " << poll_ns / 1e9
+    << ", \"sleep_s\": " << sleep_ns / 1e9 << "}," << endl
+    << "  \"rejected_blocks\": {\"count\": " << num_rejected
+    << ", \"total_s\": " << rejected_ns / 1e9 << "}," << endl
+    << "  \"block_latency_us\": {" << endl
+    << "    \"min\": " << ((num_blocks) ? min_block_ns / 1e3 : 0) << "," << endl
+    << "    \"mean\": " << mean_block_us << "," << endl
+    << "    \"max\": " << max_block_ns / 1e3 << "," << endl
+    << "    \"histogram\": [";
+    for (size_t i = 0; i < DFU_LATENCY_HISTOGRAM_BUCKETS; i++)
+    {
+        wf << ((i) ? ", " : "") << "{\"lt_us\": ";
+        if (i == DFU_LATENCY_HISTOGRAM_BUCKETS - 1) {
+            wf << "null";
+        } else {
+            wf << (1ULL << i);
+        }
+        wf << ", \"count\": " << latency_histogram[i] << "}";
+    }
+    wf << "]" << endl
+    << "  }" << endl
+    << "}" << endl;
+
+    wf.close();
+    if (wf.bad()) {
+        cerr << "Error occurred when writing to " << path << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,168 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef DFU_TELEMETRY_H_
+#define DFU_TELEMETRY_H_
+
+#include <chrono>
+#include <string>
+#include <iostream>
+
+/** @brief Number of buckets of the block latency histogram */
+#define DFU_LATENCY_HISTOGRAM_BUCKETS 24
+
+/**
+ * @brief Class for collecting timing information of the DFU transfer loops
+ *
+ * The time spent sending or receiving data, the time spent on DFU_GETSTATUS transactions
+ * and the time spent sleeping for the poll timeout requested by the device are accounted separately.
+ */
+class DfuTelemetry
+{
+    private:
+
+        /** @brief Clock used for all the measurements */
+        using clock_t = std::chrono::steady_clock;
+
+        /** @brief Name of the operation, e.g. download */
+        std::string operation;
+
+        /** @brief Number of bytes expected to be transferred, 0 if not known */
+        size_t expected_bytes;
+
+        /** @brief Start time of the operation */
+        clock_t::time_point start_time;
+
+        /** @brief Start time of the current block */
+        clock_t::time_point block_start_time;
+
+        /** @brief Time when the live line was last printed */
+        clock_t::time_point last_print_time;
+
+        /** @brief End time of the operation */
+        clock_t::time_point end_time;
+
+        /** @brief Number of bytes transferred */
+        size_t total_bytes = 0;
+
+        /** @brief Number of blocks transferred */
+        size_t num_blocks = 0;
+
+        /** @brief Total time spent sending or receiving data in nanoseconds */
+        uint64_t transfer_ns = 0;
+
+        /** @brief Number of DFU_GETSTATUS transactions */
+        size_t num_polls = 0;
+
+        /** @brief Total time spent on DFU_GETSTATUS transactions in nanoseconds */
+        uint64_t poll_ns = 0;
+
+        /** @brief Total time spent sleeping for the device poll timeout in nanoseconds */
+        uint64_t sleep_ns = 0;
+
+        /** @brief Number of blocks rejected by the device */
+        size_t num_rejected = 0;
+
+        /** @brief Total time spent on the rejected blocks in nanoseconds */
+        uint64_t rejected_ns = 0;
+
+        /** @brief Shortest block latency in nanoseconds */
+        uint64_t min_block_ns = UINT64_MAX;
+
+        /** @brief Longest block latency in nanoseconds */
+        uint64_t max_block_ns = 0;
+
+        /** @brief Sum of all the block latencies in nanoseconds */
+        uint64_t sum_block_ns = 0;
+
+        /** @brief Longest data transaction of a single block in nanoseconds */
+        uint64_t max_transfer_ns = 0;
+
+        /**
+         * @brief Histogram of the block latencies
+         *
+         * Bucket i counts the blocks which took less than 2^i microseconds,
+         * the last bucket counts all the longer blocks as well.
+         */
+        size_t latency_histogram[DFU_LATENCY_HISTOGRAM_BUCKETS] = {0};
+
+        /** @brief Convert a duration to nanoseconds */
+        static uint64_t to_ns(clock_t::duration d);
+
+    public:
+
+        /**
+         * @brief Construct a new DfuTelemetry object and start the operation timer
+         *
+         * @param _operation        Name of the operation
+         * @param _expected_bytes   Number of bytes expected to be transferred, 0 if not known
+         */
+        DfuTelemetry(const std::string _operation, size_t _expected_bytes = 0);
+
+        /** @brief Mark the start of a new block */
+        void block_start();
+
+        /**
+         * @brief Record the data transaction of the current block
+         *
+         * @param bytes         Number of payload bytes in the block
+         * @param start         Time when the transaction was started
+         */
+        void block_transferred(size_t bytes, clock_t::time_point start);
+
+        /**
+         * @brief Record a DFU_GETSTATUS transaction
+         *
+         * @param start         Time when the transaction was started
+         * @param end           Time when the transaction completed
+         */
+        void status_polled(clock_t::time_point start, clock_t::time_point end);
+
+        /**
+         * @brief Record the sleep requested by the device in the DFU_GETSTATUS response
+         *
+         * @param start         Time when the sleep was started
+         */
+        void poll_slept(clock_t::time_point start);
+
+        /** @brief Mark the end of the current block and update the latency statistics */
+        void block_end();
+
+        /**
+         * @brief Mark the end of a block rejected by the device, such as a block size it does not support
+         *
+         * The time spent on the block is left out of the latency statistics and of the throughput.
+         */
+        void block_rejected();
+
+        /** @brief Mark the end of the operation */
+        void finish();
+
+        /** @brief Get the number of bytes transferred */
+        size_t get_total_bytes() const {return total_bytes;};
+
+        /** @brief Get the throughput in bytes per second, measured from the start of the operation without the rejected blocks */
+        double get_throughput() const;
+
+        /**
+         * @brief Print the live progress line with throughput and ETA
+         *
+         * @param os            Stream to print to
+         * @param force         Print even if the line has been printed less than 100 ms ago
+         * @return              true if the line has been printed
+         * @note The line starts with a carriage return and has no new line at the end.
+         * The progress is given in percent if the expected number of bytes is known (download),
+         * in bytes otherwise (upload).
+         */
+        bool print_live(std::ostream &os, bool force = false);
+
+        /**
+         * @brief Write the report in JSON format
+         *
+         * @param path          Path to the JSON file
+         * @return              true if the report has been written
+         */
+        bool write_json(const std::string path) const;
+};
+
+#endif
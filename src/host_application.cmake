@@ -4,11 +4,17 @@ set( APP_NAME  xvf_host )
 
 set(COMMON_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/main.cpp
-    ${CMAKE_CURRENT_LIST_DIR}/utils/utils.cpp
-    ${CMAKE_CURRENT_LIST_DIR}/utils/platform_support.cpp
-    ${CMAKE_CURRENT_LIST_DIR}/command/command.cpp
     ${CMAKE_CURRENT_LIST_DIR}/special_commands/special_commands.cpp
     ${CMAKE_CURRENT_LIST_DIR}/special_commands/filters.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/command_plan.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/boot_apply.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/dump_engine.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/watch.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/capture_file.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/param_table.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/wait_for.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/special_commands/command_session.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/utils/app_options.cpp
 )
 set(COMMON_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/utils
@@ -18,6 +24,8 @@ set(COMMON_INCLUDES
     ${DEVICE_CONTROL_PATH}/api
 )
 
+find_package(Threads REQUIRED)
+
 add_executable( ${APP_NAME})
 
 # Add options for different compilers
@@ -43,6 +51,12 @@ target_include_directories( ${APP_NAME}
         ${COMMON_INCLUDES}
 )
 
+target_link_libraries( ${APP_NAME}
+    PRIVATE
+        xvf_control_objects
+        Threads::Threads
+)
+
 target_compile_definitions( ${APP_NAME}
     PRIVATE
         DEFAULT_DRIVER_NAME=device_usb_dl_name
@@ -58,3 +72,89 @@ target_link_options( ${APP_NAME}
         -rdynamic
 )
 endif() # not windows
+
+if (${CMAKE_SYSTEM_NAME} STREQUAL Linux)
+# shm_open is in librt on older glibc
+target_link_libraries( ${APP_NAME}
+    PRIVATE
+        rt
+)
+endif() # linux
+
+set(HOST_APP_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+# Build a variant of the host application with a device driver and a command map linked into it,
+# so it does not load them at run time. static_registry.cpp gives them to get_dynamic_lib() and the
+# get_*_fptr functions, and the other drivers and command maps are still loaded from their libraries.
+#   DRIVER_NAME     name of the built-in driver, which becomes the default one, such as device_usb
+#   SOURCES         sources or objects of the driver and of the command map
+#   LIBRARIES       libraries the driver and the command map are linked with
+function(add_static_host_app TARGET)
+    cmake_parse_arguments(STATIC "" "DRIVER_NAME" "SOURCES;LIBRARIES" ${ARGN})
+
+    add_executable( ${TARGET})
+
+    if (CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
+        target_compile_options( ${TARGET}
+            PRIVATE
+                -WX
+        )
+    else()
+        target_compile_options( ${TARGET}
+            PRIVATE
+                -Werror
+                -g
+        )
+    endif()
+
+    # The command and device layers are built again, as the default driver is compiled into them
+    target_sources( ${TARGET}
+        PRIVATE
+            ${COMMON_SOURCES}
+            ${LIBRARY_SOURCES}
+            ${HOST_APP_DIR}/utils/static_registry.cpp
+            ${STATIC_SOURCES}
+    )
+    target_include_directories( ${TARGET}
+        PUBLIC
+            ${COMMON_INCLUDES}
+    )
+    target_link_libraries( ${TARGET}
+        PRIVATE
+            Threads::Threads
+            ${STATIC_LIBRARIES}
+    )
+    target_compile_definitions( ${TARGET}
+        PRIVATE
+            DEFAULT_DRIVER_NAME=${STATIC_DRIVER_NAME}_dl_name
+            STATIC_DRIVER_NAME="${STATIC_DRIVER_NAME}"
+    )
+
+    # Without -rdynamic, so a driver loaded at run time does not bind to the Device class built in
+    if (NOT ${CMAKE_SYSTEM_NAME} STREQUAL Windows)
+    target_link_libraries( ${TARGET}
+        PUBLIC
+            dl
+    )
+    endif() # not windows
+
+    if (${CMAKE_SYSTEM_NAME} STREQUAL Linux)
+    target_link_libraries( ${TARGET}
+        PRIVATE
+            rt
+    )
+    endif() # linux
+endfunction()
+
+if(STATIC_HOST)
+    add_static_host_app( ${APP_NAME}_static
+        DRIVER_NAME
+            device_${STATIC_HOST_PROTOCOL}
+        SOURCES
+            ${CMAKE_CURRENT_LIST_DIR}/device/device_${STATIC_HOST_PROTOCOL}.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/device/bus_arbiter.cpp
+            ${STATIC_HOST_COMMAND_MAP}
+        LIBRARIES
+            rtos::sw_services::device_control_host_${STATIC_HOST_PROTOCOL}
+    )
+endif()
@@ -47,6 +47,7 @@ add_library(device_i2c SHARED)
 target_sources(device_i2c
     PRIVATE
         ${CMAKE_CURRENT_LIST_DIR}/device/device_i2c.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/device/bus_arbiter.cpp
 
 )
 target_include_directories(device_i2c
@@ -66,6 +67,7 @@ add_library(device_spi SHARED)
 target_sources(device_spi
     PRIVATE
         ${CMAKE_CURRENT_LIST_DIR}/device/device_spi.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/device/bus_arbiter.cpp
 )
 target_include_directories(device_spi
     PUBLIC
@@ -129,6 +131,7 @@ add_library(device_usb SHARED)
 target_sources(device_usb
     PRIVATE
         ${CMAKE_CURRENT_LIST_DIR}/device/device_usb.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/device/bus_arbiter.cpp
 )
 target_include_directories(device_usb
     PUBLIC
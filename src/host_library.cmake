@@ -0,0 +1,82 @@
+# Building the xvf_control library here
+# The command and device layers are built once, linked into the host application and into the library
+
+set( LIB_NAME  xvf_control )
+
+set(LIBRARY_SOURCES
+    ${CMAKE_CURRENT_LIST_DIR}/utils/utils.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/utils/platform_support.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/command/command.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/command/device_session.cpp
+)
+set(LIBRARY_INCLUDES
+    ${CMAKE_CURRENT_LIST_DIR}/utils
+    ${CMAKE_CURRENT_LIST_DIR}/device
+    ${CMAKE_CURRENT_LIST_DIR}/command
+    ${DEVICE_CONTROL_PATH}/api
+)
+
+find_package(Threads REQUIRED)
+
+add_library( ${LIB_NAME}_objects OBJECT)
+
+# Add options for different compilers
+if (CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
+    target_compile_options( ${LIB_NAME}_objects
+        PRIVATE
+            -WX
+    )
+else()
+    target_compile_options( ${LIB_NAME}_objects
+        PRIVATE
+            -Werror
+            -g
+    )
+endif()
+
+target_sources( ${LIB_NAME}_objects
+    PRIVATE
+        ${LIBRARY_SOURCES}
+)
+target_include_directories( ${LIB_NAME}_objects
+    PUBLIC
+        ${LIBRARY_INCLUDES}
+)
+target_link_libraries( ${LIB_NAME}_objects
+    PUBLIC
+        Threads::Threads
+)
+target_compile_definitions( ${LIB_NAME}_objects
+    PUBLIC
+        DEFAULT_DRIVER_NAME=device_usb_dl_name
+)
+set_target_properties( ${LIB_NAME}_objects
+    PROPERTIES
+        POSITION_INDEPENDENT_CODE ON
+)
+
+if (NOT ${CMAKE_SYSTEM_NAME} STREQUAL Windows)
+target_link_libraries( ${LIB_NAME}_objects
+    PUBLIC
+        dl
+)
+endif() # not windows
+
+# Shared library with the C interface in library/xvf_control.h
+add_library( ${LIB_NAME} SHARED)
+
+target_sources( ${LIB_NAME}
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/library/xvf_control.cpp
+)
+target_include_directories( ${LIB_NAME}
+    PUBLIC
+        ${CMAKE_CURRENT_LIST_DIR}/library
+)
+target_link_libraries( ${LIB_NAME}
+    PRIVATE
+        ${LIB_NAME}_objects
+)
+
+# Python bindings of the C interface, next to the library they load
+configure_file( ${CMAKE_CURRENT_LIST_DIR}/library/xvf_control.py ${CMAKE_BINARY_DIR}/xvf_control.py COPYONLY)
@@ -0,0 +1,609 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "xvf_control.h"
+#include "device_session.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+extern size_t num_commands;
+
+static_assert(XVF_CONTROL_ERROR == HOST_APP_ERROR, "Library and application errors must match");
+static_assert((XVF_TYPE_RADIANS == static_cast<int>(TYPE_RADIANS)) && (XVF_CMD_RW == static_cast<int>(CMD_RW)), "Library and command_map types must match");
+
+/** @brief Library handle, owns the command and the session using it */
+struct xvf_control
+{
+    /** Device from the driver library, which owns it */
+    Device * device;
+    /** Command using the device */
+    unique_ptr<Command> command;
+    /** Session running all the transactions, destroyed before the command */
+    unique_ptr<DeviceSession> session;
+    /** Names of all the commands in the command map */
+    vector<string> cmd_names;
+    /** Handles of all the commands by name, not changed after xvf_control_open() so any thread can look them up */
+    unordered_map<string, SessionCommand> handles;
+};
+
+/** @brief Error message of the last call from each thread */
+static thread_local string last_error;
+
+/** @brief Run a library function, turning its exceptions into an error code and message */
+template<typename F>
+static int run_checked(F func)
+{
+    last_error.clear();
+    try
+    {
+        func();
+        return CONTROL_SUCCESS;
+    }
+    catch(const host_app_error & e)
+    {
+        last_error = e.what();
+        return e.code;
+    }
+    catch(const exception & e)
+    {
+        last_error = e.what();
+        return XVF_CONTROL_ERROR;
+    }
+}
+
+/** @brief Get the size in bytes of the host representation of a value */
+static size_t get_host_value_size(cmd_param_type_t type)
+{
+    return ((type == TYPE_CHAR) || (type == TYPE_UINT8)) ? 1 : 4;
+}
+
+/**
+ * @brief Find the handle of a command
+ *
+ * @note Throws host_app_error with the closest command names if the command does not exist
+ */
+static const SessionCommand & find_handle(const xvf_control_t * ctrl, const char * cmd_name)
+{
+    auto handle = ctrl->handles.find(to_upper(cmd_name));
+    if(handle == ctrl->handles.end())
+    {
+        cmd_t cmd;
+        init_cmd(&cmd, cmd_name); // throws the same error as xvf_host
+        throw host_app_error("Command " + cmd.cmd_name + " does not exist");
+    }
+    return handle->second;
+}
+
+/** @brief Check a command can be read */
+static void check_readable(const cmd_t & cmd)
+{
+    if(cmd.rw == CMD_WO)
+    {
+        throw host_app_error("Command " + cmd.cmd_name + " is write only");
+    }
+}
+
+/** @brief Check a command can be written */
+static void check_writable(const cmd_t & cmd)
+{
+    if((cmd.rw == CMD_RO) || (cmd.type == TYPE_CHAR))
+    {
+        throw host_app_error("Command " + cmd.cmd_name + " is read only");
+    }
+}
+
+/**
+ * @brief Copy values to an array in the host layout
+ *
+ * @param type      Value type
+ * @param params    Values to copy
+ * @param count     Number of values to copy
+ * @param values    Array in the host layout
+ */
+static void copy_to_host(cmd_param_type_t type, const cmd_param_t * params, size_t count, void * values)
+{
+    const size_t value_size = get_host_value_size(type);
+    for(size_t i = 0; i < count; i++)
+    {
+        memcpy(static_cast<uint8_t *>(values) + i * value_size, &params[i], value_size);
+    }
+}
+
+/**
+ * @brief Copy values from an array in the host layout
+ *
+ * @param type      Value type
+ * @param values    Array in the host layout
+ * @param count     Number of values to copy
+ * @param params    Copied values
+ */
+static void copy_from_host(cmd_param_type_t type, const void * values, size_t count, cmd_param_t * params)
+{
+    const size_t value_size = get_host_value_size(type);
+    for(size_t i = 0; i < count; i++)
+    {
+        memcpy(&params[i], static_cast<const uint8_t *>(values) + i * value_size, value_size);
+    }
+}
+
+/** @brief Read a command from a task running on the I/O thread of the session */
+static void io_get(Command * command, const cmd_t & cmd, cmd_param_t * params)
+{
+    vector<uint8_t> data(command_param_type_size(cmd.type) * cmd.num_values + 1); // one extra for the status
+    command->command_get_bytes(&cmd, data.data(), data.size());
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        params[i] = command_param_from_bytes(cmd.type, &data[1], i);
+    }
+}
+
+/** @brief Write a command from a task running on the I/O thread of the session */
+static void io_set(Command * command, const cmd_t & cmd, const cmd_param_t * params)
+{
+    command->check_values_range(&cmd, params);
+    vector<uint8_t> data(command_param_type_size(cmd.type) * cmd.num_values);
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        command_param_to_bytes(cmd.type, data.data(), i, params[i]);
+    }
+    command->command_set_bytes(&cmd, data.data(), data.size());
+}
+
+/** @brief Find the commands of a buffer transfer and check the offset command takes a single int32 */
+static void find_buffer_cmds(const xvf_control_t * ctrl, const char * offset_cmd_name, const char * buffer_cmd_name, const cmd_t ** offset_cmd, const cmd_t ** buffer_cmd)
+{
+    *offset_cmd = &find_handle(ctrl, offset_cmd_name).get_cmd();
+    *buffer_cmd = &find_handle(ctrl, buffer_cmd_name).get_cmd();
+    if(((*offset_cmd)->type != TYPE_INT32) || ((*offset_cmd)->num_values != 1))
+    {
+        throw host_app_error("Command " + (*offset_cmd)->cmd_name + " does not set a start offset");
+    }
+}
+
+/** @brief Write of a command in a filter transfer, with its values */
+using filter_write_t = pair<const cmd_t *, vector<cmd_param_t>>;
+
+/** @brief Steps of a filter transfer, in the order of filters.cpp */
+struct filter_transfer_t
+{
+    /** Writes selecting the filter, before its length is read */
+    vector<filter_write_t> select;
+    /** Command giving the length of the filter, as the product of its values */
+    const cmd_t * length_cmd;
+    /** Writes before the first chunk */
+    vector<filter_write_t> start;
+    /** Writes after the last chunk, also made if the transfer fails once started */
+    vector<filter_write_t> end;
+    /** Command which sets the start offset of a chunk */
+    const cmd_t * offset_cmd;
+    /** Command which reads or writes a chunk */
+    const cmd_t * buffer_cmd;
+};
+
+/**
+ * @brief Make the write of a command from its integer values
+ *
+ * @note Throws host_app_error if the command does not exist or does not take this number of values
+ */
+static filter_write_t make_filter_write(const xvf_control_t * ctrl, const char * cmd_name, const vector<int32_t> & values)
+{
+    const cmd_t * cmd = &find_handle(ctrl, cmd_name).get_cmd();
+    if(values.size() != cmd->num_values)
+    {
+        throw host_app_error("Command " + cmd->cmd_name + " writes " + to_string(cmd->num_values) + " values, " + to_string(values.size()) + " are given");
+    }
+    vector<cmd_param_t> params(values.size());
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        if(cmd->type == TYPE_UINT8)
+        {
+            params[i].ui8 = static_cast<uint8_t>(values[i]);
+        }
+        else
+        {
+            params[i].i32 = values[i];
+        }
+    }
+    return filter_write_t(cmd, params);
+}
+
+/** @brief Describe the size of a filter, such as 8 x 4 */
+static string filter_size_str(const vector<size_t> & dims)
+{
+    string size;
+    for(size_t dim : dims)
+    {
+        size += (size.empty() ? "" : " x ") + to_string(dim);
+    }
+    return size;
+}
+
+/**
+ * @brief Run a filter transfer as a single buffer transfer of the session, holding the bus arbiter from the selection to the end
+ *
+ * @param ctrl          Handle from xvf_control_open()
+ * @param transfer      Steps of the transfer
+ * @param buffer        Filter in the host layout, nullptr to only read its size
+ * @param capacity      Number of values the buffer holds, for a read
+ * @param shape         Values the length command must give, for a write. nullptr for a read
+ * @return              Values of the length command, their product is the number of values of the filter
+ * @note Throws host_app_error if the filter does not fit in the buffer for a read, or does not have this shape for a write,
+ * before anything is started
+ */
+static vector<size_t> run_filter_transfer(xvf_control_t * ctrl, const filter_transfer_t & transfer, void * buffer, size_t capacity, const vector<size_t> * shape)
+{
+    const bool is_get = (shape == nullptr);
+    const size_t value_size = get_host_value_size(transfer.buffer_cmd->type);
+    vector<cmd_param_t> length_values(transfer.length_cmd->num_values);
+    vector<size_t> dims;
+    vector<cmd_param_t> chunk(transfer.buffer_cmd->num_values);
+    // Only used by the I/O thread, which takes and gives back the arbiter
+    unique_ptr<BusArbiterLock> section;
+    bool is_started = false;
+    size_t length = 0;
+    size_t start = 0;
+    ctrl->session->run_steps([&](Command * command)
+    {
+        try
+        {
+            if(section == nullptr)
+            {
+                section.reset(new BusArbiterLock(command->get_arbiter()));
+                for(const filter_write_t & write : transfer.select)
+                {
+                    io_set(command, *write.first, write.second.data());
+                }
+                io_get(command, *transfer.length_cmd, length_values.data());
+                length = 1;
+                for(const cmd_param_t & value : length_values)
+                {
+                    dims.push_back(static_cast<size_t>(max<int32_t>(value.i32, 0)));
+                    length *= dims.back();
+                }
+                if(buffer == nullptr)
+                {
+                    section.reset();
+                    return true;
+                }
+                if(is_get ? (length > capacity) : (dims != *shape))
+                {
+                    throw host_app_error("Filter " + transfer.buffer_cmd->cmd_name + " is " + filter_size_str(dims) + ", "
+                                         + (is_get ? "the array holds " + to_string(capacity) + " values" : filter_size_str(*shape) + " is given"));
+                }
+                is_started = true;
+                for(const filter_write_t & write : transfer.start)
+                {
+                    io_set(command, *write.first, write.second.data());
+                }
+            }
+            else if(start < length)
+            {
+                // One chunk per step, so the control requests of other threads still run between the chunks
+                cmd_param_t offset;
+                offset.i32 = static_cast<int32_t>(start);
+                io_set(command, *transfer.offset_cmd, &offset);
+                const size_t count = min<size_t>(transfer.buffer_cmd->num_values, length - start);
+                uint8_t * values = static_cast<uint8_t *>(buffer) + start * value_size;
+                if(is_get)
+                {
+                    io_get(command, *transfer.buffer_cmd, chunk.data());
+                    copy_to_host(transfer.buffer_cmd->type, chunk.data(), count, values);
+                }
+                else
+                {
+                    fill(chunk.begin(), chunk.end(), cmd_param_t{}); // the last chunk is padded with zeros
+                    copy_from_host(transfer.buffer_cmd->type, values, count, chunk.data());
+                    io_set(command, *transfer.buffer_cmd, chunk.data());
+                }
+                start += transfer.buffer_cmd->num_values;
+            }
+            if(start < length)
+            {
+                return false;
+            }
+            for(const filter_write_t & write : transfer.end)
+            {
+                io_set(command, *write.first, write.second.data());
+            }
+            section.reset();
+            return true;
+        }
+        catch(...)
+        {
+            if(is_started)
+            {
+                // The first error is the one reported
+                try
+                {
+                    for(const filter_write_t & write : transfer.end)
+                    {
+                        io_set(command, *write.first, write.second.data());
+                    }
+                }
+                catch(...)
+                {
+                }
+            }
+            section.reset();
+            throw;
+        }
+    }).get();
+    return dims;
+}
+
+/** @brief Steps of the transfer of the AEC filter of a (far end, mic) pair, as special_cmd_aec_filter() */
+static filter_transfer_t aec_filter_transfer(const xvf_control_t * ctrl, int32_t far_index, int32_t mic_index)
+{
+    filter_transfer_t transfer;
+    transfer.length_cmd = &find_handle(ctrl, "SPECIAL_CMD_AEC_FILTER_LENGTH").get_cmd();
+    // Stop the AEC filter from adapting during the transfer
+    transfer.start.push_back(make_filter_write(ctrl, "SHF_BYPASS", {1}));
+    transfer.start.push_back(make_filter_write(ctrl, "SPECIAL_CMD_AEC_FAR_MIC_INDEX", {far_index, mic_index}));
+    transfer.end.push_back(make_filter_write(ctrl, "SHF_BYPASS", {0}));
+    find_buffer_cmds(ctrl, "SPECIAL_CMD_AEC_FILTER_COEFF_START_OFFSET", "SPECIAL_CMD_AEC_FILTER_COEFFS", &transfer.offset_cmd, &transfer.buffer_cmd);
+    return transfer;
+}
+
+/** @brief Steps of the transfer of the NLModel buffer of a band, as special_cmd_nlmodel_buffer() */
+static filter_transfer_t nlmodel_transfer(const xvf_control_t * ctrl, uint8_t band_index)
+{
+    filter_transfer_t transfer;
+    if(ctrl->handles.find("SPECIAL_CMD_PP_NLMODEL_BAND") != ctrl->handles.end())
+    {
+        transfer.select.push_back(make_filter_write(ctrl, "SPECIAL_CMD_PP_NLMODEL_BAND", {band_index}));
+    }
+    else if(band_index != 0)
+    {
+        throw host_app_error("FW version does not support Hi Band NL model read or write.");
+    }
+    transfer.length_cmd = &find_handle(ctrl, "SPECIAL_CMD_PP_NLMODEL_NROW_NCOL").get_cmd();
+    if(transfer.length_cmd->num_values != 2)
+    {
+        throw host_app_error("Command " + transfer.length_cmd->cmd_name + " does not give the number of rows and columns");
+    }
+    transfer.start.push_back(make_filter_write(ctrl, "SPECIAL_CMD_NLMODEL_START", {1}));
+    find_buffer_cmds(ctrl, "SPECIAL_CMD_NLMODEL_COEFF_START_OFFSET", "SPECIAL_CMD_PP_NLMODEL", &transfer.offset_cmd, &transfer.buffer_cmd);
+    return transfer;
+}
+
+/** @brief Steps of the transfer of the equalization filter, as special_cmd_equalization_filter() */
+static filter_transfer_t eq_filter_transfer(const xvf_control_t * ctrl)
+{
+    filter_transfer_t transfer;
+    transfer.length_cmd = &find_handle(ctrl, "SPECIAL_CMD_PP_EQUALIZATION_NUM_BANDS").get_cmd();
+    transfer.start.push_back(make_filter_write(ctrl, "SPECIAL_CMD_EQUALIZATION_START", {1}));
+    find_buffer_cmds(ctrl, "SPECIAL_CMD_EQUALIZATION_COEFF_START_OFFSET", "SPECIAL_CMD_PP_EQUALIZATION", &transfer.offset_cmd, &transfer.buffer_cmd);
+    return transfer;
+}
+
+int xvf_control_open(const char * command_map_path, const char * lib_dir, const char * protocol, int bypass_range_check, xvf_control_t ** ctrl)
+{
+    return run_checked([&]()
+    {
+        *ctrl = nullptr;
+        const string dir = (lib_dir != nullptr) ? lib_dir : "";
+        const string cmd_map_path = (command_map_path != nullptr) ? command_map_path : get_dynamic_lib_path(default_command_map_name, dir);
+        string device_dl_name = default_driver_name;
+        if(protocol != nullptr)
+        {
+            const string protocol_name = to_lower(protocol);
+            if((protocol_name != "i2c") && (protocol_name != "spi") && (protocol_name != "usb"))
+            {
+                throw host_app_error("Protocol " + string(protocol) + " is not supported, use i2c, spi or usb");
+            }
+            device_dl_name = "device_" + protocol_name;
+        }
+
+        dl_handle_t cmd_map_handle = load_command_map_dll(cmd_map_path);
+        if((bypass_range_check == 0) && (get_range_error_fptr(cmd_map_handle) == nullptr))
+        {
+            // The check_range() of the older command maps would exit the process
+            throw host_app_error("Command map " + cmd_map_path + " does not have get_range_error(), open it with the range check bypassed");
+        }
+        unique_ptr<xvf_control> new_ctrl(new xvf_control);
+        new_ctrl->device = load_device(cmd_map_handle, device_dl_name, dir);
+        new_ctrl->command.reset(new Command(new_ctrl->device, bypass_range_check != 0, cmd_map_handle));
+        // Connect now, so a missing device is reported by the open call
+        new_ctrl->command->open_device();
+        new_ctrl->session.reset(new DeviceSession(new_ctrl->command.get()));
+        cmd_t cmd;
+        for(size_t i = 0; i < num_commands; i++)
+        {
+            init_cmd(&cmd, "", i);
+            new_ctrl->cmd_names.push_back(cmd.cmd_name);
+            new_ctrl->handles.emplace(cmd.cmd_name, SessionCommand(new_ctrl->session.get(), cmd));
+        }
+        *ctrl = new_ctrl.release();
+    });
+}
+
+void xvf_control_close(xvf_control_t * ctrl)
+{
+    delete ctrl;
+}
+
+const char * xvf_control_last_error(void)
+{
+    return last_error.c_str();
+}
+
+size_t xvf_control_num_commands(const xvf_control_t * ctrl)
+{
+    return ctrl->cmd_names.size();
+}
+
+const char * xvf_control_command_name(const xvf_control_t * ctrl, size_t index)
+{
+    return (index < ctrl->cmd_names.size()) ? ctrl->cmd_names[index].c_str() : nullptr;
+}
+
+int xvf_control_get_info(xvf_control_t * ctrl, const char * cmd_name, xvf_cmd_info_t * info)
+{
+    return run_checked([&]()
+    {
+        const cmd_t & cmd = find_handle(ctrl, cmd_name).get_cmd();
+        *info = {cmd.res_id, cmd.cmd_id, static_cast<uint8_t>(cmd.type), static_cast<uint8_t>(cmd.rw), cmd.num_values};
+    });
+}
+
+int xvf_control_get(xvf_control_t * ctrl, const char * cmd_name, void * values, size_t num_values)
+{
+    return run_checked([&]()
+    {
+        const SessionCommand & handle = find_handle(ctrl, cmd_name);
+        const cmd_t & cmd = handle.get_cmd();
+        check_readable(cmd);
+        if(num_values < cmd.num_values)
+        {
+            throw host_app_error("Command " + cmd.cmd_name + " reads " + to_string(cmd.num_values) + " values, the array holds " + to_string(num_values));
+        }
+        vector<cmd_param_t> params(cmd.num_values);
+        handle.get(params.data());
+        copy_to_host(cmd.type, params.data(), cmd.num_values, values);
+    });
+}
+
+int xvf_control_set(xvf_control_t * ctrl, const char * cmd_name, const void * values, size_t num_values)
+{
+    return run_checked([&]()
+    {
+        const SessionCommand & handle = find_handle(ctrl, cmd_name);
+        const cmd_t & cmd = handle.get_cmd();
+        check_writable(cmd);
+        if(num_values != cmd.num_values)
+        {
+            throw host_app_error("Command " + cmd.cmd_name + " writes " + to_string(cmd.num_values) + " values, " + to_string(num_values) + " are given");
+        }
+        vector<cmd_param_t> params(cmd.num_values);
+        copy_from_host(cmd.type, values, cmd.num_values, params.data());
+        handle.set(params.data());
+    });
+}
+
+int xvf_control_get_buffer(xvf_control_t * ctrl, const char * start_offset_cmd_name, const char * buffer_cmd_name, void * buffer, size_t length)
+{
+    return run_checked([&]()
+    {
+        const cmd_t * offset_cmd;
+        const cmd_t * buffer_cmd;
+        find_buffer_cmds(ctrl, start_offset_cmd_name, buffer_cmd_name, &offset_cmd, &buffer_cmd);
+        check_readable(*buffer_cmd);
+        // One chunk per step, so the control requests of other threads run between the chunks,
+        // while the bulk transfers of other threads wait for this one to complete
+        const size_t value_size = get_host_value_size(buffer_cmd->type);
+        vector<cmd_param_t> chunk(buffer_cmd->num_values);
+        size_t start = 0;
+        ctrl->session->run_steps([&](Command * command)
+        {
+            if(start >= length)
+            {
+                return true;
+            }
+            cmd_param_t offset;
+            offset.i32 = static_cast<int32_t>(start);
+            io_set(command, *offset_cmd, &offset);
+            io_get(command, *buffer_cmd, chunk.data());
+            copy_to_host(buffer_cmd->type, chunk.data(), min<size_t>(buffer_cmd->num_values, length - start),
+                         static_cast<uint8_t *>(buffer) + start * value_size);
+            start += buffer_cmd->num_values;
+            return start >= length;
+        }).get();
+    });
+}
+
+int xvf_control_set_buffer(xvf_control_t * ctrl, const char * start_offset_cmd_name, const char * buffer_cmd_name, const void * buffer, size_t length)
+{
+    return run_checked([&]()
+    {
+        const cmd_t * offset_cmd;
+        const cmd_t * buffer_cmd;
+        find_buffer_cmds(ctrl, start_offset_cmd_name, buffer_cmd_name, &offset_cmd, &buffer_cmd);
+        check_writable(*buffer_cmd);
+        const size_t value_size = get_host_value_size(buffer_cmd->type);
+        size_t start = 0;
+        ctrl->session->run_steps([&](Command * command)
+        {
+            if(start >= length)
+            {
+                return true;
+            }
+            cmd_param_t offset;
+            offset.i32 = static_cast<int32_t>(start);
+            io_set(command, *offset_cmd, &offset);
+            vector<cmd_param_t> chunk(buffer_cmd->num_values); // the last chunk is padded with zeros
+            copy_from_host(buffer_cmd->type, static_cast<const uint8_t *>(buffer) + start * value_size,
+                           min<size_t>(buffer_cmd->num_values, length - start), chunk.data());
+            io_set(command, *buffer_cmd, chunk.data());
+            start += buffer_cmd->num_values;
+            return start >= length;
+        }).get();
+    });
+}
+
+int xvf_control_get_aec_filter(xvf_control_t * ctrl, int32_t far_index, int32_t mic_index, void * buffer, size_t * length)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = aec_filter_transfer(ctrl, far_index, mic_index);
+        check_readable(*transfer.buffer_cmd);
+        *length = run_filter_transfer(ctrl, transfer, buffer, *length, nullptr)[0];
+    });
+}
+
+int xvf_control_set_aec_filter(xvf_control_t * ctrl, int32_t far_index, int32_t mic_index, const void * buffer, size_t length)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = aec_filter_transfer(ctrl, far_index, mic_index);
+        check_writable(*transfer.buffer_cmd);
+        const vector<size_t> shape = {length};
+        run_filter_transfer(ctrl, transfer, const_cast<void *>(buffer), 0, &shape);
+    });
+}
+
+int xvf_control_get_nlmodel(xvf_control_t * ctrl, uint8_t band_index, void * buffer, size_t * length, size_t * num_cols)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = nlmodel_transfer(ctrl, band_index);
+        check_readable(*transfer.buffer_cmd);
+        vector<size_t> dims = run_filter_transfer(ctrl, transfer, buffer, *length, nullptr);
+        *length = dims[0] * dims[1];
+        *num_cols = dims[1];
+    });
+}
+
+int xvf_control_set_nlmodel(xvf_control_t * ctrl, uint8_t band_index, const void * buffer, size_t num_rows, size_t num_cols)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = nlmodel_transfer(ctrl, band_index);
+        check_writable(*transfer.buffer_cmd);
+        const vector<size_t> shape = {num_rows, num_cols};
+        run_filter_transfer(ctrl, transfer, const_cast<void *>(buffer), 0, &shape);
+    });
+}
+
+int xvf_control_get_eq_filter(xvf_control_t * ctrl, void * buffer, size_t * length)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = eq_filter_transfer(ctrl);
+        check_readable(*transfer.buffer_cmd);
+        *length = run_filter_transfer(ctrl, transfer, buffer, *length, nullptr)[0];
+    });
+}
+
+int xvf_control_set_eq_filter(xvf_control_t * ctrl, const void * buffer, size_t length)
+{
+    return run_checked([&]()
+    {
+        filter_transfer_t transfer = eq_filter_transfer(ctrl);
+        check_writable(*transfer.buffer_cmd);
+        const vector<size_t> shape = {length};
+        run_filter_transfer(ctrl, transfer, const_cast<void *>(buffer), 0, &shape);
+    });
+}
@@ -0,0 +1,259 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+/**
+ * @file xvf_control.h
+ * @brief C interface of the xvf_control library
+ *
+ * The library reads and writes the device parameters by name, as xvf_host does, without
+ * starting a process for each operation. No function exits the process or writes to stdout:
+ * errors are returned as a control_ret_t value from the device, or XVF_CONTROL_ERROR,
+ * and xvf_control_last_error() describes the last error of the calling thread.
+ *
+ * The command map is loaded into the process and each device driver holds a single device,
+ * so all the handles must use the same command map, and share the device of a protocol.
+ * A handle can be used by several threads at the same time: its transactions are queued
+ * to a single I/O thread and run in the order they are submitted. Open a single handle
+ * per device, as the I/O threads of two handles would use the device at the same time.
+ */
+
+#ifndef XVF_CONTROL_H_
+#define XVF_CONTROL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Version of this interface */
+#define XVF_CONTROL_API_VERSION 1
+
+/** @brief Returned for the errors which do not come from the device, the other errors are control_ret_t values */
+#define XVF_CONTROL_ERROR -1
+
+/** @brief Opaque handle to a device and its command map */
+typedef struct xvf_control xvf_control_t;
+
+/** @brief Value types, same as cmd_param_type_t */
+typedef enum
+{
+    XVF_TYPE_CHAR,      /**< char, read only */
+    XVF_TYPE_UINT8,     /**< uint8_t */
+    XVF_TYPE_INT32,     /**< int32_t */
+    XVF_TYPE_FLOAT,     /**< float */
+    XVF_TYPE_UINT32,    /**< uint32_t */
+    XVF_TYPE_RADIANS    /**< float, in radians */
+} xvf_param_type_t;
+
+/** @brief Read/write types, same as cmd_rw_t */
+typedef enum
+{
+    XVF_CMD_RO,         /**< Read only */
+    XVF_CMD_WO,         /**< Write only */
+    XVF_CMD_RW          /**< Read/write */
+} xvf_cmd_rw_t;
+
+/** @brief Command information */
+typedef struct
+{
+    /** Resource ID */
+    uint8_t res_id;
+    /** Command ID */
+    uint8_t cmd_id;
+    /** Value type, see xvf_param_type_t */
+    uint8_t type;
+    /** Read/write type, see xvf_cmd_rw_t */
+    uint8_t rw;
+    /** Number of values */
+    uint32_t num_values;
+} xvf_cmd_info_t;
+
+/**
+ * @brief Load the command map and the device driver, and connect to the device
+ *
+ * @param command_map_path      Path to the command_map library, NULL for the one in lib_dir. All the handles
+ *                              of a process use the same command map, opening another one fails
+ * @param lib_dir               Directory of the device driver libraries, NULL for the directory of the executable
+ * @param protocol              "i2c", "spi" or "usb", NULL for the default driver of xvf_host
+ * @param bypass_range_check    Non zero to write values without checking their range. Otherwise a value
+ *                              out of range fails the call, which needs the get_range_error() function of
+ *                              the command map
+ * @param ctrl                  Set to the new handle
+ * @return                      CONTROL_SUCCESS (0), or the error
+ */
+int xvf_control_open(const char * command_map_path, const char * lib_dir, const char * protocol, int bypass_range_check, xvf_control_t ** ctrl);
+
+/**
+ * @brief Free the handle
+ *
+ * The device stays connected until the driver library is unloaded, when the process exits.
+ * @param ctrl                  Handle from xvf_control_open(), can be NULL
+ */
+void xvf_control_close(xvf_control_t * ctrl);
+
+/**
+ * @brief Describe the last error of the calling thread
+ *
+ * @return                      Error message, empty if there was no error, valid until the next call from this thread
+ */
+const char * xvf_control_last_error(void);
+
+/**
+ * @brief Get the number of commands in the command map
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ */
+size_t xvf_control_num_commands(const xvf_control_t * ctrl);
+
+/**
+ * @brief Get the name of a command
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param index                 Command index, below xvf_control_num_commands()
+ * @return                      Command name, valid until the handle is closed, NULL if the index is out of range
+ */
+const char * xvf_control_command_name(const xvf_control_t * ctrl, size_t index);
+
+/**
+ * @brief Get the information of a command
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param cmd_name              Command name, in any case
+ * @param info                  Set to the command information
+ * @return                      CONTROL_SUCCESS (0), or XVF_CONTROL_ERROR if the command does not exist
+ */
+int xvf_control_get_info(xvf_control_t * ctrl, const char * cmd_name, xvf_cmd_info_t * info);
+
+/**
+ * @brief Read the values of a command
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param cmd_name              Command name, in any case
+ * @param values                Array of num_values values of the type of the command, see xvf_param_type_t
+ * @param num_values            Number of values of the array, at least the number of values of the command
+ * @return                      CONTROL_SUCCESS (0), or the error
+ */
+int xvf_control_get(xvf_control_t * ctrl, const char * cmd_name, void * values, size_t num_values);
+
+/**
+ * @brief Write the values of a command
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param cmd_name              Command name, in any case
+ * @param values                Array of num_values values of the type of the command, see xvf_param_type_t
+ * @param num_values            Number of values of the array, the number of values of the command
+ * @return                      CONTROL_SUCCESS (0), or the error
+ */
+int xvf_control_set(xvf_control_t * ctrl, const char * cmd_name, const void * values, size_t num_values);
+
+/**
+ * @brief Read a buffer which is transferred in chunks, such as a filter
+ *
+ * For each chunk the start offset command is set to the index of the first value,
+ * then the buffer command reads the values of the chunk straight into the buffer.
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param start_offset_cmd_name Command which sets the start offset, with a single int32 value
+ * @param buffer_cmd_name       Command which reads a chunk of the buffer
+ * @param buffer                Array of length values of the type of the buffer command, see xvf_param_type_t
+ * @param length                Number of values of the buffer
+ * @return                      CONTROL_SUCCESS (0), or the error
+ * @note The commands which select the buffer, such as SPECIAL_CMD_AEC_FAR_MIC_INDEX, must be set first
+ * @note The reads and writes of other threads run between two chunks, so they don't wait for the whole buffer,
+ * while the buffer transfers of other threads wait for this one to complete
+ */
+int xvf_control_get_buffer(xvf_control_t * ctrl, const char * start_offset_cmd_name, const char * buffer_cmd_name, void * buffer, size_t length);
+
+/**
+ * @brief Write a buffer which is transferred in chunks, such as a filter
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param start_offset_cmd_name Command which sets the start offset, with a single int32 value
+ * @param buffer_cmd_name       Command which writes a chunk of the buffer
+ * @param buffer                Array of length values of the type of the buffer command, see xvf_param_type_t
+ * @param length                Number of values of the buffer, the last chunk is padded with zeros
+ * @return                      CONTROL_SUCCESS (0), or the error
+ */
+int xvf_control_set_buffer(xvf_control_t * ctrl, const char * start_offset_cmd_name, const char * buffer_cmd_name, const void * buffer, size_t length);
+
+/**
+ * @brief Read the AEC filter of a (far end, mic) pair
+ *
+ * The filter length is read, SHF_BYPASS is set, the pair is selected with SPECIAL_CMD_AEC_FAR_MIC_INDEX
+ * and the filter is read in chunks, as xvf_host does, then SHF_BYPASS is cleared even if the transfer fails.
+ * This runs as a single buffer transfer holding the bus arbiter, so no other transfer can change the selection.
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param far_index             Far end index
+ * @param mic_index             Mic index
+ * @param buffer                Array of *length values of the type of SPECIAL_CMD_AEC_FILTER_COEFFS, NULL to only read the length
+ * @param length                Number of values the buffer holds, set to the filter length
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the buffer is too short
+ */
+int xvf_control_get_aec_filter(xvf_control_t * ctrl, int32_t far_index, int32_t mic_index, void * buffer, size_t * length);
+
+/**
+ * @brief Write the AEC filter of a (far end, mic) pair, in the order of xvf_control_get_aec_filter()
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param far_index             Far end index
+ * @param mic_index             Mic index
+ * @param buffer                Array of length values of the type of SPECIAL_CMD_AEC_FILTER_COEFFS
+ * @param length                Number of values of the buffer, the filter length
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the length does not match
+ */
+int xvf_control_set_aec_filter(xvf_control_t * ctrl, int32_t far_index, int32_t mic_index, const void * buffer, size_t length);
+
+/**
+ * @brief Read the NLModel buffer of a band
+ *
+ * The band is selected with SPECIAL_CMD_PP_NLMODEL_BAND, if the firmware has it, the size is read,
+ * and SPECIAL_CMD_NLMODEL_START starts the chunked read, as a single buffer transfer holding the bus arbiter.
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param band_index            Band index, only 0 if the firmware does not have SPECIAL_CMD_PP_NLMODEL_BAND
+ * @param buffer                Array of *length values of the type of SPECIAL_CMD_PP_NLMODEL, row by row, NULL to only read the size
+ * @param length                Number of values the buffer holds, set to the number of rows times the number of columns
+ * @param num_cols              Set to the number of columns
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the buffer is too short
+ */
+int xvf_control_get_nlmodel(xvf_control_t * ctrl, uint8_t band_index, void * buffer, size_t * length, size_t * num_cols);
+
+/**
+ * @brief Write the NLModel buffer of a band, in the order of xvf_control_get_nlmodel()
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param band_index            Band index, only 0 if the firmware does not have SPECIAL_CMD_PP_NLMODEL_BAND
+ * @param buffer                Array of num_rows x num_cols values of the type of SPECIAL_CMD_PP_NLMODEL, row by row
+ * @param num_rows              Number of rows, as given by the device
+ * @param num_cols              Number of columns, as given by the device
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the size does not match
+ */
+int xvf_control_set_nlmodel(xvf_control_t * ctrl, uint8_t band_index, const void * buffer, size_t num_rows, size_t num_cols);
+
+/**
+ * @brief Read the equalization filter
+ *
+ * The number of bands is read and SPECIAL_CMD_EQUALIZATION_START starts the chunked read,
+ * as a single buffer transfer holding the bus arbiter.
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param buffer                Array of *length values of the type of SPECIAL_CMD_PP_EQUALIZATION, NULL to only read the length
+ * @param length                Number of values the buffer holds, set to the number of bands
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the buffer is too short
+ */
+int xvf_control_get_eq_filter(xvf_control_t * ctrl, void * buffer, size_t * length);
+
+/**
+ * @brief Write the equalization filter, in the order of xvf_control_get_eq_filter()
+ *
+ * @param ctrl                  Handle from xvf_control_open()
+ * @param buffer                Array of length values of the type of SPECIAL_CMD_PP_EQUALIZATION
+ * @param length                Number of values of the buffer, the number of bands
+ * @return                      CONTROL_SUCCESS (0), or the error, XVF_CONTROL_ERROR if the length does not match
+ */
+int xvf_control_set_eq_filter(xvf_control_t * ctrl, const void * buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
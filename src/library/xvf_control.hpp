@@ -0,0 +1,178 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+/**
+ * @file xvf_control.hpp
+ * @brief C++ wrapper of the xvf_control library
+ *
+ * The wrapper only uses the C interface, so an application can use a library
+ * built with a different compiler. Errors are thrown as XvfControlError.
+ */
+
+#ifndef XVF_CONTROL_HPP_
+#define XVF_CONTROL_HPP_
+
+#include "xvf_control.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** @brief Exception for the errors returned by the xvf_control library */
+class XvfControlError : public std::runtime_error
+{
+    public:
+
+        /** @brief control_ret_t returned by the device, or XVF_CONTROL_ERROR */
+        const int code;
+
+        /**
+         * @brief Construct a new XvfControlError object
+         *
+         * @param msg       Error message
+         * @param _code     control_ret_t returned by the device, or XVF_CONTROL_ERROR
+         */
+        XvfControlError(const std::string & msg, int _code) : std::runtime_error(msg), code(_code) {}
+};
+
+/** @brief Class for reading and writing the device parameters by name */
+class XvfControl
+{
+    private:
+
+        /** @brief Handle from xvf_control_open() */
+        xvf_control_t * ctrl = nullptr;
+
+        /** @brief Throw the last error if a C function failed */
+        static void check(int ret)
+        {
+            if(ret != 0)
+            {
+                throw XvfControlError(xvf_control_last_error(), ret);
+            }
+        }
+
+        /** @brief Check the value type matches the command type */
+        template<typename T>
+        static void check_value_type(const std::string & cmd_name, const xvf_cmd_info_t & info)
+        {
+            const size_t value_size = ((info.type == XVF_TYPE_CHAR) || (info.type == XVF_TYPE_UINT8)) ? 1 : 4;
+            if(sizeof(T) != value_size)
+            {
+                throw XvfControlError("Command " + cmd_name + " needs values of " + std::to_string(value_size) + " bytes", XVF_CONTROL_ERROR);
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Connect to the device, see xvf_control_open()
+         *
+         * @param command_map_path      Path to the command_map library, empty for the one in lib_dir
+         * @param lib_dir               Directory of the device driver libraries, empty for the directory of the executable
+         * @param protocol              "i2c", "spi" or "usb", empty for the default driver
+         * @param bypass_range_check    Write values without checking their range
+         */
+        XvfControl(const std::string & command_map_path = "", const std::string & lib_dir = "", const std::string & protocol = "", bool bypass_range_check = false)
+        {
+            check(xvf_control_open(command_map_path.empty() ? nullptr : command_map_path.c_str(),
+                                   lib_dir.empty() ? nullptr : lib_dir.c_str(),
+                                   protocol.empty() ? nullptr : protocol.c_str(),
+                                   bypass_range_check, &ctrl));
+        }
+
+        XvfControl(const XvfControl &) = delete;
+        XvfControl & operator=(const XvfControl &) = delete;
+
+        /** @brief Disconnect from the device */
+        ~XvfControl()
+        {
+            xvf_control_close(ctrl);
+        }
+
+        /** @brief Get the names of all the commands */
+        std::vector<std::string> command_names() const
+        {
+            std::vector<std::string> names;
+            for(size_t i = 0; i < xvf_control_num_commands(ctrl); i++)
+            {
+                names.push_back(xvf_control_command_name(ctrl, i));
+            }
+            return names;
+        }
+
+        /**
+         * @brief Get the information of a command
+         *
+         * @param cmd_name      Command name, in any case
+         */
+        xvf_cmd_info_t info(const std::string & cmd_name)
+        {
+            xvf_cmd_info_t cmd_info;
+            check(xvf_control_get_info(ctrl, cmd_name.c_str(), &cmd_info));
+            return cmd_info;
+        }
+
+        /**
+         * @brief Read the values of a command
+         *
+         * @tparam T            Value type: char or uint8_t, int32_t, uint32_t or float, see xvf_param_type_t
+         * @param cmd_name      Command name, in any case
+         */
+        template<typename T>
+        std::vector<T> get(const std::string & cmd_name)
+        {
+            const xvf_cmd_info_t cmd_info = info(cmd_name);
+            check_value_type<T>(cmd_name, cmd_info);
+            std::vector<T> values(cmd_info.num_values);
+            check(xvf_control_get(ctrl, cmd_name.c_str(), values.data(), values.size()));
+            return values;
+        }
+
+        /**
+         * @brief Write the values of a command
+         *
+         * @tparam T            Value type: uint8_t, int32_t, uint32_t or float, see xvf_param_type_t
+         * @param cmd_name      Command name, in any case
+         * @param values        Values to write, as many as the command has
+         */
+        template<typename T>
+        void set(const std::string & cmd_name, const std::vector<T> & values)
+        {
+            check_value_type<T>(cmd_name, info(cmd_name));
+            check(xvf_control_set(ctrl, cmd_name.c_str(), values.data(), values.size()));
+        }
+
+        /**
+         * @brief Read a buffer which is transferred in chunks, see xvf_control_get_buffer()
+         *
+         * @tparam T                    Value type of the buffer command
+         * @param start_offset_cmd_name Command which sets the start offset
+         * @param buffer_cmd_name       Command which reads a chunk of the buffer
+         * @param length                Number of values of the buffer
+         */
+        template<typename T>
+        std::vector<T> get_buffer(const std::string & start_offset_cmd_name, const std::string & buffer_cmd_name, size_t length)
+        {
+            check_value_type<T>(buffer_cmd_name, info(buffer_cmd_name));
+            std::vector<T> buffer(length);
+            check(xvf_control_get_buffer(ctrl, start_offset_cmd_name.c_str(), buffer_cmd_name.c_str(), buffer.data(), buffer.size()));
+            return buffer;
+        }
+
+        /**
+         * @brief Write a buffer which is transferred in chunks, see xvf_control_set_buffer()
+         *
+         * @tparam T                    Value type of the buffer command
+         * @param start_offset_cmd_name Command which sets the start offset
+         * @param buffer_cmd_name       Command which writes a chunk of the buffer
+         * @param buffer                Values of the buffer
+         */
+        template<typename T>
+        void set_buffer(const std::string & start_offset_cmd_name, const std::string & buffer_cmd_name, const std::vector<T> & buffer)
+        {
+            check_value_type<T>(buffer_cmd_name, info(buffer_cmd_name));
+            check(xvf_control_set_buffer(ctrl, start_offset_cmd_name.c_str(), buffer_cmd_name.c_str(), buffer.data(), buffer.size()));
+        }
+};
+
+#endif
@@ -0,0 +1,276 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+"""Python bindings of the xvf_control library
+
+The bindings call the C interface in xvf_control.h through ctypes, so one device
+session stays open for all the operations instead of starting xvf_host for each one.
+Values are NumPy arrays: the library writes the values it reads straight into the
+memory of the array, and reads the values it writes straight from it.
+"""
+
+import ctypes
+import platform
+from collections import namedtuple
+from pathlib import Path
+
+import numpy as np
+
+XVF_CONTROL_ERROR = -1
+
+# xvf_param_type_t
+XVF_TYPE_CHAR = 0
+XVF_TYPE_UINT8 = 1
+XVF_TYPE_INT32 = 2
+XVF_TYPE_FLOAT = 3
+XVF_TYPE_UINT32 = 4
+XVF_TYPE_RADIANS = 5
+
+# xvf_cmd_rw_t
+XVF_CMD_RO = 0
+XVF_CMD_WO = 1
+XVF_CMD_RW = 2
+
+_DTYPES = {
+    XVF_TYPE_CHAR: np.uint8,
+    XVF_TYPE_UINT8: np.uint8,
+    XVF_TYPE_INT32: np.int32,
+    XVF_TYPE_FLOAT: np.float32,
+    XVF_TYPE_UINT32: np.uint32,
+    XVF_TYPE_RADIANS: np.float32,
+}
+
+_LIB_NAMES = {"Linux": "libxvf_control.so", "Darwin": "libxvf_control.dylib", "Windows": "xvf_control.dll"}
+
+
+class _CmdInfo(ctypes.Structure):
+    _fields_ = [
+        ("res_id", ctypes.c_uint8),
+        ("cmd_id", ctypes.c_uint8),
+        ("type", ctypes.c_uint8),
+        ("rw", ctypes.c_uint8),
+        ("num_values", ctypes.c_uint32),
+    ]
+
+
+CommandInfo = namedtuple("CommandInfo", ["name", "res_id", "cmd_id", "type", "rw", "num_values", "dtype"])
+
+
+class XvfControlError(Exception):
+    """Error returned by the xvf_control library
+
+    code is the control_ret_t returned by the device, or XVF_CONTROL_ERROR
+    """
+
+    def __init__(self, msg, code):
+        super().__init__(msg)
+        self.code = code
+
+
+def load_library(library_path=None):
+    """Load the xvf_control library and declare its functions
+
+    library_path defaults to the library next to this file
+    """
+    if library_path is None:
+        library_path = Path(__file__).parent / _LIB_NAMES[platform.system()]
+    lib = ctypes.CDLL(str(library_path))
+
+    handle = ctypes.c_void_p
+    lib.xvf_control_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.POINTER(handle)]
+    lib.xvf_control_close.argtypes = [handle]
+    lib.xvf_control_close.restype = None
+    lib.xvf_control_last_error.argtypes = []
+    lib.xvf_control_last_error.restype = ctypes.c_char_p
+    lib.xvf_control_num_commands.argtypes = [handle]
+    lib.xvf_control_num_commands.restype = ctypes.c_size_t
+    lib.xvf_control_command_name.argtypes = [handle, ctypes.c_size_t]
+    lib.xvf_control_command_name.restype = ctypes.c_char_p
+    lib.xvf_control_get_info.argtypes = [handle, ctypes.c_char_p, ctypes.POINTER(_CmdInfo)]
+    for name in ("xvf_control_get", "xvf_control_set", "xvf_control_get_buffer", "xvf_control_set_buffer"):
+        getattr(lib, name).restype = ctypes.c_int
+    lib.xvf_control_get.argtypes = [handle, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_set.argtypes = [handle, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_get_buffer.argtypes = [handle, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_set_buffer.argtypes = [handle, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    size_p = ctypes.POINTER(ctypes.c_size_t)
+    for name in ("xvf_control_get_aec_filter", "xvf_control_set_aec_filter", "xvf_control_get_nlmodel",
+                 "xvf_control_set_nlmodel", "xvf_control_get_eq_filter", "xvf_control_set_eq_filter"):
+        getattr(lib, name).restype = ctypes.c_int
+    lib.xvf_control_get_aec_filter.argtypes = [handle, ctypes.c_int32, ctypes.c_int32, ctypes.c_void_p, size_p]
+    lib.xvf_control_set_aec_filter.argtypes = [handle, ctypes.c_int32, ctypes.c_int32, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_get_nlmodel.argtypes = [handle, ctypes.c_uint8, ctypes.c_void_p, size_p, size_p]
+    lib.xvf_control_set_nlmodel.argtypes = [handle, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t]
+    lib.xvf_control_get_eq_filter.argtypes = [handle, ctypes.c_void_p, size_p]
+    lib.xvf_control_set_eq_filter.argtypes = [handle, ctypes.c_void_p, ctypes.c_size_t]
+    return lib
+
+
+class XvfControl:
+    """Device session of the xvf_control library
+
+    The session reads and writes the parameters by name, in any case, and can be used as a context manager.
+    Several threads can use the same session, the library runs their transactions one at a time.
+    """
+
+    def __init__(self, lib_dir=None, protocol=None, command_map_path=None, bypass_range_check=False, library_path=None):
+        """Connect to the device, see xvf_control_open()
+
+        lib_dir is the directory of the command map and of the device drivers,
+        protocol is "i2c", "spi" or "usb" and library_path is the path to the xvf_control library
+        """
+        self._lib = load_library(library_path)
+        self._ctrl = ctypes.c_void_p()
+        self._info = {}
+        self._check(self._lib.xvf_control_open(
+            None if command_map_path is None else str(command_map_path).encode(),
+            None if lib_dir is None else str(lib_dir).encode(),
+            None if protocol is None else protocol.encode(),
+            int(bypass_range_check), ctypes.byref(self._ctrl)))
+
+    def close(self):
+        """Disconnect from the device"""
+        if self._ctrl:
+            self._lib.xvf_control_close(self._ctrl)
+            self._ctrl = ctypes.c_void_p()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        if hasattr(self, "_ctrl"):
+            self.close()
+
+    def _check(self, ret):
+        if ret != 0:
+            raise XvfControlError(self._lib.xvf_control_last_error().decode(), ret)
+
+    def command_names(self):
+        """Get the names of all the commands"""
+        return [self._lib.xvf_control_command_name(self._ctrl, i).decode()
+                for i in range(self._lib.xvf_control_num_commands(self._ctrl))]
+
+    def info(self, cmd_name):
+        """Get the information of a command, looked up once per session"""
+        key = cmd_name.upper()
+        cmd_info = self._info.get(key)
+        if cmd_info is None:
+            c_info = _CmdInfo()
+            self._check(self._lib.xvf_control_get_info(self._ctrl, key.encode(), ctypes.byref(c_info)))
+            cmd_info = CommandInfo(key, c_info.res_id, c_info.cmd_id, c_info.type, c_info.rw, c_info.num_values, _DTYPES[c_info.type])
+            self._info[key] = cmd_info
+        return cmd_info
+
+    @staticmethod
+    def _check_array(cmd_name, array, dtype, length):
+        if array.dtype != dtype or array.size < length or not array.flags.c_contiguous or not array.flags.writeable:
+            raise XvfControlError(f"Command {cmd_name} needs a writeable contiguous array of {length} {np.dtype(dtype).name} values",
+                                  XVF_CONTROL_ERROR)
+
+    def get(self, cmd_name, out=None):
+        """Read the values of a command
+
+        The values are read into out if given, otherwise into a new array.
+        Char commands are returned as a string.
+        """
+        cmd_info = self.info(cmd_name)
+        if out is None:
+            out = np.empty(cmd_info.num_values, dtype=cmd_info.dtype)
+        else:
+            self._check_array(cmd_name, out, cmd_info.dtype, cmd_info.num_values)
+        self._check(self._lib.xvf_control_get(self._ctrl, cmd_info.name.encode(), out.ctypes.data, out.size))
+        if cmd_info.type == XVF_TYPE_CHAR:
+            return out.tobytes().split(b"\0", 1)[0].decode()
+        return out
+
+    def set(self, cmd_name, values):
+        """Write the values of a command
+
+        values is a sequence or an array, an array of the type of the command is not copied
+        """
+        cmd_info = self.info(cmd_name)
+        array = np.ascontiguousarray(values, dtype=cmd_info.dtype)
+        self._check(self._lib.xvf_control_set(self._ctrl, cmd_info.name.encode(), array.ctypes.data, array.size))
+
+    def get_many(self, cmd_names):
+        """Read several commands in this session, returns a dictionary of the values by command name"""
+        return {name: self.get(name) for name in cmd_names}
+
+    def set_many(self, values):
+        """Write several commands in order from a dictionary of the values by command name"""
+        for name, cmd_values in values.items():
+            self.set(name, cmd_values)
+
+    def get_buffer(self, start_offset_cmd_name, buffer_cmd_name, length, out=None):
+        """Read a buffer which is transferred in chunks, see xvf_control_get_buffer()
+
+        The chunks are read into out if given, otherwise into a new array.
+        """
+        dtype = self.info(buffer_cmd_name).dtype
+        if out is None:
+            out = np.empty(length, dtype=dtype)
+        else:
+            self._check_array(buffer_cmd_name, out, dtype, length)
+        self._check(self._lib.xvf_control_get_buffer(self._ctrl, start_offset_cmd_name.encode(), buffer_cmd_name.encode(),
+                                                     out.ctypes.data, length))
+        return out
+
+    def set_buffer(self, start_offset_cmd_name, buffer_cmd_name, values):
+        """Write a buffer which is transferred in chunks, see xvf_control_set_buffer()"""
+        array = np.ascontiguousarray(values, dtype=self.info(buffer_cmd_name).dtype)
+        self._check(self._lib.xvf_control_set_buffer(self._ctrl, start_offset_cmd_name.encode(), buffer_cmd_name.encode(),
+                                                     array.ctypes.data, array.size))
+
+    def _get_filter(self, buffer_cmd_name, get, out):
+        """Read a filter with one of the xvf_control_get_*_filter() functions, get(buffer, length) calls it
+
+        Without out, a first call reads the size of the filter. Each call selects the filter and reads its size
+        again in a single transfer, so the threads sharing the session cannot change the selection meanwhile.
+        """
+        dtype = self.info(buffer_cmd_name).dtype
+        length = ctypes.c_size_t(0)
+        if out is None:
+            self._check(get(None, ctypes.byref(length)))
+            out = np.empty(length.value, dtype=dtype)
+        else:
+            self._check_array(buffer_cmd_name, out, dtype, 0)
+            length.value = out.size
+        self._check(get(out.ctypes.data, ctypes.byref(length)))
+        return out[:length.value]
+
+    def get_aec_filter(self, far_index, mic_index, out=None):
+        """Read the AEC filter of a (far end, mic) pair, see xvf_control_get_aec_filter()"""
+        return self._get_filter("SPECIAL_CMD_AEC_FILTER_COEFFS", lambda buffer, length: self._lib.xvf_control_get_aec_filter(
+            self._ctrl, far_index, mic_index, buffer, length), out)
+
+    def set_aec_filter(self, far_index, mic_index, values):
+        """Write the AEC filter of a (far end, mic) pair, see xvf_control_set_aec_filter()"""
+        array = np.ascontiguousarray(values, dtype=self.info("SPECIAL_CMD_AEC_FILTER_COEFFS").dtype)
+        self._check(self._lib.xvf_control_set_aec_filter(self._ctrl, far_index, mic_index, array.ctypes.data, array.size))
+
+    def get_nlmodel_buffer(self, band_index=0):
+        """Read the NLModel buffer of a band as a rows x columns array, see xvf_control_get_nlmodel()"""
+        num_cols = ctypes.c_size_t(0)
+        out = self._get_filter("SPECIAL_CMD_PP_NLMODEL", lambda buffer, length: self._lib.xvf_control_get_nlmodel(
+            self._ctrl, band_index, buffer, length, ctypes.byref(num_cols)), None)
+        return out.reshape(-1, num_cols.value)
+
+    def set_nlmodel_buffer(self, values, band_index=0):
+        """Write the NLModel buffer of a band from a rows x columns array, see xvf_control_set_nlmodel()"""
+        array = np.ascontiguousarray(values, dtype=self.info("SPECIAL_CMD_PP_NLMODEL").dtype)
+        if array.ndim != 2:
+            raise XvfControlError(f"NLModel buffer must be a rows x columns array, {array.shape} is given", XVF_CONTROL_ERROR)
+        self._check(self._lib.xvf_control_set_nlmodel(self._ctrl, band_index, array.ctypes.data, array.shape[0], array.shape[1]))
+
+    def get_eq_filter(self):
+        """Read the equalization filter, see xvf_control_get_eq_filter()"""
+        return self._get_filter("SPECIAL_CMD_PP_EQUALIZATION", lambda buffer, length: self._lib.xvf_control_get_eq_filter(
+            self._ctrl, buffer, length), None)
+
+    def set_eq_filter(self, values):
+        """Write the equalization filter, see xvf_control_set_eq_filter()"""
+        array = np.ascontiguousarray(values, dtype=self.info("SPECIAL_CMD_PP_EQUALIZATION").dtype)
+        self._check(self._lib.xvf_control_set_eq_filter(self._ctrl, array.ctypes.data, array.size))
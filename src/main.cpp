@@ -2,10 +2,25 @@
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
 #include "special_commands.hpp"
+#include "app_options.hpp"
 
 using namespace std;
 
-int main(int argc, char ** argv)
+/** @brief Convert a time in seconds given after --read-capture, exits if it is not a number */
+static double get_seconds_arg(const string arg)
+{
+    char * end = nullptr;
+    double value = strtod(arg.c_str(), &end);
+    if(arg.empty() || (*end != '\0'))
+    {
+        cerr << "Invalid time " << arg << " provided after the --read-capture option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    return value;
+}
+
+/** @brief Run the application, errors from the command and device layers are thrown as host_app_error */
+static int run_host_app(int argc, char ** argv)
 {
     if(argc == 1)
     {
@@ -14,11 +29,22 @@ int main(int argc, char ** argv)
         return 0;
     }
 
+    if(get_profile_startup(&argc, argv))
+    {
+        enable_startup_profile();
+    }
     string command_map_path = get_cmd_map_abs_path(&argc, argv);
     string device_dl_name = get_device_lib_name(&argc, argv, options, num_options);
     bool bypass_range_check = get_bypass_range_check(&argc, argv);
+    bool bus_lock = get_bus_lock(&argc, argv);
+    plan_optimise_t optimise = get_plan_optimise_options(&argc, argv);
+    cache_config_t cache_config = get_cache_options(&argc, argv);
+    dump_config_t dump_config = get_dump_options(&argc, argv);
+    watch_config_t watch_config = get_watch_options(&argc, argv);
+    wait_config_t wait_config = get_wait_options(&argc, argv);
 
     uint8_t band_index = get_band_option(&argc, argv); // band_index can be present anywhere on the cmd line. Get it first
+    startup_profile_mark("Options");
 
     opt_t * opt = nullptr;
     int cmd_indx = 1;
@@ -38,6 +64,34 @@ int main(int argc, char ** argv)
         }
     }
 
+    if(next_cmd[0] == '-')
+    {
+        // Boot apply loads the command map and the device driver itself to time each step
+        if (opt->long_name == "--boot-apply")
+        {
+            int arg_indx = cmd_indx + 1;
+            if(arg_indx >= argc)
+            {
+                cerr << "Missing plan file name" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            return boot_apply(command_map_path, device_dl_name, bypass_range_check, bus_lock, optimise, argv[arg_indx]);
+        }
+        // Capture files describe their own layout, so neither the command map nor the device is needed
+        if (opt->long_name == "--read-capture")
+        {
+            int arg_indx = cmd_indx + 1;
+            if(arg_indx >= argc)
+            {
+                cerr << "Missing capture file name" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            double from_s = (arg_indx + 1 < argc) ? get_seconds_arg(argv[arg_indx + 1]) : 0.0;
+            double to_s = (arg_indx + 2 < argc) ? get_seconds_arg(argv[arg_indx + 2]) : 0.0;
+            return read_capture_file(argv[arg_indx], from_s, to_s, cout);
+        }
+    }
+
     dl_handle_t cmd_map_handle = load_command_map_dll(command_map_path);
 
     if(next_cmd[0] == '-')
@@ -48,24 +102,43 @@ int main(int argc, char ** argv)
         {
             return print_command_list();
         }
+        if (opt->long_name == "--compile-command-list")
+        {
+            check_range_fptr check_range = (bypass_range_check) ? nullptr : check_values_in_range;
+            int arg_indx = cmd_indx + 1;
+            if(arg_indx >= argc)
+            {
+                return compile_cmd_list(check_range, optimise);
+            }
+            else if(arg_indx + 1 >= argc)
+            {
+                return compile_cmd_list(check_range, optimise, argv[arg_indx]);
+            }
+            else
+            {
+                return compile_cmd_list(check_range, optimise, argv[arg_indx], argv[arg_indx + 1]);
+            }
+        }
     }
 
-    string device_dl_path = get_dynamic_lib_path(device_dl_name);
-    dl_handle_t device_handle = get_dynamic_lib(device_dl_path);
-    int * device_init_info = get_device_init_info(cmd_map_handle, device_dl_name);
-
-    print_args_fptr print_args = get_print_args_fptr(cmd_map_handle);
-    check_range_fptr check_range = get_check_range_fptr(cmd_map_handle);
-    device_fptr make_dev = get_device_fptr(device_handle);
-    Device * device = make_dev(device_init_info);
+    Device * device = load_device(cmd_map_handle, device_dl_name);
+    if(bus_lock)
+    {
+        device->enable_arbitration();
+    }
 
     Command command(device, bypass_range_check, cmd_map_handle);
+    command.configure_cache(cache_config);
 
     int arg_indx = cmd_indx + 1;
     next_cmd = argv[cmd_indx];
 
     if (next_cmd[0] != '-')
     {
+        if(is_cmd_batch(argv, argc, cmd_indx))
+        {
+            return execute_cmd_batch(&command, optimise, argv, argc, cmd_indx);
+        }
         return command.do_command(next_cmd, argv, argc, arg_indx);
     }
     else
@@ -74,19 +147,97 @@ int main(int argc, char ** argv)
         // Hence opt holds the same option pointer
         if(opt->long_name == "--dump-params")
         {
-            return dump_params(&command);
+            if(arg_indx >= argc)
+            {
+                return dump_params(&command, dump_config);
+            }
+            else
+            {
+                return dump_params(&command, dump_config, argv[arg_indx]);
+            }
+        }
+        if(opt->long_name == "--watch")
+        {
+            if(arg_indx >= argc)
+            {
+                cerr << "No commands provided after the --watch option" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            else if(arg_indx + 1 >= argc)
+            {
+                return watch_params(&command, argv[arg_indx], watch_config);
+            }
+            else
+            {
+                return watch_params(&command, argv[arg_indx], watch_config, argv[arg_indx + 1]);
+            }
+        }
+        if(opt->long_name == "--publish")
+        {
+            if(arg_indx >= argc)
+            {
+                cerr << "No commands provided after the --publish option" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            else if(arg_indx + 1 >= argc)
+            {
+                return publish_params(&command, argv[arg_indx], watch_config);
+            }
+            else
+            {
+                return publish_params(&command, argv[arg_indx], watch_config, argv[arg_indx + 1]);
+            }
+        }
+        if(opt->long_name == "--wait-for")
+        {
+            if(arg_indx >= argc)
+            {
+                cerr << "No condition provided after the --wait-for option" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            return wait_for_condition(&command, argv[arg_indx], wait_config);
+        }
+        if(opt->long_name == "--snapshot")
+        {
+            if(arg_indx >= argc)
+            {
+                return snapshot_params(&command);
+            }
+            else
+            {
+                return snapshot_params(&command, argv[arg_indx]);
+            }
+        }
+        if(opt->long_name == "--restore")
+        {
+            if(arg_indx >= argc)
+            {
+                return restore_params(&command);
+            }
+            else
+            {
+                return restore_params(&command, argv[arg_indx]);
+            }
         }
         if(opt->long_name == "--execute-command-list")
         {
             if(arg_indx >= argc)
             {
-                return execute_cmd_list(&command);
+                return execute_cmd_list(&command, optimise);
             }
             else
             {
-                return execute_cmd_list(&command, argv[arg_indx]);
+                return execute_cmd_list(&command, optimise, argv[arg_indx]);
             }
         }
+        if(opt->long_name == "--interactive")
+        {
+            return interactive_session(&command);
+        }
+        if(opt->long_name == "--stdin")
+        {
+            return stdin_session(&command);
+        }
         if(opt->long_name == "--get-aec-filter")
         {
             if(arg_indx >= argc)
@@ -166,3 +317,21 @@ int main(int argc, char ** argv)
     cout << "Host application behaved unexpectedly, please report this issue" << endl;
     return -1;
 }
+
+int main(int argc, char ** argv)
+{
+    int ret;
+    try
+    {
+        ret = run_host_app(argc, argv);
+    }
+    catch(const host_app_error & e)
+    {
+        cerr << e.what() << endl;
+        ret = e.code;
+    }
+    startup_profile_mark("Commands");
+    // On stderr, as stdout may hold JSON lines, binary records or a dump
+    print_startup_profile(cerr);
+    return ret;
+}
@@ -0,0 +1,95 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "special_commands.hpp"
+#include <chrono>
+#include <iomanip>
+
+using namespace std;
+
+using boot_clock_t = chrono::steady_clock;
+
+/**
+ * @brief Time when the static objects of the application are initialised
+ *
+ * This is the closest point to the process start which is available on every platform,
+ * it only misses the time spent by the dynamic loader on the libraries linked at build time.
+ */
+static const boot_clock_t::time_point process_start_time = boot_clock_t::now();
+
+/** @brief Print a single line of the boot time breakdown */
+static void print_boot_step(const string name, boot_clock_t::time_point start, boot_clock_t::time_point end)
+{
+    double ms = chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1e6;
+    cout << left << setw(22) << name + ":" << right << setw(10) << ms << " ms" << endl;
+}
+
+control_ret_t boot_apply(const string command_map_path, const string device_dl_name, bool bypass_range_check, bool bus_lock, plan_optimise_t optimise, const string filename)
+{
+    const boot_clock_t::time_point apply_start = boot_clock_t::now();
+
+    dl_handle_t cmd_map_handle = load_command_map_dll(command_map_path);
+    const boot_clock_t::time_point cmd_map_loaded = boot_clock_t::now();
+
+    Device * device = load_device(cmd_map_handle, device_dl_name);
+    if(bus_lock)
+    {
+        device->enable_arbitration();
+    }
+    const boot_clock_t::time_point device_loaded = boot_clock_t::now();
+
+    // The plan has been checked when it was compiled, so the commands are not resolved again
+    // unless the unchanged writes are skipped, which needs to know the readable commands
+    CommandPlan plan;
+    plan.load_binary(filename, nullptr, optimise.skip_unchanged);
+    check_plan_writable(plan, filename);
+    const boot_clock_t::time_point plan_loaded = boot_clock_t::now();
+
+    Command command(device, bypass_range_check, cmd_map_handle);
+    command.open_device();
+    const boot_clock_t::time_point device_ready = boot_clock_t::now();
+
+    BusArbiter * arbiter = command.get_arbiter();
+    control_ret_t ret;
+    size_t num_runs;
+    boot_clock_t::time_point plan_optimised, last_ack;
+    {
+        BusArbiterLock section(arbiter);
+        optimise_cmd_plan(&plan, &command, optimise);
+        num_runs = plan.group_by_resource();
+        plan_optimised = boot_clock_t::now();
+
+        ret = plan.execute(&command, optimise.out_of_order);
+        last_ack = boot_clock_t::now();
+    }
+
+    const size_t num_ops = plan.get_ops().size();
+    vector<bool> is_resource_used(1 << (8 * sizeof(control_resid_t)), false);
+    size_t num_resources = 0;
+    for(const plan_op_t & op : plan.get_ops())
+    {
+        if(!is_resource_used[op.cmd.res_id])
+        {
+            is_resource_used[op.cmd.res_id] = true;
+            num_resources++;
+        }
+    }
+
+    cout << "Applied " << num_ops << " commands from " << filename << " to "
+    << num_resources << " resources in " << num_runs << " runs" << endl;
+    cout << fixed << setprecision(3);
+    print_boot_step("Startup", process_start_time, apply_start);
+    print_boot_step("Command map load", apply_start, cmd_map_loaded);
+    print_boot_step("Device driver load", cmd_map_loaded, device_loaded);
+    print_boot_step("Plan load", device_loaded, plan_loaded);
+    print_boot_step("Device init", plan_loaded, device_ready);
+    print_boot_step("Plan optimise", device_ready, plan_optimised);
+    if(arbiter != nullptr)
+    {
+        // Included in the time of the plan optimisation
+        cout << left << setw(22) << "Bus lock wait:" << right << setw(10) << arbiter->get_stats().total_wait_us / 1e3 << " ms" << endl;
+    }
+    print_boot_step("Commands", plan_optimised, last_ack);
+    print_boot_step("Time to last ACK", process_start_time, last_ack);
+    return ret;
+}
@@ -0,0 +1,199 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "capture_file.hpp"
+#include <atomic>
+#include <chrono>
+
+#if (defined(__linux__) || defined(__APPLE__))
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(capture_header_t) == 48, "Capture file header must not have padding");
+static_assert(sizeof(atomic<uint64_t>) == sizeof(uint64_t), "Record counter must be usable in place");
+
+#if (defined(__linux__) || defined(__APPLE__))
+
+/** @brief Get the record counter of a mapped header, which is shared with another process */
+static atomic<uint64_t> * get_num_written(const capture_header_t * header)
+{
+    return reinterpret_cast<atomic<uint64_t> *>(const_cast<uint64_t *>(&header->num_written));
+}
+
+CaptureWriter::CaptureWriter(const string filename, const vector<cmd_t> & cmds, size_t capacity, unsigned interval_us)
+{
+    const vector<uint8_t> descriptors = encode_watch_descriptors(cmds);
+    const size_t record_size = get_watch_record_size(cmds);
+    const size_t data_offset = (sizeof(capture_header_t) + descriptors.size() + CAPTURE_FILE_ALIGNMENT - 1) / CAPTURE_FILE_ALIGNMENT * CAPTURE_FILE_ALIGNMENT;
+    map_size = data_offset + capacity * record_size;
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        cerr << "Could not open a file " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    // Allocate the whole file now, so writing a record never has to extend it
+#if defined(__linux__)
+    int ret = posix_fallocate(fd, 0, map_size);
+#else
+    int ret = ftruncate(fd, map_size);
+#endif
+    if(ret != 0)
+    {
+        cerr << "Could not allocate " << map_size << " bytes for " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    void * addr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        cerr << "Could not map " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    map = static_cast<uint8_t *>(addr);
+    header = reinterpret_cast<capture_header_t *>(map);
+
+    const uint64_t start_time_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    *header = {CAPTURE_FILE_MAGIC, CAPTURE_FILE_VERSION, static_cast<uint16_t>(cmds.size()), static_cast<uint32_t>(record_size),
+               static_cast<uint32_t>(data_offset), capacity, start_time_ns, interval_us, 0, 0};
+    memcpy(map + sizeof(capture_header_t), descriptors.data(), descriptors.size());
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    if(map != nullptr)
+    {
+        munmap(map, map_size);
+    }
+}
+
+void CaptureWriter::append(const uint8_t * record)
+{
+    atomic<uint64_t> * num_written = get_num_written(header);
+    const uint64_t n = num_written->load(memory_order_relaxed);
+    memcpy(map + header->data_offset + (n % header->capacity) * header->record_size, record, header->record_size);
+    // Readers only use the records below the counter
+    num_written->store(n + 1, memory_order_release);
+}
+
+/** @brief Check that the descriptors and the records of a capture file are within the file, one bound at a time so the header values can't overflow */
+static bool is_capture_layout_valid(const capture_header_t * header, size_t file_size)
+{
+    return (header->data_offset >= sizeof(capture_header_t)) && (header->data_offset <= file_size) &&
+           (header->record_size != 0) && (header->capacity != 0) &&
+           (header->capacity <= (file_size - header->data_offset) / header->record_size);
+}
+
+control_ret_t read_capture_file(const string filename, double from_s, double to_s, ostream & os)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if((fd < 0) || (fstat(fd, &st) != 0))
+    {
+        cerr << "Could not open a file " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const size_t file_size = st.st_size;
+    void * addr = (file_size >= sizeof(capture_header_t)) ? mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        cerr << filename << " is not a capture file" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const uint8_t * map = static_cast<const uint8_t *>(addr);
+    const capture_header_t * header = reinterpret_cast<const capture_header_t *>(map);
+
+    vector<cmd_t> cmds;
+    if((header->magic != CAPTURE_FILE_MAGIC) || (header->version != CAPTURE_FILE_VERSION) ||
+       !is_capture_layout_valid(header, file_size) ||
+       (decode_watch_descriptors(map + sizeof(capture_header_t), header->data_offset - sizeof(capture_header_t), header->num_cmds, cmds) == 0) ||
+       (get_watch_record_size(cmds) != header->record_size))
+    {
+        cerr << filename << " is not a valid capture file" << endl;
+        exit(HOST_APP_ERROR);
+    }
+
+    const atomic<uint64_t> * num_written = get_num_written(header);
+    const uint64_t capacity = header->capacity;
+    const size_t record_size = header->record_size;
+    auto get_record = [&](uint64_t n) {return map + header->data_offset + (n % capacity) * record_size;};
+    auto get_time_ns = [](const uint8_t * record) {uint64_t t; memcpy(&t, record, sizeof(t)); return t;};
+
+    const uint64_t last = num_written->load(memory_order_acquire);
+    // The oldest slot is the next one to be written, so it is not used
+    const uint64_t first = (last >= capacity) ? last - capacity + 1 : 0;
+    uint64_t from_ns = 0;
+    uint64_t to_ns = UINT64_MAX;
+    if(last != 0)
+    {
+        const uint64_t latest_ns = get_time_ns(get_record(last - 1));
+        from_ns = (from_s >= 0) ? static_cast<uint64_t>(from_s * 1e9) : latest_ns - min<uint64_t>(latest_ns, static_cast<uint64_t>(-from_s * 1e9));
+        to_ns = (to_s > 0) ? static_cast<uint64_t>(to_s * 1e9) : latest_ns;
+    }
+
+    write_watch_csv_header(os, cmds);
+    vector<uint8_t> record(record_size);
+    vector<char> line(get_watch_csv_line_size(cmds));
+    size_t num_extracted = 0;
+    size_t num_overwritten = 0;
+    for(uint64_t n = first; n < last; n++)
+    {
+        memcpy(record.data(), get_record(n), record_size);
+        atomic_thread_fence(memory_order_acquire);
+        // The slot is being rewritten once the writer has started on record n + capacity
+        if(num_written->load(memory_order_acquire) >= n + capacity)
+        {
+            num_overwritten++;
+            continue;
+        }
+        const uint64_t time_ns = get_time_ns(record.data());
+        if((time_ns < from_ns) || (time_ns > to_ns))
+        {
+            continue;
+        }
+        os.write(line.data(), format_watch_csv_record(line.data(), line.size(), record.data(), cmds));
+        num_extracted++;
+    }
+    os.flush();
+
+    cerr << "Extracted " << num_extracted << " of " << last - first << " records from " << filename
+    << ", capture started at " << header->start_time_ns / 1000000000ULL << " s since the Unix epoch";
+    if(num_overwritten != 0)
+    {
+        cerr << ", " << num_overwritten << " records overwritten while reading";
+    }
+    cerr << endl;
+    munmap(addr, file_size);
+    return CONTROL_SUCCESS;
+}
+
+#else
+
+CaptureWriter::CaptureWriter(const string filename, const vector<cmd_t> & cmds, size_t capacity, unsigned interval_us)
+{
+    cerr << "Capture files are only supported on Linux and Mac" << endl;
+    exit(HOST_APP_ERROR);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+}
+
+void CaptureWriter::append(const uint8_t * record)
+{
+}
+
+control_ret_t read_capture_file(const string filename, double from_s, double to_s, ostream & os)
+{
+    cerr << "Capture files are only supported on Linux and Mac" << endl;
+    exit(HOST_APP_ERROR);
+}
+
+#endif
@@ -0,0 +1,107 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef CAPTURE_FILE_H_
+#define CAPTURE_FILE_H_
+
+#include "watch.hpp"
+
+/** @brief Magic number at the start of a capture file, "XVFC" */
+#define CAPTURE_FILE_MAGIC 0x43465658
+
+/** @brief Version of the capture file format */
+#define CAPTURE_FILE_VERSION 1
+
+/** @brief Alignment of the first record of a capture file */
+#define CAPTURE_FILE_ALIGNMENT 4096
+
+/**
+ * @brief Header at the start of a capture file
+ *
+ * The command descriptors, see encode_watch_descriptors(), follow the header.
+ * The records start at data_offset and are written in a ring: record number n is at
+ * data_offset + (n % capacity) * record_size. The sequence number in each record is the
+ * sampling tick, so gaps show the samples which have been dropped.
+ */
+struct capture_header_t
+{
+    /** CAPTURE_FILE_MAGIC */
+    uint32_t magic;
+    /** CAPTURE_FILE_VERSION */
+    uint16_t version;
+    /** Number of command descriptors */
+    uint16_t num_cmds;
+    /** Size of each record, including the time and the sequence number */
+    uint32_t record_size;
+    /** Offset of the first record from the start of the file */
+    uint32_t data_offset;
+    /** Number of records the file can hold */
+    uint64_t capacity;
+    /** Wall clock time of the first record, in nanoseconds since the Unix epoch */
+    uint64_t start_time_ns;
+    /** Requested time between two records, in microseconds */
+    uint32_t interval_us;
+    /** Reserved, set to 0 */
+    uint32_t reserved;
+    /** Number of records written since the capture started, updated after each record is complete */
+    uint64_t num_written;
+};
+
+/**
+ * @brief Class for writing records into a memory mapped ring capture file
+ *
+ * The whole file is allocated and mapped when it is opened, so appending a record
+ * is a copy into memory and never a system call.
+ */
+class CaptureWriter
+{
+    private:
+
+        /** @brief Start of the mapped file */
+        uint8_t * map = nullptr;
+
+        /** @brief Size of the mapped file */
+        size_t map_size = 0;
+
+        /** @brief Header at the start of the mapped file */
+        capture_header_t * header = nullptr;
+
+    public:
+
+        /**
+         * @brief Create a capture file and map it
+         *
+         * @param filename      File name to write to, an existing file is overwritten
+         * @param cmds          Commands in each record
+         * @param capacity      Number of records the file can hold
+         * @param interval_us   Requested time between two records, in microseconds
+         * @note Exits if the file can't be created
+         */
+        CaptureWriter(const std::string filename, const std::vector<cmd_t> & cmds, size_t capacity, unsigned interval_us);
+
+        /** @brief Unmap the file */
+        ~CaptureWriter();
+
+        /**
+         * @brief Append a record, overwriting the oldest one if the file is full
+         *
+         * @param record        Record with the layout of a binary watch record
+         */
+        void append(const uint8_t * record);
+};
+
+/**
+ * @brief Extract the records of a time window from a capture file, as CSV
+ *
+ * The file can still be written by another process. Records which are overwritten
+ * while they are copied are skipped. The latest capacity - 1 records can be read.
+ *
+ * @param filename      Capture file name to read from
+ * @param from_s        Start of the window in seconds since the first record,
+ *                      or before the latest record if negative
+ * @param to_s          End of the window in seconds since the first record, 0 for the latest record
+ * @param os            Stream to write the CSV lines to
+ */
+control_ret_t read_capture_file(const std::string filename, double from_s, double to_s, std::ostream & os);
+
+#endif
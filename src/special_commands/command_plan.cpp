@@ -0,0 +1,535 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "command_plan.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+/** @brief Header of a binary command plan */
+struct plan_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t num_ops;
+};
+
+/** @brief Number of operations from the oldest incomplete one which can be sent out of order */
+#define PLAN_ISSUE_WINDOW 64
+
+/** @brief Flag of a plan operation which reads the command */
+#define PLAN_OP_FLAG_READ 0x01
+
+/** @brief Flag of a plan operation on a read only command, such as the values kept in a snapshot for reference */
+#define PLAN_OP_FLAG_READ_ONLY 0x02
+
+/** @brief Erase the operations marked for removal, keeping the order of the others */
+static void erase_marked_ops(vector<plan_op_t> & ops, const vector<bool> & is_marked)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        if(!is_marked[i])
+        {
+            if(kept != i)
+            {
+                ops[kept] = move(ops[i]);
+            }
+            kept++;
+        }
+    }
+    ops.resize(kept);
+}
+
+/** @brief Print the command which failed to compile */
+static void print_source_error(const string source, const vector<string> & words)
+{
+    cerr << "Error in " << source << ":" << endl;
+    for(size_t i = 0; i < words.size(); i++)
+    {
+        cerr << ((i == 0) ? "" : " ") << words[i];
+    }
+    cerr << endl;
+}
+
+/** @brief Check the number of arguments without exiting, see check_num_args() */
+static bool is_num_args_valid(const cmd_t * cmd, const size_t args_left)
+{
+    switch(cmd->rw)
+    {
+    case CMD_RO:
+        return args_left == 0;
+    case CMD_WO:
+        return args_left == cmd->num_values;
+    case CMD_RW:
+        return (args_left == 0) || (args_left == cmd->num_values);
+    default:
+        return false;
+    }
+}
+
+/** @brief Range check the encoded values of a write operation */
+static void check_op_range(const plan_op_t & op, check_range_fptr check_range)
+{
+    if((check_range == nullptr) || op.is_read)
+    {
+        return;
+    }
+    vector<cmd_param_t> values(op.cmd.num_values);
+    for(unsigned i = 0; i < op.cmd.num_values; i++)
+    {
+        values[i] = command_param_from_bytes(op.cmd.type, op.payload.data(), i);
+    }
+    check_range(op.cmd.cmd_name, values.data());
+}
+
+void CommandPlan::add_op(plan_op_t op)
+{
+    if(op.is_read && (op.cmd.num_values > max_read_values))
+    {
+        max_read_values = op.cmd.num_values;
+    }
+    ops.push_back(move(op));
+}
+
+void CommandPlan::compile_words(const vector<string> & words, check_range_fptr check_range, const string source, size_t line_num)
+{
+    plan_op_t op;
+    op.line = line_num;
+    if(!check_if_cmd_exists(words[0]))
+    {
+        print_source_error(source, words);
+    }
+    init_cmd(&op.cmd, words[0]);
+
+    const size_t args_left = words.size() - 1;
+    if(!is_num_args_valid(&op.cmd, args_left))
+    {
+        print_source_error(source, words);
+        check_num_args(&op.cmd, args_left);
+    }
+
+    op.is_read = (args_left == 0);
+    if(!op.is_read)
+    {
+        op.payload.resize(command_param_type_size(op.cmd.type) * op.cmd.num_values);
+        for(size_t i = 0; i < args_left; i++)
+        {
+            cmd_param_t value;
+            string error;
+            if(!command_param_from_str(op.cmd.type, words[i + 1], value, error))
+            {
+                print_source_error(source, words);
+                cerr << error << endl;
+                exit(HOST_APP_ERROR);
+            }
+            command_param_to_bytes(op.cmd.type, op.payload.data(), i, value);
+        }
+        check_op_range(op, check_range);
+    }
+    add_op(move(op));
+}
+
+void CommandPlan::compile_text(const string filename, check_range_fptr check_range)
+{
+    ifstream file(filename, ios::in);
+    if(!file)
+    {
+        cerr << "Could not open a file " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    string line;
+    size_t line_num = 0;
+    vector<string> words;
+    while(getline(file, line))
+    {
+        line_num++;
+        words.clear();
+        stringstream ss(line);
+        string word;
+        while(ss >> word)
+        {
+            words.push_back(word);
+        }
+        // skip empty lines
+        if(words.empty())
+        {
+            continue;
+        }
+        compile_words(words, check_range, filename + " line " + to_string(line_num), line_num);
+    }
+    file.close();
+}
+
+void CommandPlan::load_binary(const string filename, check_range_fptr check_range, bool resolve_cmds)
+{
+    ifstream file(filename, ios::in | ios::binary);
+    if(!file)
+    {
+        cerr << "Could not open a file " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    vector<uint8_t> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+
+    plan_header_t header = {0, 0, 0, 0};
+    if(data.size() >= sizeof(header))
+    {
+        memcpy(&header, data.data(), sizeof(header));
+    }
+    if(header.magic != COMMAND_PLAN_MAGIC)
+    {
+        cerr << filename << " is not a command plan" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    // Version 1 plans don't flag the read only commands, so they can only be loaded if the commands are resolved
+    if((header.version != COMMAND_PLAN_VERSION) && !(resolve_cmds && (header.version == 1)))
+    {
+        cerr << "Unsupported command plan version " << header.version << " in " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+
+    size_t pos = sizeof(header);
+    for(uint32_t n = 0; n < header.num_ops; n++)
+    {
+        // name length, name, flags, res_id, cmd_id, type, num_values (2 bytes), payload length (2 bytes)
+        if(pos + 1 > data.size() || pos + 1 + data[pos] + 8 > data.size())
+        {
+            cerr << "Command plan " << filename << " is truncated" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        const string name(reinterpret_cast<const char *>(&data[pos + 1]), data[pos]);
+        pos += 1 + name.length();
+        const uint8_t flags = data[pos];
+        const control_resid_t res_id = data[pos + 1];
+        const control_cmd_t cmd_id = data[pos + 2];
+        const cmd_param_type_t type = static_cast<cmd_param_type_t>(data[pos + 3]);
+        const unsigned num_values = data[pos + 4] | (data[pos + 5] << 8);
+        const size_t payload_len = data[pos + 6] | (data[pos + 7] << 8);
+        pos += 8;
+        if(pos + payload_len > data.size())
+        {
+            cerr << "Command plan " << filename << " is truncated" << endl;
+            exit(HOST_APP_ERROR);
+        }
+
+        plan_op_t op;
+        op.line = 0;
+        op.is_read = (flags & PLAN_OP_FLAG_READ) != 0;
+        if(!resolve_cmds)
+        {
+            op.cmd.cmd_name = name;
+            op.cmd.res_id = res_id;
+            op.cmd.cmd_id = cmd_id;
+            op.cmd.type = type;
+            op.cmd.rw = (flags & PLAN_OP_FLAG_READ_ONLY) ? CMD_RO : CMD_RW;
+            op.cmd.num_values = num_values;
+            op.cmd.hidden_cmd = false;
+            if(payload_len != ((op.is_read) ? 0 : command_param_type_size(type) * num_values))
+            {
+                cerr << "Command " << name << " from " << filename << " has a wrong payload length" << endl;
+                exit(HOST_APP_ERROR);
+            }
+            op.payload.assign(data.begin() + pos, data.begin() + pos + payload_len);
+            pos += payload_len;
+            add_op(move(op));
+            continue;
+        }
+        if(!check_if_cmd_exists(name))
+        {
+            cerr << "Command " << name << " from " << filename << " is not in the command map, compile the plan again" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        init_cmd(&op.cmd, name);
+        const size_t expected_len = (op.is_read) ? 0 : command_param_type_size(op.cmd.type) * op.cmd.num_values;
+        if((op.cmd.res_id != res_id) || (op.cmd.cmd_id != cmd_id) || (op.cmd.type != type) ||
+           (op.cmd.num_values != num_values) || (payload_len != expected_len))
+        {
+            cerr << "Command " << name << " from " << filename << " does not match the command map, compile the plan again" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        op.payload.assign(data.begin() + pos, data.begin() + pos + payload_len);
+        pos += payload_len;
+        check_op_range(op, check_range);
+        add_op(move(op));
+    }
+}
+
+bool CommandPlan::save_binary(const string filename) const
+{
+    ofstream file(filename, ios::out | ios::binary | ios::trunc);
+    if(!file)
+    {
+        cerr << "Could not open a file " << filename << endl;
+        return false;
+    }
+    write_binary(file);
+    file.close();
+    if(!file.good())
+    {
+        cerr << "Error occurred when writing to " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+void CommandPlan::write_binary(ostream & os) const
+{
+    plan_header_t header = {COMMAND_PLAN_MAGIC, COMMAND_PLAN_VERSION, 0, static_cast<uint32_t>(ops.size())};
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for(const plan_op_t & op : ops)
+    {
+        const uint8_t name_len = static_cast<uint8_t>(op.cmd.cmd_name.length());
+        const uint8_t info[9] = {
+            name_len,
+            static_cast<uint8_t>(((op.is_read) ? PLAN_OP_FLAG_READ : 0) | ((op.cmd.rw == CMD_RO) ? PLAN_OP_FLAG_READ_ONLY : 0)),
+            op.cmd.res_id,
+            op.cmd.cmd_id,
+            static_cast<uint8_t>(op.cmd.type),
+            static_cast<uint8_t>(op.cmd.num_values & 0xFF),
+            static_cast<uint8_t>(op.cmd.num_values >> 8),
+            static_cast<uint8_t>(op.payload.size() & 0xFF),
+            static_cast<uint8_t>(op.payload.size() >> 8)
+        };
+        os.write(reinterpret_cast<const char *>(&info[0]), 1);
+        os.write(op.cmd.cmd_name.c_str(), name_len);
+        os.write(reinterpret_cast<const char *>(&info[1]), sizeof(info) - 1);
+        os.write(reinterpret_cast<const char *>(op.payload.data()), op.payload.size());
+    }
+}
+
+size_t CommandPlan::group_by_resource()
+{
+    auto segment_start = ops.begin();
+    while(segment_start != ops.end())
+    {
+        auto segment_end = find_if(segment_start, ops.end(), is_plan_barrier);
+        // Resources are sorted by their first write in the segment
+        vector<size_t> rank(1 << (8 * sizeof(control_resid_t)), SIZE_MAX);
+        size_t num_resources = 0;
+        for(auto it = segment_start; it != segment_end; it++)
+        {
+            if(rank[it->cmd.res_id] == SIZE_MAX)
+            {
+                rank[it->cmd.res_id] = num_resources++;
+            }
+        }
+        stable_sort(segment_start, segment_end, [&rank](const plan_op_t & a, const plan_op_t & b)
+        {
+            return rank[a.cmd.res_id] < rank[b.cmd.res_id];
+        });
+        segment_start = (segment_end == ops.end()) ? segment_end : segment_end + 1;
+    }
+
+    size_t num_runs = 0;
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        if((i == 0) || (ops[i].cmd.res_id != ops[i - 1].cmd.res_id))
+        {
+            num_runs++;
+        }
+    }
+    return num_runs;
+}
+
+size_t CommandPlan::coalesce_writes()
+{
+    vector<bool> is_overwritten(ops.size(), false);
+    unordered_set<uint16_t> written;
+    size_t num_removed = 0;
+    // Walk backwards, so the first write found for each command in a segment is the last one sent
+    for(size_t i = ops.size(); i-- > 0;)
+    {
+        if(is_plan_barrier(ops[i]))
+        {
+            written.clear();
+        }
+        else if(!written.insert(command_key(&ops[i].cmd)).second)
+        {
+            is_overwritten[i] = true;
+            num_removed++;
+        }
+    }
+
+    erase_marked_ops(ops, is_overwritten);
+    return num_removed;
+}
+
+size_t CommandPlan::skip_unchanged_writes(Command * command, size_t & num_reads)
+{
+    const auto checked_end = find_if(ops.begin(), ops.end(), [](const plan_op_t & op)
+    {
+        return is_plan_barrier(op) && !op.is_read;
+    });
+    num_reads = 0;
+
+    // Read the current value of every readable command written before the first order sensitive command
+    unordered_map<uint16_t, vector<uint8_t>> values;
+    for(auto it = ops.begin(); it != checked_end; it++)
+    {
+        if(it->is_read || (it->cmd.rw != CMD_RW) || (values.count(command_key(&it->cmd)) != 0))
+        {
+            continue;
+        }
+        vector<uint8_t> data(it->payload.size() + 1); // one extra for the status
+        command->command_get_bytes(&it->cmd, data.data(), data.size());
+        num_reads++;
+        values[command_key(&it->cmd)].assign(data.begin() + 1, data.end());
+    }
+
+    vector<bool> is_unchanged(ops.size(), false);
+    size_t num_removed = 0;
+    for(auto it = ops.begin(); it != checked_end; it++)
+    {
+        auto value = values.find(command_key(&it->cmd));
+        if(it->is_read || (value == values.end()))
+        {
+            continue;
+        }
+        if(value->second == it->payload)
+        {
+            is_unchanged[it - ops.begin()] = true;
+            num_removed++;
+        }
+        else
+        {
+            value->second = it->payload;
+        }
+    }
+
+    erase_marked_ops(ops, is_unchanged);
+    return num_removed;
+}
+
+/** @brief Decode and print the values of a read operation */
+static void print_read_op(Command * command, const plan_op_t & op, const uint8_t * data, cmd_param_t * read_values)
+{
+    for(unsigned i = 0; i < op.cmd.num_values; i++)
+    {
+        read_values[i] = command_param_from_bytes(op.cmd.type, &data[1], i);
+    }
+    command->print_values(&op.cmd, read_values);
+}
+
+control_ret_t CommandPlan::execute(Command * command, bool out_of_order) const
+{
+    if(out_of_order)
+    {
+        return execute_out_of_order(command);
+    }
+
+    // Buffers are allocated once for the whole plan
+    vector<uint8_t> read_data(max_read_values * sizeof(cmd_param_t) + 1);
+    vector<cmd_param_t> read_values(max_read_values);
+    control_ret_t ret = CONTROL_SUCCESS;
+
+    for(const plan_op_t & op : ops)
+    {
+        if(op.is_read)
+        {
+            size_t data_len = command_param_type_size(op.cmd.type) * op.cmd.num_values + 1; // one extra for the status
+            ret = command->command_get_bytes(&op.cmd, read_data.data(), data_len);
+            print_read_op(command, op, read_data.data(), read_values.data());
+        }
+        else
+        {
+            ret = command->command_set_bytes(&op.cmd, op.payload.data(), op.payload.size());
+        }
+    }
+    return ret;
+}
+
+control_ret_t CommandPlan::execute_out_of_order(Command * command) const
+{
+    vector<unsigned> attempts(ops.size(), 0);
+    vector<bool> is_done(ops.size(), false);
+    vector<vector<uint8_t>> read_data(ops.size());
+    vector<cmd_param_t> read_values(max_read_values);
+    vector<bool> is_served(1 << (8 * sizeof(control_resid_t)), false);
+    vector<control_resid_t> served_resources;
+    control_ret_t ret = CONTROL_SUCCESS;
+
+    size_t first = 0; // oldest operation which is not complete
+    while(first < ops.size())
+    {
+        // Each pass sends the oldest incomplete operation of every resource in the window once, so
+        // a busy resource is tried again after one operation of each of the other resources
+        const size_t end = min(ops.size(), first + PLAN_ISSUE_WINDOW);
+        for(size_t i = first; i < end; i++)
+        {
+            const plan_op_t & op = ops[i];
+            const bool is_order_sensitive = is_order_sensitive_cmd(&op.cmd);
+            if(is_order_sensitive && (i != first))
+            {
+                break; // waits for all the operations before it, and nothing after it can overtake it
+            }
+            if(is_done[i] || is_served[op.cmd.res_id])
+            {
+                continue;
+            }
+
+            control_ret_t op_ret;
+            if(op.is_read)
+            {
+                read_data[i].resize(command_param_type_size(op.cmd.type) * op.cmd.num_values + 1); // one extra for the status
+                op_ret = command->command_get_bytes_once(&op.cmd, read_data[i].data(), read_data[i].size(), ++attempts[i]);
+            }
+            else
+            {
+                op_ret = command->command_set_bytes_once(&op.cmd, op.payload.data(), op.payload.size(), ++attempts[i]);
+            }
+
+            is_served[op.cmd.res_id] = true;
+            served_resources.push_back(op.cmd.res_id);
+            if(op_ret == SERVICER_COMMAND_RETRY)
+            {
+                // The later operations on this resource have to wait for this one
+                if(is_order_sensitive)
+                {
+                    break;
+                }
+                continue;
+            }
+            is_done[i] = true;
+            ret = op_ret;
+        }
+
+        for(control_resid_t res_id : served_resources)
+        {
+            is_served[res_id] = false;
+        }
+        served_resources.clear();
+
+        // Operations complete in program order, so the values read are printed in the same order as execute()
+        for(; (first < ops.size()) && is_done[first]; first++)
+        {
+            if(ops[first].is_read)
+            {
+                print_read_op(command, ops[first], read_data[first].data(), read_values.data());
+                vector<uint8_t>().swap(read_data[first]);
+            }
+        }
+    }
+    return ret;
+}
+
+bool is_command_plan_file(const string filename)
+{
+    ifstream file(filename, ios::in | ios::binary);
+    uint32_t magic = 0;
+    if(!file.read(reinterpret_cast<char *>(&magic), sizeof(magic)))
+    {
+        return false;
+    }
+    return magic == COMMAND_PLAN_MAGIC;
+}
+
+bool is_plan_barrier(const plan_op_t & op)
+{
+    return op.is_read || is_order_sensitive_cmd(&op.cmd);
+}
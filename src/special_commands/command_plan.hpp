@@ -0,0 +1,193 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef COMMAND_PLAN_H_
+#define COMMAND_PLAN_H_
+
+#include "command.hpp"
+#include <vector>
+
+/** @brief Magic number at the start of a binary command plan, "XVFP" */
+#define COMMAND_PLAN_MAGIC 0x50465658
+
+/** @brief Version of the binary command plan format */
+#define COMMAND_PLAN_VERSION 2
+
+/** @brief Single operation of a command plan */
+struct plan_op_t
+{
+    /** Resolved command information */
+    cmd_t cmd;
+    /** true if the operation reads the command, false if it writes it */
+    bool is_read;
+    /** Encoded values to write, empty for reads */
+    std::vector<uint8_t> payload;
+    /** Line of the text file the operation comes from, 0 if loaded from a binary plan */
+    size_t line;
+};
+
+/**
+ * @brief Class for a command list compiled into a list of operations
+ *
+ * All the commands are resolved and all the values are parsed and range checked
+ * when the plan is built, so a bad line is reported before any command is sent to the device.
+ */
+class CommandPlan
+{
+    private:
+
+        /** @brief Operations in the order they have to be executed */
+        std::vector<plan_op_t> ops;
+
+        /** @brief Largest number of values read by a single operation */
+        size_t max_read_values = 0;
+
+        /**
+         * @brief Execute all the operations, sending the ones of other resources while a resource is busy
+         *
+         * @param command       Pointer to the Command class object
+         * @see execute()
+         */
+        control_ret_t execute_out_of_order(Command * command) const;
+
+    public:
+
+        /**
+         * @brief Add an operation to the plan
+         *
+         * @param op            Operation to add
+         * @note The operation is not checked, it has to come from a resolved command
+         */
+        void add_op(plan_op_t op);
+
+        /**
+         * @brief Compile a single command and add it to the plan
+         *
+         * @param words         Command name followed by the values to write, or by nothing to read it
+         * @param check_range   Range check, such as check_values_in_range(), nullptr to bypass it
+         * @param source        Where the command comes from, such as the file name and line, printed with the errors
+         * @param line_num      Line number to keep in the operation
+         * @note Exits with an error message giving the source, if the command or a value is not valid
+         */
+        void compile_words(const std::vector<std::string> & words, check_range_fptr check_range, const std::string source, size_t line_num);
+
+        /**
+         * @brief Compile a text file with one command per line
+         *
+         * @param filename      File name to read from
+         * @param check_range   Range check, such as check_values_in_range(), nullptr to bypass it
+         * @note Exits with an error message giving the line, if a command or a value is not valid
+         */
+        void compile_text(const std::string filename, check_range_fptr check_range);
+
+        /**
+         * @brief Load a binary plan saved with save_binary()
+         *
+         * @param filename      File name to read from
+         * @param check_range   Range check, such as check_values_in_range(), nullptr to bypass it
+         * @param resolve_cmds  Resolve the commands again with the current command_map
+         * @note If resolve_cmds is true, exits if the commands don't match the plan.
+         * If it is false, the IDs saved in the plan are used as they are, which is faster but
+         * relies on the plan having been compiled for the same command_map, only the read only flag
+         * saved with each operation is kept from the access rights. Plans of version 1 don't have this
+         * flag, so they are only loaded if resolve_cmds is true.
+         */
+        void load_binary(const std::string filename, check_range_fptr check_range, bool resolve_cmds = true);
+
+        /**
+         * @brief Save the plan in binary format
+         *
+         * @param filename      File name to write to
+         * @return              true if the plan has been saved
+         */
+        bool save_binary(const std::string filename) const;
+
+        /**
+         * @brief Write the plan in binary format to a stream
+         *
+         * @param os            Stream to write to, opened in binary mode
+         */
+        void write_binary(std::ostream & os) const;
+
+        /**
+         * @brief Execute all the operations back to back
+         *
+         * When a resource answers SERVICER_COMMAND_RETRY, the operations are normally sent to it again
+         * until it is ready. Out of order, the resources take turns: the next operations of the other
+         * resources are sent while it is busy, and it is tried again after one operation of each of them. The operations on each resource are still
+         * sent in plan order, and order sensitive commands (SPECIAL_CMD_ and TEST_) are only sent once
+         * all the operations before them are complete, and before any operation after them.
+         *
+         * @param command       Pointer to the Command class object
+         * @param out_of_order  Send the operations of other resources while a resource is busy
+         * @note Values read from the device are printed in the same format as a single command, in plan order
+         */
+        control_ret_t execute(Command * command, bool out_of_order = false) const;
+
+        /**
+         * @brief Reorder the writes, so the ones to the same resource are sent one after the other
+         *
+         * The relative order of the writes to each resource is kept. Reads and order sensitive
+         * commands (SPECIAL_CMD_ and TEST_) are never moved and nothing is moved across them.
+         *
+         * @return              Number of runs of consecutive operations on the same resource
+         */
+        size_t group_by_resource();
+
+        /**
+         * @brief Remove the writes which are overwritten before they can have any effect
+         *
+         * Only the last write to each command is kept between two reads or order sensitive
+         * commands (SPECIAL_CMD_ and TEST_), at the position of that last write.
+         *
+         * @return              Number of writes removed
+         */
+        size_t coalesce_writes();
+
+        /**
+         * @brief Remove the writes which would not change the value held by the device
+         *
+         * Each readable command written by the plan is read once before anything is sent, the writes
+         * are then compared with the value the command holds at that point of the plan.
+         * Only the writes before the first order sensitive command are checked, as that command
+         * may change any value.
+         *
+         * @param command       Pointer to the Command class object
+         * @param num_reads     Number of reads sent to the device to get the current values
+         * @return              Number of writes removed
+         * @note The commands must have been resolved with the command_map, so write only commands are not read
+         */
+        size_t skip_unchanged_writes(Command * command, size_t & num_reads);
+
+        /** @brief Get the operations of the plan */
+        const std::vector<plan_op_t> & get_ops() const {return ops;};
+};
+
+/** @brief Optimisations applied to a command plan before it is executed */
+struct plan_optimise_t
+{
+    /** Remove the writes which are overwritten, see CommandPlan::coalesce_writes() */
+    bool coalesce_writes;
+    /** Remove the writes which would not change anything, see CommandPlan::skip_unchanged_writes() */
+    bool skip_unchanged;
+    /** Send the commands of other resources while a resource is busy, see CommandPlan::execute() */
+    bool out_of_order;
+};
+
+/**
+ * @brief Check if an operation has to stay in place when the plan is reordered
+ *
+ * @param op            Operation to check
+ * @return              true for reads and for commands starting with SPECIAL_CMD_ or TEST_
+ */
+bool is_plan_barrier(const plan_op_t & op);
+
+/**
+ * @brief Check if a file is a binary command plan
+ *
+ * @param filename      File name to check
+ * @return              true if the file starts with the command plan magic number
+ */
+bool is_command_plan_file(const std::string filename);
+
+#endif
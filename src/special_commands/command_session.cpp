@@ -0,0 +1,499 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "command_session.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+
+#if (defined(__linux__) || defined(__APPLE__))
+#include <termios.h>        // tcgetattr, tcsetattr
+#include <unistd.h>         // isatty, read
+#endif
+
+using namespace std;
+using session_clock_t = chrono::steady_clock;
+
+extern size_t num_commands;
+
+/** @brief Prompt printed before each line of an interactive session on a terminal */
+static const string session_prompt = "xvf> ";
+
+/** @brief Words of a line which are not commands */
+static const vector<string> session_keywords = {"help", "quit", "exit"};
+
+/** @brief Command run by a line of a session */
+struct session_op_t
+{
+    /** Command information */
+    cmd_t cmd;
+    /** Whether the command is read */
+    bool is_read;
+    /** Status byte followed by the values read, or values written */
+    vector<uint8_t> data;
+    /** Time taken by the command, in microseconds */
+    uint64_t time_us;
+};
+
+/** @brief Split a line into words, dropping the comments */
+static vector<string> split_line(const string & line)
+{
+    vector<string> words;
+    stringstream ss(line);
+    string word;
+    while((ss >> word) && (word[0] != '#'))
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+static bool is_quit(const vector<string> & words)
+{
+    return (words.size() == 1) && ((words[0] == "quit") || (words[0] == "exit"));
+}
+
+/**
+ * @brief Run the command of a line
+ *
+ * @param command       Pointer to the Command class object
+ * @param words         Command name followed by the values to write, if any
+ * @param op            Set to the command and the values read or written
+ * @note Throws host_app_error if the command fails
+ */
+static void run_op(Command * command, const vector<string> & words, session_op_t & op)
+{
+    init_cmd(&op.cmd, words[0]);
+    const size_t args_left = words.size() - 1;
+    check_num_args(&op.cmd, args_left);
+    op.is_read = (args_left == 0);
+
+    const session_clock_t::time_point start = session_clock_t::now();
+    if(op.is_read)
+    {
+        op.data.resize(command_param_type_size(op.cmd.type) * op.cmd.num_values + 1); // one extra for the status
+        command->command_get_bytes(&op.cmd, op.data.data(), op.data.size());
+    }
+    else
+    {
+        vector<cmd_param_t> values(op.cmd.num_values);
+        op.data.resize(command_param_type_size(op.cmd.type) * op.cmd.num_values);
+        for(size_t i = 0; i < args_left; i++)
+        {
+            string error;
+            if(!command_param_from_str(op.cmd.type, words[i + 1], values[i], error))
+            {
+                throw host_app_error(error);
+            }
+            command_param_to_bytes(op.cmd.type, op.data.data(), i, values[i]);
+        }
+        command->check_values_range(&op.cmd, values.data());
+        command->command_set_bytes(&op.cmd, op.data.data(), op.data.size());
+    }
+    op.time_us = chrono::duration_cast<chrono::microseconds>(session_clock_t::now() - start).count();
+}
+
+/** @brief Print the commands of the command map, or the information of a single command */
+static void print_session_help(const vector<string> & words)
+{
+    if(words.size() > 1)
+    {
+        cmd_t cmd;
+        init_cmd(&cmd, words[1]);
+        cout << cmd.cmd_name << ": " << command_rw_type_name(cmd.rw) << ", " << cmd.num_values << " x "
+        << command_param_type_name(cmd.type) << endl << cmd.info << endl;
+        return;
+    }
+    cout << "Type a command name to read it, or a command name followed by its values to write it." << endl
+    << "Use help <command> for the information of a command, quit or Ctrl+D to exit. Commands:" << endl;
+    const size_t width = get_term_width();
+    size_t line_len = 0;
+    for(size_t i = 0; i < num_commands; i++)
+    {
+        cmd_t cmd;
+        init_cmd(&cmd, "_", i);
+        // skipping hidden commands
+        if(cmd.hidden_cmd)
+        {
+            continue;
+        }
+        if((line_len != 0) && (line_len + cmd.cmd_name.length() + 1 > width))
+        {
+            cout << endl;
+            line_len = 0;
+        }
+        cout << ((line_len == 0) ? "" : " ") << cmd.cmd_name;
+        line_len += cmd.cmd_name.length() + ((line_len == 0) ? 0 : 1);
+    }
+    cout << endl;
+}
+
+/** @brief Get the command names and keywords starting with a prefix, in any case */
+static vector<string> complete_word(const string & prefix)
+{
+    string upper_prefix = prefix;
+    transform(upper_prefix.begin(), upper_prefix.end(), upper_prefix.begin(), ::toupper);
+    vector<string> matches;
+    for(size_t i = 0; i < num_commands; i++)
+    {
+        cmd_t cmd;
+        init_cmd(&cmd, "_", i);
+        if(!cmd.hidden_cmd && (cmd.cmd_name.compare(0, upper_prefix.length(), upper_prefix) == 0))
+        {
+            matches.push_back(cmd.cmd_name);
+        }
+    }
+    for(const string & keyword : session_keywords)
+    {
+        if(keyword.compare(0, prefix.length(), prefix) == 0)
+        {
+            matches.push_back(keyword);
+        }
+    }
+    sort(matches.begin(), matches.end());
+    return matches;
+}
+
+/** @brief Longest prefix shared by a sorted list of words */
+static string common_prefix(const vector<string> & words)
+{
+    const string & first = words.front();
+    const string & last = words.back();
+    size_t len = 0;
+    while((len < first.length()) && (len < last.length()) && (first[len] == last[len]))
+    {
+        len++;
+    }
+    return first.substr(0, len);
+}
+
+#if (defined(__linux__) || defined(__APPLE__))
+
+/** @brief Put the terminal in raw mode for the lifetime of the object, so the keys are read one by one */
+class RawTerminal
+{
+    private:
+
+        /** @brief Terminal settings to restore */
+        struct termios saved;
+
+    public:
+
+        RawTerminal()
+        {
+            tcgetattr(STDIN_FILENO, &saved);
+            struct termios raw = saved;
+            // Ctrl+C is read as a key, so it clears the line instead of ending the session
+            raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+
+        ~RawTerminal()
+        {
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        }
+
+        RawTerminal(const RawTerminal &) = delete;
+        RawTerminal & operator=(const RawTerminal &) = delete;
+};
+
+/** @brief Print the prompt and the line being edited over the current terminal line */
+static void redraw_line(const string & line)
+{
+    cout << "\r\x1b[K" << session_prompt << line << flush;
+}
+
+/**
+ * @brief Read a line from the terminal, with completion of the command names and history
+ *
+ * @param line          Line read
+ * @param history       Previous lines, oldest first
+ * @return              false on Ctrl+D on an empty line or at the end of the input
+ */
+static bool edit_line(string & line, const deque<string> & history)
+{
+    RawTerminal raw_terminal;
+    line.clear();
+    size_t history_index = history.size();
+    string edited_line;
+    redraw_line(line);
+    char c;
+    while(read(STDIN_FILENO, &c, 1) == 1)
+    {
+        if((c == '\r') || (c == '\n'))
+        {
+            cout << endl;
+            return true;
+        }
+        else if(c == 0x04) // Ctrl+D
+        {
+            if(line.empty())
+            {
+                cout << endl;
+                return false;
+            }
+        }
+        else if(c == 0x03) // Ctrl+C
+        {
+            cout << "^C" << endl;
+            line.clear();
+            history_index = history.size();
+        }
+        else if((c == 0x7f) || (c == '\b'))
+        {
+            if(!line.empty())
+            {
+                line.pop_back();
+            }
+        }
+        else if(c == '\t')
+        {
+            // Only the first word of a line, or the word after help, is a command name
+            const size_t word_start = line.find_last_of(' ') + 1;
+            const vector<string> words = split_line(line.substr(0, word_start));
+            if(!words.empty() && !((words.size() == 1) && (words[0] == "help")))
+            {
+                continue;
+            }
+            const vector<string> matches = complete_word(line.substr(word_start));
+            if(matches.size() == 1)
+            {
+                line = line.substr(0, word_start) + matches[0] + " ";
+            }
+            else if(!matches.empty())
+            {
+                const string prefix = common_prefix(matches);
+                if(prefix.length() > line.length() - word_start)
+                {
+                    line = line.substr(0, word_start) + prefix;
+                }
+                else
+                {
+                    cout << endl;
+                    for(const string & match : matches)
+                    {
+                        cout << match << "  ";
+                    }
+                    cout << endl;
+                }
+            }
+        }
+        else if(c == 0x1b)
+        {
+            // Only the Up and Down arrows are used, the other escape sequences are dropped
+            char seq[2];
+            if((read(STDIN_FILENO, &seq[0], 1) != 1) || (seq[0] != '[') || (read(STDIN_FILENO, &seq[1], 1) != 1))
+            {
+                continue;
+            }
+            if(history_index == history.size())
+            {
+                edited_line = line;
+            }
+            if((seq[1] == 'A') && (history_index > 0))
+            {
+                line = history[--history_index];
+            }
+            else if((seq[1] == 'B') && (history_index < history.size()))
+            {
+                history_index++;
+                line = (history_index == history.size()) ? edited_line : history[history_index];
+            }
+        }
+        else if(isprint(static_cast<unsigned char>(c)))
+        {
+            line += c;
+        }
+        redraw_line(line);
+    }
+    return false;
+}
+
+/** @brief Check if the lines are typed by the user */
+static bool is_input_terminal()
+{
+    return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+}
+
+#elif defined(_WIN32)
+
+static bool edit_line(string & line, const deque<string> & history)
+{
+    cout << session_prompt << flush;
+    return static_cast<bool>(getline(cin, line));
+}
+
+static bool is_input_terminal()
+{
+    return false;
+}
+
+#else
+#error "Unknown Operating System"
+#endif
+
+control_ret_t interactive_session(Command * command)
+{
+    const bool is_terminal = is_input_terminal();
+    deque<string> history;
+    string line;
+    session_op_t op;
+    while((is_terminal) ? edit_line(line, history) : static_cast<bool>(getline(cin, line)))
+    {
+        const vector<string> words = split_line(line);
+        if(words.empty())
+        {
+            continue;
+        }
+        if(is_terminal && (history.empty() || (history.back() != line)))
+        {
+            history.push_back(line);
+            if(history.size() > SESSION_HISTORY_LEN)
+            {
+                history.pop_front();
+            }
+        }
+        if(is_quit(words))
+        {
+            break;
+        }
+        try
+        {
+            if(words[0] == "help")
+            {
+                print_session_help(words);
+                continue;
+            }
+            run_op(command, words, op);
+        }
+        catch(const host_app_error & e)
+        {
+            cerr << e.what() << endl;
+            continue;
+        }
+        if(op.is_read)
+        {
+            vector<cmd_param_t> values(op.cmd.num_values);
+            for(unsigned i = 0; i < op.cmd.num_values; i++)
+            {
+                values[i] = command_param_from_bytes(op.cmd.type, &op.data[1], i);
+            }
+            command->print_values(&op.cmd, values.data());
+        }
+        cout << fixed << setprecision(3) << op.time_us / 1000.0 << " ms" << endl;
+    }
+    return CONTROL_SUCCESS;
+}
+
+/** @brief Append a string to a JSON response, with the characters JSON does not allow escaped */
+static void append_json_string(string & response, const string & str)
+{
+    response += '"';
+    for(const char c : str)
+    {
+        if((c == '"') || (c == '\\'))
+        {
+            response += '\\';
+            response += c;
+        }
+        else if(c == '\n')
+        {
+            response += "\\n";
+        }
+        else if(isprint(static_cast<unsigned char>(c)))
+        {
+            response += c;
+        }
+    }
+    response += '"';
+}
+
+/** @brief Append the values read by a command to a JSON response, as dump_params() formats them */
+static void append_json_values(string & response, const session_op_t & op)
+{
+    const uint8_t * data = &op.data[1];
+    if(op.cmd.type == TYPE_CHAR)
+    {
+        // Strings end at the first null character
+        string str;
+        for(unsigned i = 0; (i < op.cmd.num_values) && (data[i] != '\0'); i++)
+        {
+            str += static_cast<char>(data[i]);
+        }
+        append_json_string(response, str);
+        return;
+    }
+    response += '[';
+    char buf[32];
+    for(unsigned i = 0; i < op.cmd.num_values; i++)
+    {
+        const cmd_param_t value = command_param_from_bytes(op.cmd.type, data, i);
+        const char * separator = (i == 0) ? "" : ", ";
+        switch(op.cmd.type)
+        {
+        case TYPE_UINT8:
+            snprintf(buf, sizeof(buf), "%s%u", separator, value.ui8);
+            break;
+        case TYPE_INT32:
+            snprintf(buf, sizeof(buf), "%s%d", separator, value.i32);
+            break;
+        case TYPE_UINT32:
+            snprintf(buf, sizeof(buf), "%s%u", separator, value.ui32);
+            break;
+        default:
+            // JSON has no representation for infinities and NaN
+            snprintf(buf, sizeof(buf), (isfinite(value.f)) ? "%s%.9g" : "%snull", separator, value.f);
+            break;
+        }
+        response += buf;
+    }
+    response += ']';
+}
+
+control_ret_t stdin_session(Command * command, istream & in, ostream & out)
+{
+    control_ret_t ret = CONTROL_SUCCESS;
+    string line;
+    string response;
+    session_op_t op;
+    for(size_t line_num = 1; getline(in, line); line_num++)
+    {
+        const vector<string> words = split_line(line);
+        if(words.empty())
+        {
+            continue;
+        }
+        if(is_quit(words))
+        {
+            break;
+        }
+
+        response = "{\"line\": " + to_string(line_num) + ", \"command\": ";
+        try
+        {
+            run_op(command, words, op);
+            append_json_string(response, op.cmd.cmd_name);
+            response += ", \"status\": 0, \"time_us\": " + to_string(op.time_us);
+            if(op.is_read)
+            {
+                response += ", \"values\": ";
+                append_json_values(response, op);
+            }
+        }
+        catch(const host_app_error & e)
+        {
+            append_json_string(response, words[0]);
+            response += ", \"status\": " + to_string(e.code) + ", \"error\": ";
+            append_json_string(response, e.what());
+            ret = CONTROL_ERROR;
+        }
+        out << response << "}" << endl;
+    }
+    return ret;
+}
@@ -0,0 +1,52 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef COMMAND_SESSION_H_
+#define COMMAND_SESSION_H_
+
+#include "command.hpp"
+#include <iostream>
+
+/** @brief Largest number of lines kept in the history of an interactive session */
+#define SESSION_HISTORY_LEN 1000
+
+/**
+ * @brief Run the commands typed by the user on an open device
+ *
+ * Each line is a command name followed by the values to write, or by nothing to read it,
+ * as on the command line. The values read are printed as by a single command, followed by
+ * the time taken by the command. "help" lists the commands, "help <command>" prints the
+ * information of a command and "quit", "exit" or Ctrl+D end the session.
+ *
+ * When the input is a terminal, the line is edited in place: Tab completes the command names
+ * from the command map, the Up and Down keys recall the previous lines and Ctrl+C clears the line.
+ * Otherwise the lines are read as they are, so a list of commands can be redirected to the session.
+ *
+ * An error only stops the command which raised it, except for the values out of range, which
+ * end the application as the range check of the command map exits.
+ *
+ * @param command       Pointer to the Command class object
+ * @return              CONTROL_SUCCESS once the session ends
+ */
+control_ret_t interactive_session(Command * command);
+
+/**
+ * @brief Run the commands read from a stream on an open device and print a machine readable response to each of them
+ *
+ * The lines are read as in interactive_session(), empty lines and lines starting with # are skipped,
+ * and each command gets a single line JSON object in response, in the order of the commands:
+ *
+ *     {"line": 3, "command": "CMD_NAME", "status": 0, "time_us": 120, "values": [1, 2]}
+ *
+ * "values" is only present for a read, and a command which failed has the error code in "status"
+ * and the error message in "error". Each response is flushed as soon as the command completes,
+ * so a process driving the session through a pipe can wait for the response to each command.
+ *
+ * @param command       Pointer to the Command class object
+ * @param in            Stream to read the commands from
+ * @param out           Stream to write the responses to
+ * @return              CONTROL_SUCCESS if all the commands succeeded, otherwise CONTROL_ERROR
+ */
+control_ret_t stdin_session(Command * command, std::istream & in = std::cin, std::ostream & out = std::cout);
+
+#endif
@@ -0,0 +1,287 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "dump_engine.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <regex>
+#include <thread>
+
+using namespace std;
+
+extern size_t num_commands;
+
+/** @brief Largest number of characters a single formatted value can take, with its separator */
+#define DUMP_MAX_VALUE_CHARS 28
+
+/** @brief Largest number of characters around the values of a command, without the name */
+#define DUMP_MAX_CMD_CHARS 32
+
+/** @brief Name of the parameter types in the CSV output */
+static const char * get_type_name(cmd_param_type_t type)
+{
+    switch(type)
+    {
+    case TYPE_CHAR:
+        return "char";
+    case TYPE_UINT8:
+        return "uint8";
+    case TYPE_INT32:
+        return "int32";
+    case TYPE_FLOAT:
+        return "float";
+    case TYPE_UINT32:
+        return "uint32";
+    case TYPE_RADIANS:
+        return "radians";
+    default:
+        return "unknown";
+    }
+}
+
+DumpEngine::DumpEngine(Command * _command, const dump_config_t & config) :
+    command(_command), format(config.format)
+{
+    regex name_regex;
+    try
+    {
+        name_regex = regex(config.regex);
+    }
+    catch(const regex_error &)
+    {
+        cerr << "Invalid regular expression " << config.regex << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const string prefix = to_upper(config.prefix);
+
+    for(size_t i = 0; i < num_commands; i++)
+    {
+        cmd_t cmd;
+        init_cmd(&cmd, "_", i);
+        // skipping hidden, write only and order sensitive commands
+        if(cmd.hidden_cmd || (cmd.rw == CMD_WO) || is_order_sensitive_cmd(&cmd))
+        {
+            continue;
+        }
+        if(((config.res_id >= 0) && (cmd.res_id != config.res_id)) ||
+           (cmd.cmd_name.compare(0, prefix.length(), prefix) != 0) ||
+           (!config.regex.empty() && !regex_match(cmd.cmd_name, name_regex)))
+        {
+            continue;
+        }
+        cmds.push_back(cmd);
+    }
+
+    // Reads to the same resource are sent one after the other
+    stable_sort(cmds.begin(), cmds.end(), [](const cmd_t & a, const cmd_t & b)
+    {
+        return a.res_id < b.res_id;
+    });
+
+    size_t read_len = 0;
+    size_t out_size = DUMP_MAX_CMD_CHARS;
+    read_offsets.reserve(cmds.size());
+    for(const cmd_t & cmd : cmds)
+    {
+        read_offsets.push_back(read_len);
+        read_len += command_param_type_size(cmd.type) * cmd.num_values + 1; // one extra for the status
+        out_size += cmd.cmd_name.length() + DUMP_MAX_CMD_CHARS + cmd.num_values * DUMP_MAX_VALUE_CHARS;
+    }
+    read_data.resize(read_len);
+    if((format == DUMP_FORMAT_JSON) || (format == DUMP_FORMAT_CSV))
+    {
+        out.resize(out_size);
+    }
+}
+
+void DumpEngine::append(const char * fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(&out[out_len], out.size() - out_len, fmt, args);
+    va_end(args);
+    if((len < 0) || (static_cast<size_t>(len) >= out.size() - out_len))
+    {
+        cerr << "Dump output buffer is too small" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    out_len += len;
+}
+
+void DumpEngine::format_cmd(size_t index)
+{
+    const cmd_t & cmd = cmds[index];
+    const uint8_t * data = &read_data[read_offsets[index] + 1];
+    const bool is_json = (format == DUMP_FORMAT_JSON);
+
+    if(is_json)
+    {
+        append("%s\n  \"%s\": ", (index == 0) ? "" : ",", cmd.cmd_name.c_str());
+    }
+    else
+    {
+        append("%s,%u,%u,%s", cmd.cmd_name.c_str(), cmd.res_id, cmd.cmd_id, get_type_name(cmd.type));
+    }
+
+    if(cmd.type == TYPE_CHAR)
+    {
+        // Strings end at the first null character, non printable characters are dropped
+        append((is_json) ? "\"" : ",\"");
+        for(unsigned i = 0; (i < cmd.num_values) && (data[i] != '\0'); i++)
+        {
+            const char c = static_cast<char>(data[i]);
+            if(isprint(static_cast<unsigned char>(c)))
+            {
+                append((c == '"') ? ((is_json) ? "\\\"" : "\"\"") : ((c == '\\') && is_json) ? "\\\\" : "%c", c);
+            }
+        }
+        append((is_json) ? "\"" : "\"\n");
+        return;
+    }
+
+    if(is_json)
+    {
+        append("[");
+    }
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        const cmd_param_t value = command_param_from_bytes(cmd.type, data, i);
+        const char * separator = (is_json) ? ((i == 0) ? "" : ", ") : ",";
+        switch(cmd.type)
+        {
+        case TYPE_UINT8:
+            append("%s%u", separator, value.ui8);
+            break;
+        case TYPE_INT32:
+            append("%s%d", separator, value.i32);
+            break;
+        case TYPE_UINT32:
+            append("%s%u", separator, value.ui32);
+            break;
+        case TYPE_FLOAT:
+        case TYPE_RADIANS:
+            if(is_json && !isfinite(value.f))
+            {
+                // JSON has no representation for infinities and NaN
+                append("%snull", separator);
+            }
+            else
+            {
+                append("%s%.9g", separator, value.f);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    append((is_json) ? "]" : "\n");
+}
+
+control_ret_t DumpEngine::run(ostream & os)
+{
+    mutex ready_mutex;
+    condition_variable ready_cv;
+    size_t num_ready = 0;
+    exception_ptr read_error = nullptr;
+
+    // The reader thread owns the device, this thread only formats the values it has read
+    thread reader([&]()
+    {
+        try
+        {
+            for(size_t i = 0; i < cmds.size(); i++)
+            {
+                const size_t data_len = command_param_type_size(cmds[i].type) * cmds[i].num_values + 1;
+                command->command_get_bytes(&cmds[i], &read_data[read_offsets[i]], data_len);
+                {
+                    lock_guard<mutex> lock(ready_mutex);
+                    num_ready = i + 1;
+                }
+                ready_cv.notify_one();
+            }
+        }
+        catch(...)
+        {
+            // The error is rethrown by this thread once the reader has been joined
+            {
+                lock_guard<mutex> lock(ready_mutex);
+                read_error = current_exception();
+            }
+            ready_cv.notify_one();
+        }
+    });
+
+    CommandPlan plan;
+    vector<cmd_param_t> values;
+    out_len = 0;
+    if(format == DUMP_FORMAT_JSON)
+    {
+        append("{");
+    }
+    else if(format == DUMP_FORMAT_CSV)
+    {
+        append("command,resource_id,command_id,type,values\n");
+    }
+
+    for(size_t i = 0; i < cmds.size(); i++)
+    {
+        {
+            unique_lock<mutex> lock(ready_mutex);
+            ready_cv.wait(lock, [&]() {return (num_ready > i) || (read_error != nullptr);});
+            if(num_ready <= i)
+            {
+                break;
+            }
+        }
+        const uint8_t * data = &read_data[read_offsets[i] + 1];
+        switch(format)
+        {
+        case DUMP_FORMAT_TEXT:
+            values.resize(cmds[i].num_values);
+            for(unsigned v = 0; v < cmds[i].num_values; v++)
+            {
+                values[v] = command_param_from_bytes(cmds[i].type, data, v);
+            }
+            command->print_values(&cmds[i], values.data());
+            break;
+        case DUMP_FORMAT_BINARY:
+        {
+            plan_op_t op;
+            op.cmd = cmds[i];
+            op.is_read = false;
+            op.payload.assign(data, data + command_param_type_size(cmds[i].type) * cmds[i].num_values);
+            op.line = 0;
+            plan.add_op(move(op));
+            break;
+        }
+        default:
+            format_cmd(i);
+            break;
+        }
+    }
+    reader.join();
+    if(read_error != nullptr)
+    {
+        rethrow_exception(read_error);
+    }
+
+    if(format == DUMP_FORMAT_JSON)
+    {
+        append("\n}\n");
+    }
+    if(format == DUMP_FORMAT_BINARY)
+    {
+        plan.write_binary(os);
+    }
+    else if(format != DUMP_FORMAT_TEXT)
+    {
+        os.write(out.data(), out_len);
+    }
+    os.flush();
+    return (os.good()) ? CONTROL_SUCCESS : CONTROL_ERROR;
+}
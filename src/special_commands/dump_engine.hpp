@@ -0,0 +1,94 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef DUMP_ENGINE_H_
+#define DUMP_ENGINE_H_
+
+#include "command_plan.hpp"
+
+/** @brief Enum for the output formats of a parameter dump */
+enum dump_format_t {DUMP_FORMAT_TEXT, DUMP_FORMAT_JSON, DUMP_FORMAT_CSV, DUMP_FORMAT_BINARY};
+
+/** @brief Parameter dump configuration structure */
+struct dump_config_t
+{
+    /** Output format */
+    dump_format_t format;
+    /** Resource ID of the commands to dump, -1 for all resources */
+    int res_id;
+    /** Prefix of the command names to dump, empty for all commands */
+    std::string prefix;
+    /** Regular expression the whole command name has to match, empty for all commands */
+    std::string regex;
+};
+
+/**
+ * @brief Class for reading a set of parameters and formatting them
+ *
+ * The commands are selected and sorted by resource ID when the object is built.
+ * The reads are done by a separate thread, so each value is formatted while the next one is read.
+ */
+class DumpEngine
+{
+    private:
+
+        /** @brief Pointer to the Command class object, only used by the reader thread */
+        Command * command;
+
+        /** @brief Output format */
+        dump_format_t format;
+
+        /** @brief Commands to read, in the order they are read */
+        std::vector<cmd_t> cmds;
+
+        /** @brief Position of the read buffer of each command in read_data */
+        std::vector<size_t> read_offsets;
+
+        /** @brief Read buffers of all the commands, each one starts with the status byte */
+        std::vector<uint8_t> read_data;
+
+        /** @brief Output buffer, allocated for the largest possible output */
+        std::vector<char> out;
+
+        /** @brief Number of characters used in the output buffer */
+        size_t out_len = 0;
+
+        /**
+         * @brief Append formatted text to the output buffer
+         *
+         * @param fmt           printf() style format string
+         */
+        void append(const char * fmt, ...);
+
+        /**
+         * @brief Format the values read for a command into the output buffer
+         *
+         * @param index         Index of the command in cmds
+         */
+        void format_cmd(size_t index);
+
+    public:
+
+        /**
+         * @brief Construct a new DumpEngine object
+         *
+         * @param _command      Pointer to the Command class object
+         * @param config        Output format and filters
+         * @note Hidden and write only commands, and commands starting with SPECIAL_CMD_ and TEST_ are never dumped
+         * @note Exits if the regular expression is not valid
+         */
+        DumpEngine(Command * _command, const dump_config_t & config);
+
+        /** @brief Get the number of commands which will be read */
+        size_t get_num_cmds() const {return cmds.size();};
+
+        /**
+         * @brief Read all the selected commands and write them to a stream
+         *
+         * @param os            Stream to write to, opened in binary mode for DUMP_FORMAT_BINARY
+         * @note The text format is printed to stdout by the command_map as the values arrive
+         */
+        control_ret_t run(std::ostream & os);
+};
+
+#endif
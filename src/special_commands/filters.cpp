@@ -194,6 +194,8 @@ control_ret_t read_write_buffer(const bool flag_buffer_get, const string filter_
 
 control_ret_t special_cmd_aec_filter(Command * command, bool flag_buffer_get, const string filename)
 {
+    // The other processes sharing the device must not change the filter or the bypass meanwhile
+    BusArbiterLock section(command->get_arbiter());
     cmd_param_t num_mics, num_farends;
 
     command->init_cmd_info("AEC_NUM_MICS");
@@ -239,6 +241,7 @@ control_ret_t special_cmd_aec_filter(Command * command, bool flag_buffer_get, co
 
 control_ret_t special_cmd_nlmodel_buffer(Command * command, bool flag_buffer_get, uint8_t band_index, const string filename)
 {
+    BusArbiterLock section(command->get_arbiter());
     const string start_coeff_cmd_name = "SPECIAL_CMD_NLMODEL_COEFF_START_OFFSET";
 
     const string filter_cmd_name = "SPECIAL_CMD_PP_NLMODEL"; // buffer cmd
@@ -300,6 +303,7 @@ control_ret_t special_cmd_nlmodel_buffer(Command * command, bool flag_buffer_get
 
 control_ret_t special_cmd_equalization_filter(Command * command, bool flag_buffer_get, uint8_t band_index, const string filename)
 {
+    BusArbiterLock section(command->get_arbiter());
     const string start_coeff_cmd_name = "SPECIAL_CMD_EQUALIZATION_COEFF_START_OFFSET";
 
     const string filter_cmd_name = "SPECIAL_CMD_PP_EQUALIZATION"; // buffer cmd
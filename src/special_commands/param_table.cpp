@@ -0,0 +1,195 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "param_table.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <sstream>
+#include <thread>
+
+#if (defined(__linux__) || defined(__APPLE__))
+#include "xvf_param_table.h"
+#include <signal.h>         // kill
+#include <cerrno>
+#endif
+
+using namespace std;
+
+#if (defined(__linux__) || defined(__APPLE__))
+
+static_assert(sizeof(xvf_param_table_header_t) == 24, "Parameter table header must not have padding");
+static_assert(sizeof(xvf_param_entry_t) == 72, "Parameter table entry must not have padding");
+
+using publish_clock_t = chrono::steady_clock;
+
+/** @brief Set by SIGINT to stop publishing */
+static atomic<bool> publish_stop(false);
+
+static void publish_signal_handler(int)
+{
+    publish_stop = true;
+}
+
+/** @brief Check if a table is published by a process which is still running */
+static bool is_table_published(const string shm_name)
+{
+    size_t size = 0;
+    const xvf_param_table_header_t * header = xvf_param_table_open(shm_name.c_str(), &size);
+    if(header == nullptr)
+    {
+        return false;
+    }
+    const pid_t pid = static_cast<pid_t>(header->publisher_pid);
+    munmap(const_cast<xvf_param_table_header_t *>(header), size);
+    return (kill(pid, 0) == 0) || (errno != ESRCH);
+}
+
+control_ret_t publish_params(Command * command, const string cmd_names, const watch_config_t & config, const string shm_name)
+{
+    vector<cmd_t> cmds;
+    stringstream ss(cmd_names);
+    string name;
+    size_t max_data_len = 0;
+    while(getline(ss, name, ','))
+    {
+        if(name.empty())
+        {
+            continue;
+        }
+        cmd_t cmd;
+        init_cmd(&cmd, name);
+        if(cmd.rw == CMD_WO)
+        {
+            cerr << "Command " << cmd.cmd_name << " is write only and can't be published" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        if(cmd.cmd_name.length() >= XVF_PARAM_NAME_SIZE)
+        {
+            cerr << "Command name " << cmd.cmd_name << " is too long to be published" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        max_data_len = max(max_data_len, command_param_type_size(cmd.type) * cmd.num_values);
+        cmds.push_back(cmd);
+    }
+    if(cmds.empty())
+    {
+        cerr << "No commands provided after the --publish option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    if(config.interval_us == 0)
+    {
+        cerr << "The --interval must be at least 1 us" << endl;
+        exit(HOST_APP_ERROR);
+    }
+
+    // Entries have the same size, so the values of every entry are 8 byte aligned
+    const size_t entry_size = (sizeof(xvf_param_entry_t) + max_data_len + 7) / 8 * 8;
+    const size_t table_size = sizeof(xvf_param_table_header_t) + cmds.size() * entry_size;
+    if(is_table_published(shm_name))
+    {
+        cerr << "The shared memory object " << shm_name << " is published by another process" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    // A table left by a publisher which has died is replaced by a new object, so the readers
+    // which still have it mapped keep the old one instead of seeing it truncated
+    shm_unlink(shm_name.c_str());
+    int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+    {
+        cerr << "Could not create the shared memory object " << shm_name << endl;
+        exit(HOST_APP_ERROR);
+    }
+    void * addr = (ftruncate(fd, table_size) == 0) ? mmap(nullptr, table_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        cerr << "Could not map the shared memory object " << shm_name << endl;
+        shm_unlink(shm_name.c_str());
+        exit(HOST_APP_ERROR);
+    }
+    uint8_t * table = static_cast<uint8_t *>(addr);
+    xvf_param_table_header_t * header = reinterpret_cast<xvf_param_table_header_t *>(table);
+    vector<xvf_param_entry_t *> entries;
+    for(size_t i = 0; i < cmds.size(); i++)
+    {
+        xvf_param_entry_t * entry = reinterpret_cast<xvf_param_entry_t *>(table + sizeof(*header) + i * entry_size);
+        memset(entry, 0, entry_size);
+        strncpy(entry->name, cmds[i].cmd_name.c_str(), XVF_PARAM_NAME_SIZE - 1);
+        entry->type = static_cast<uint8_t>(cmds[i].type);
+        entry->num_values = static_cast<uint16_t>(cmds[i].num_values);
+        entry->data_len = static_cast<uint32_t>(command_param_type_size(cmds[i].type) * cmds[i].num_values);
+        entries.push_back(entry);
+    }
+    header->version = XVF_PARAM_TABLE_VERSION;
+    header->num_entries = static_cast<uint16_t>(cmds.size());
+    header->entry_size = static_cast<uint32_t>(entry_size);
+    header->interval_us = config.interval_us;
+    header->publisher_pid = static_cast<uint64_t>(getpid());
+    // Readers ignore the table until the magic number is set
+    __atomic_store_n(&header->magic, XVF_PARAM_TABLE_MAGIC, __ATOMIC_RELEASE);
+
+    publish_stop = false;
+    signal(SIGINT, publish_signal_handler);
+    signal(SIGTERM, publish_signal_handler);
+
+    vector<uint8_t> data(max_data_len + 1); // one extra for the status
+    const publish_clock_t::duration interval = chrono::microseconds(config.interval_us);
+    const publish_clock_t::time_point start = publish_clock_t::now();
+    uint64_t tick = 0;
+    size_t num_updates = 0;
+    // The table is removed on a read error as well, so the readers don't keep the last values as valid
+    auto unpublish = [&]()
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        munmap(addr, table_size);
+        shm_unlink(shm_name.c_str());
+    };
+    try
+    {
+        while(!publish_stop && ((config.num_samples == 0) || (num_updates < config.num_samples)))
+        {
+            this_thread::sleep_until(start + tick * interval);
+            for(size_t i = 0; i < cmds.size(); i++)
+            {
+                xvf_param_entry_t * entry = entries[i];
+                // The values must come from the device, not from the shadow cache
+                command->invalidate_cache(&cmds[i]);
+                command->command_get_bytes(&cmds[i], data.data(), entry->data_len + 1);
+                const uint64_t timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(publish_clock_t::now().time_since_epoch()).count();
+
+                // Sequence lock: odd while the values are being updated
+                const uint32_t seq = entry->seq;
+                __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELAXED);
+                __atomic_thread_fence(__ATOMIC_RELEASE);
+                memcpy(entry + 1, &data[1], entry->data_len);
+                entry->timestamp_ns = timestamp_ns;
+                entry->num_updates++;
+                __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+            }
+            num_updates++;
+            // Missed ticks are skipped, the table only holds the latest values anyway
+            tick = max<uint64_t>(tick + 1, (publish_clock_t::now() - start) / interval);
+        }
+    }
+    catch(...)
+    {
+        unpublish();
+        throw;
+    }
+
+    unpublish();
+    cout << "Published " << num_updates << " updates of " << cmds.size() << " commands to " << shm_name << endl;
+    return CONTROL_SUCCESS;
+}
+
+#else
+
+control_ret_t publish_params(Command * command, const string cmd_names, const watch_config_t & config, const string shm_name)
+{
+    cerr << "Publishing to shared memory is only supported on Linux and Mac" << endl;
+    exit(HOST_APP_ERROR);
+}
+
+#endif
@@ -0,0 +1,25 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef PARAM_TABLE_H_
+#define PARAM_TABLE_H_
+
+#include "watch.hpp"
+
+/**
+ * @brief Publish the latest values of a set of commands in a shared memory table
+ *
+ * All the commands are read on every tick, scheduled on the monotonic clock, and each
+ * value is written to its entry under a sequence lock, see xvf_param_table.h for the layout
+ * and the reader functions. The shared memory object is removed when publishing stops.
+ *
+ * @param command       Pointer to the Command class object
+ * @param cmd_names     Comma separated list of commands to publish
+ * @param config        Update interval and number of updates, the format is not used
+ * @param shm_name      Shared memory object name
+ * @note Publishing stops after config.num_samples updates or on SIGINT
+ * @note Only supported on Linux and Mac
+ */
+control_ret_t publish_params(Command * command, const std::string cmd_names, const watch_config_t & config, const std::string shm_name = "/xvf_params");
+
+#endif
@@ -2,13 +2,12 @@
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
 #include "special_commands.hpp"
+#include "app_options.hpp"
 #include <fstream>
 #include <iomanip>
 #include <ctype.h>
 
-#if (defined(__APPLE__) || defined(_WIN32))
 #include <sstream>
-#endif
 
 using namespace std;
 
@@ -50,6 +49,241 @@ bool get_bypass_range_check(int * argc, char ** argv)
     }
 }
 
+bool get_bus_lock(int * argc, char ** argv)
+{
+    opt_t * lock_opt = option_lookup("--bus-lock", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, lock_opt);
+    if(index == 0)
+    {
+        return false;
+    }
+    remove_opt(argc, argv, index, 1);
+    return true;
+}
+
+bool get_profile_startup(int * argc, char ** argv)
+{
+    opt_t * profile_opt = option_lookup("--profile-startup", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, profile_opt);
+    if(index == 0)
+    {
+        return false;
+    }
+    remove_opt(argc, argv, index, 1);
+    return true;
+}
+
+plan_optimise_t get_plan_optimise_options(int * argc, char ** argv)
+{
+    plan_optimise_t optimise = {false, false, false};
+    opt_t * optimise_opt = option_lookup("--optimise", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, optimise_opt);
+    if(index != 0)
+    {
+        optimise.coalesce_writes = true;
+        remove_opt(argc, argv, index, 1);
+    }
+    opt_t * skip_opt = option_lookup("--skip-unchanged", options, num_options);
+    index = argv_option_lookup(*argc, argv, skip_opt);
+    if(index != 0)
+    {
+        if(!optimise.coalesce_writes)
+        {
+            cerr << "--skip-unchanged can only be used with --optimise" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        optimise.skip_unchanged = true;
+        remove_opt(argc, argv, index, 1);
+    }
+    opt_t * out_of_order_opt = option_lookup("--out-of-order", options, num_options);
+    index = argv_option_lookup(*argc, argv, out_of_order_opt);
+    if(index != 0)
+    {
+        optimise.out_of_order = true;
+        remove_opt(argc, argv, index, 1);
+    }
+    return optimise;
+}
+
+/** @brief Get the comma separated list following an option and remove both from argv */
+static vector<string> get_list_option(int * argc, char ** argv, const string long_name)
+{
+    vector<string> list;
+    opt_t * list_opt = option_lookup(long_name, options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, list_opt);
+    if(index == 0)
+    {
+        return list;
+    }
+    if(index + 1 >= static_cast<size_t>(*argc))
+    {
+        cerr << "No commands provided after the " << long_name << " option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    stringstream ss(argv[index + 1]);
+    string name;
+    while(getline(ss, name, ','))
+    {
+        if(!name.empty())
+        {
+            list.push_back(name);
+        }
+    }
+    remove_opt(argc, argv, index, 2);
+    return list;
+}
+
+cache_config_t get_cache_options(int * argc, char ** argv)
+{
+    cache_config_t config = {false, 0, {}, {}, nullptr};
+    opt_t * ttl_opt = option_lookup("--cache-ttl", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, ttl_opt);
+    if(index != 0)
+    {
+        if((index + 1 >= static_cast<size_t>(*argc)) || !isdigit(argv[index + 1][0]))
+        {
+            cerr << "No time to live in milliseconds provided after the --cache-ttl option" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        config.enabled = true;
+        config.ttl_ms = static_cast<unsigned>(strtoul(argv[index + 1], nullptr, 10));
+        remove_opt(argc, argv, index, 2);
+    }
+    config.static_cmds = get_list_option(argc, argv, "--cache-static");
+    config.bypass_cmds = get_list_option(argc, argv, "--cache-bypass");
+    if(!config.static_cmds.empty())
+    {
+        config.enabled = true;
+    }
+
+    opt_t * stats_opt = option_lookup("--stats", options, num_options);
+    index = argv_option_lookup(*argc, argv, stats_opt);
+    if(index != 0)
+    {
+        config.stats_stream = &cout;
+        remove_opt(argc, argv, index, 1);
+    }
+    return config;
+}
+
+/** @brief Get the argument following an option and remove both from argv, empty if the option is not present */
+static string get_string_option(int * argc, char ** argv, const string long_name)
+{
+    opt_t * str_opt = option_lookup(long_name, options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, str_opt);
+    if(index == 0)
+    {
+        return "";
+    }
+    if(index + 1 >= static_cast<size_t>(*argc))
+    {
+        cerr << "No value provided after the " << long_name << " option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    string value = argv[index + 1];
+    remove_opt(argc, argv, index, 2);
+    return value;
+}
+
+dump_config_t get_dump_options(int * argc, char ** argv)
+{
+    dump_config_t config = {DUMP_FORMAT_TEXT, -1, "", ""};
+    const string format = to_lower(get_string_option(argc, argv, "--dump-format"));
+    if(format == "json")
+    {
+        config.format = DUMP_FORMAT_JSON;
+    }
+    else if(format == "csv")
+    {
+        config.format = DUMP_FORMAT_CSV;
+    }
+    else if(format == "binary")
+    {
+        config.format = DUMP_FORMAT_BINARY;
+    }
+    else if(!format.empty() && (format != "text"))
+    {
+        cerr << "Invalid dump format " << format << ". Use text, json, csv or binary" << endl;
+        exit(HOST_APP_ERROR);
+    }
+
+    const string res_id = get_string_option(argc, argv, "--dump-resource");
+    if(!res_id.empty())
+    {
+        char * end = nullptr;
+        unsigned long value = strtoul(res_id.c_str(), &end, 0);
+        if((*end != '\0') || (value > UINT8_MAX))
+        {
+            cerr << "Invalid resource ID " << res_id << " provided after the --dump-resource option" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        config.res_id = static_cast<int>(value);
+    }
+    config.prefix = get_string_option(argc, argv, "--dump-prefix");
+    config.regex = get_string_option(argc, argv, "--dump-regex");
+    return config;
+}
+
+/** @brief Convert the argument of an option to an unsigned number, exits if it is not one */
+static unsigned long get_unsigned_arg(const string arg, const string long_name)
+{
+    char * end = nullptr;
+    unsigned long value = strtoul(arg.c_str(), &end, 0);
+    if(arg.empty() || !isdigit(arg[0]) || (*end != '\0'))
+    {
+        cerr << "Invalid number " << arg << " provided after the " << long_name << " option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    return value;
+}
+
+watch_config_t get_watch_options(int * argc, char ** argv)
+{
+    watch_config_t config = {100000, 0, WATCH_FORMAT_CSV, WATCH_CAPTURE_RECORDS};
+    const string interval = get_string_option(argc, argv, "--interval");
+    if(!interval.empty())
+    {
+        config.interval_us = static_cast<unsigned>(get_unsigned_arg(interval, "--interval"));
+    }
+    const string num_samples = get_string_option(argc, argv, "--watch-samples");
+    if(!num_samples.empty())
+    {
+        config.num_samples = get_unsigned_arg(num_samples, "--watch-samples");
+    }
+    const string format = to_lower(get_string_option(argc, argv, "--watch-format"));
+    if(format == "binary")
+    {
+        config.format = WATCH_FORMAT_BINARY;
+    }
+    else if(format == "capture")
+    {
+        config.format = WATCH_FORMAT_CAPTURE;
+    }
+    else if(!format.empty() && (format != "csv"))
+    {
+        cerr << "Invalid watch format " << format << ". Use csv, binary or capture" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const string capture_records = get_string_option(argc, argv, "--capture-records");
+    if(!capture_records.empty())
+    {
+        config.capture_records = get_unsigned_arg(capture_records, "--capture-records");
+    }
+    return config;
+}
+
+wait_config_t get_wait_options(int * argc, char ** argv)
+{
+    wait_config_t config = {0, ""};
+    const string timeout = get_string_option(argc, argv, "--timeout");
+    if(!timeout.empty())
+    {
+        config.timeout_ms = static_cast<unsigned>(get_unsigned_arg(timeout, "--timeout"));
+    }
+    config.then_snapshot = get_string_option(argc, argv, "--then-snapshot");
+    return config;
+}
+
 uint8_t get_band_option(int * argc, char ** argv)
 {
     opt_t *band_opt = option_lookup("--band", options, num_options);
@@ -105,6 +339,7 @@ control_ret_t print_help_menu()
     << endl << "You can use --bypass-range-check or -br to bypass parameter range checking."
     << endl << "Range check is True unless -br is specified."
     << endl << "You can use --command-map-path or -cmp to specify the comand_map object to use."
+    << endl << "Several commands can be given at once, separated by " << CMD_BATCH_SEPARATOR << "."
     << endl << endl << "Options:" << endl;
     for(opt_t opt : options)
     {
@@ -217,80 +452,190 @@ control_ret_t print_command_list()
     return CONTROL_SUCCESS;
 }
 
-control_ret_t dump_params(Command * command)
+control_ret_t dump_params(Command * command, const dump_config_t & config, const string filename)
 {
-    for(size_t i = 0; i < num_commands; i ++)
+    DumpEngine engine(command, config);
+    if(filename.empty())
     {
-        cmd_t cmd = {0};
-        init_cmd(&cmd, "_", i);
-        // skipping hidden commands
-        if(cmd.hidden_cmd)
+        return engine.run(cout);
+    }
+    if(config.format == DUMP_FORMAT_TEXT)
+    {
+        cerr << "Text dumps can only be printed, use --dump-format json, csv or binary to write " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    ofstream file(filename, ios::out | ios::binary | ios::trunc);
+    if(!file)
+    {
+        cerr << "Could not open a file " << filename << endl;
+        exit(HOST_APP_ERROR);
+    }
+    control_ret_t ret = engine.run(file);
+    if(ret != CONTROL_SUCCESS)
+    {
+        cerr << "Error occurred when writing to " << filename << endl;
+    }
+    return ret;
+}
+
+control_ret_t snapshot_params(Command * command, const string filename)
+{
+    CommandPlan plan;
+    vector<uint8_t> data;
+    for(size_t i = 0; i < num_commands; i++)
+    {
+        plan_op_t op;
+        init_cmd(&op.cmd, "_", i);
+        // skipping hidden, write only and order sensitive commands
+        if(op.cmd.hidden_cmd || (op.cmd.rw == CMD_WO) || is_order_sensitive_cmd(&op.cmd))
         {
             continue;
         }
-        if(cmd.rw != CMD_WO)
+        const size_t payload_len = command_param_type_size(op.cmd.type) * op.cmd.num_values;
+        data.resize(payload_len + 1); // one extra for the status
+        command->command_get_bytes(&op.cmd, data.data(), data.size());
+        op.is_read = false;
+        op.payload.assign(data.begin() + 1, data.end());
+        op.line = 0;
+        plan.add_op(move(op));
+    }
+    if(!plan.save_binary(filename))
+    {
+        exit(HOST_APP_ERROR);
+    }
+    cout << "Saved " << plan.get_ops().size() << " parameters into " << filename << endl;
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t restore_params(Command * command, const string filename)
+{
+    // The values have been read from a device, so they are not range checked
+    CommandPlan snapshot;
+    snapshot.load_binary(filename, nullptr);
+
+    // Read only values are kept in the snapshot for reference, they can't be restored
+    CommandPlan plan;
+    for(const plan_op_t & op : snapshot.get_ops())
+    {
+        if(!op.is_read && (op.cmd.rw == CMD_RW))
         {
-            command->do_command(cmd.cmd_name, nullptr, 0, 0);
+            plan.add_op(op);
         }
     }
-    return CONTROL_SUCCESS;
+    const size_t num_params = plan.get_ops().size();
+    BusArbiterLock section(command->get_arbiter());
+    size_t num_reads = 0;
+    const size_t num_unchanged = plan.skip_unchanged_writes(command, num_reads);
+    control_ret_t ret = plan.execute(command);
+
+    cout << "Restored " << plan.get_ops().size() << " of " << num_params << " parameters from " << filename
+    << ", " << num_unchanged << " already matched" << endl;
+    return ret;
 }
 
-control_ret_t execute_cmd_list(Command * command, const string filename)
+void optimise_cmd_plan(CommandPlan * plan, Command * command, plan_optimise_t optimise)
 {
-    size_t largest_command = 0;
-    for(size_t i = 0; i < num_commands; i++)
+    if(!optimise.coalesce_writes)
     {
-        cmd_t cmd = {0};
-        init_cmd(&cmd, "_", i);
-        size_t num_args = cmd.num_values;
-        largest_command = (num_args > largest_command) ? num_args : largest_command;
+        return;
     }
-    largest_command++; // +1 for the command name
-    ifstream file(filename, ios::in);
-    if(!file)
+    const size_t num_ops = plan->get_ops().size();
+    const size_t num_coalesced = plan->coalesce_writes();
+    size_t num_unchanged = 0;
+    size_t num_reads = 0;
+    if(optimise.skip_unchanged && (command != nullptr))
     {
-        cerr << "Could not open a file " << filename << endl;
-        exit(HOST_APP_ERROR);
+        num_unchanged = plan->skip_unchanged_writes(command, num_reads);
+    }
+    const size_t num_transactions = plan->get_ops().size() + num_reads;
+
+    cout << "Optimised " << num_ops << " commands into " << num_transactions << " transactions: "
+    << num_coalesced << " repeated writes removed";
+    if(optimise.skip_unchanged && (command != nullptr))
+    {
+        cout << ", " << num_unchanged << " unchanged writes skipped after " << num_reads << " reads";
     }
-    string line;
-    while(getline(file, line))
+    cout << ", " << static_cast<long long>(num_ops) - static_cast<long long>(num_transactions) << " transactions saved" << endl;
+}
+
+void check_plan_writable(const CommandPlan & plan, const string filename)
+{
+    for(const plan_op_t & op : plan.get_ops())
     {
-        // TODO: think about -e use cases whether 128 bytes per line is enough
-        const size_t max_line_len = 128;
-        char buff[max_line_len];
-        int i = 0;
+        if(!op.is_read && (op.cmd.rw == CMD_RO))
+        {
+            cerr << "Command " << op.cmd.cmd_name << " from " << filename << " is read only, use --restore for snapshots" << endl;
+            exit(HOST_APP_ERROR);
+        }
+    }
+}
 
-        char ** line_ch = new char * [largest_command];
-        int num = 0;
-        stringstream ss(line);
-        string word;
-        // if newline
-        if(ss.peek() == -1)
+control_ret_t execute_cmd_list(Command * command, plan_optimise_t optimise, const string filename)
+{
+    CommandPlan plan;
+    if(is_command_plan_file(filename))
+    {
+        plan.load_binary(filename, command->get_check_range());
+        check_plan_writable(plan, filename);
+    }
+    else
+    {
+        plan.compile_text(filename, command->get_check_range());
+    }
+    // The unchanged writes are only skipped if no other process changes them meanwhile
+    BusArbiterLock section(command->get_arbiter());
+    optimise_cmd_plan(&plan, command, optimise);
+    return plan.execute(command, optimise.out_of_order);
+}
+
+bool is_cmd_batch(char ** argv, int argc, int cmd_indx)
+{
+    for(int i = cmd_indx; i < argc; i++)
+    {
+        if(string(argv[i]) == CMD_BATCH_SEPARATOR)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+control_ret_t execute_cmd_batch(Command * command, plan_optimise_t optimise, char ** argv, int argc, int cmd_indx)
+{
+    CommandPlan plan;
+    vector<string> words;
+    size_t cmd_num = 0;
+    for(int i = cmd_indx; i <= argc; i++)
+    {
+        if((i < argc) && (string(argv[i]) != CMD_BATCH_SEPARATOR))
         {
+            words.push_back(argv[i]);
             continue;
         }
-        while(ss >> word)
+        // skip empty commands
+        if(words.empty())
         {
-            memcpy(&buff[i], word.c_str(), word.length());
-            buff[i + word.length()] = '\0';
-            line_ch[num] = &buff[i];
-            i += word.length() + 2;
-            if(i > max_line_len)
-            {
-                cerr << "Line:" << endl << line
-                << endl << "Exceeded " << max_line_len
-                << " characters limit" << endl;
-                return CONTROL_BAD_COMMAND;
-            }
-            num++;
+            continue;
         }
-        int cmd_indx = 0;
-        int arg_indx =  cmd_indx + 1; // 0 is the command
-        command->do_command(line_ch[cmd_indx], line_ch, num, arg_indx);
-        delete []line_ch;
+        cmd_num++;
+        plan.compile_words(words, command->get_check_range(), "command " + to_string(cmd_num), cmd_num);
+        words.clear();
+    }
+    BusArbiterLock section(command->get_arbiter());
+    optimise_cmd_plan(&plan, command, optimise);
+    return plan.execute(command, optimise.out_of_order);
+}
+
+control_ret_t compile_cmd_list(check_range_fptr check_range, plan_optimise_t optimise, const string in_filename, const string out_filename)
+{
+    CommandPlan plan;
+    plan.compile_text(in_filename, check_range);
+    optimise_cmd_plan(&plan, nullptr, optimise);
+    if(!plan.save_binary(out_filename))
+    {
+        exit(HOST_APP_ERROR);
     }
-    file.close();
+    cout << "Compiled " << plan.get_ops().size() << " commands from " << in_filename << " into " << out_filename << endl;
     return CONTROL_SUCCESS;
 }
 
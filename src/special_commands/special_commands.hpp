@@ -4,7 +4,11 @@
 #ifndef SPECIAL_COMMANDS_H_
 #define SPECIAL_COMMANDS_H_
 
-#include "command.hpp"
+#include "dump_engine.hpp"
+#include "capture_file.hpp"
+#include "param_table.hpp"
+#include "wait_for.hpp"
+#include "command_session.hpp"
 
 static opt_t options[] = {
     {"--help",                    "-h",        "display this information"                                                                       },
@@ -13,8 +17,37 @@ static opt_t options[] = {
     {"--use",                     "-u",        "use specific hardware protocol, I2C, SPI and USB are available to use"                          },
     {"--command-map-path",        "-cmp",      "use specific command map path, the path is relative to the working dir"                         },
     {"--bypass-range-check",      "-br",       "bypass parameter range check",                                                                  },
-    {"--dump-params",             "-d",        "print all readable parameters"                                                                  },
-    {"--execute-command-list",    "-e",        "execute commands from .txt file, one command per line, don't need -u * in the .txt file"        },
+    {"--dump-params",             "-d",        "print all readable parameters, or write them to the file given after this option"              },
+    {"--dump-format",             "-df",       "format of --dump-params: text, json, csv or binary, default is text. Binary dumps can be given to --restore"},
+    {"--dump-resource",           "-dr",       "only dump the parameters of the given resource ID"                                              },
+    {"--dump-prefix",             "-dp",       "only dump the parameters whose name starts with the given prefix"                               },
+    {"--dump-regex",              "-dx",       "only dump the parameters whose name matches the given regular expression"                       },
+    {"--watch",                   "-w",        "sample the comma separated list of commands at a fixed rate and write the timestamped values as CSV to stdout, or to the file given after the list"},
+    {"--interval",                "-it",       "time between two --watch samples or --publish updates in microseconds, default is 100000"},
+    {"--watch-samples",           "-wn",       "number of --watch samples or --publish updates to take, default is to sample until Ctrl+C is pressed"},
+    {"--watch-format",            "-wf",       "format of the --watch samples: csv, binary or capture, default is csv. A capture is a ring file which keeps the latest --capture-records samples"},
+    {"--capture-records",         "-cr",       "number of samples a --watch capture file can hold, default is 1000000"                          },
+    {"--read-capture",            "-rc",       "print the samples of a --watch capture file as CSV, optionally only from and to the given number of seconds since the first sample. A negative start is relative to the latest sample"},
+    {"--publish",                 "-pb",       "read the comma separated list of commands every --interval and publish the latest values in a shared memory table, see xvf_param_table.h. The table name can be given after the list, default is /xvf_params"},
+    {"--wait-for",                "-wt",       "read a command until its values meet a condition given as one argument, \"<command> <op> <value>\" with op one of ==, !=, <, <=, > or >=. The command is read more often while its value changes"},
+    {"--timeout",                 "-to",       "time in milliseconds after which --wait-for gives up with an error, default is to wait forever"},
+    {"--then-snapshot",           "-ts",       "comma separated list of commands to read and print as soon as the --wait-for condition is met"},
+    {"--snapshot",                "-ss",       "save all readable parameters into a binary file, which --restore can apply, default is snapshot.bin"},
+    {"--restore",                 "-rs",       "read all the parameters saved with --snapshot and write only the ones which differ, default is snapshot.bin"},
+    {"--execute-command-list",    "-e",        "execute commands from .txt file, one command per line, don't need -u * in the .txt file. A binary plan from --compile-command-list can be given instead. All the lines are checked before the first command is sent"},
+    {"--interactive",             "-i",        "keep the device open and run the commands typed one per line, with Tab completion of the command names and the time taken by each command"},
+    {"--stdin",                   "-si",       "keep the device open and run the commands read from stdin one per line, printing a JSON line with the status, time and values of each command"},
+    {"--boot-apply",              "-ba",       "apply a binary plan from --compile-command-list as fast as possible, grouping the writes to the same resource, and print the time from the process start to the last acknowledgement"},
+    {"--optimise",                "-op",       "remove the writes of -e, --compile-command-list and --boot-apply which are overwritten before a read or a SPECIAL_CMD_ or TEST_ command, and print how many transactions are saved"},
+    {"--skip-unchanged",          "-su",       "with --optimise, read the commands written by -e or --boot-apply first and skip the writes which would not change the value held by the device"},
+    {"--out-of-order",            "-oo",       "while a resource of the device asks -e or --boot-apply to retry, send the next commands of the other resources and come back to it later. Commands of the same resource and SPECIAL_CMD_ and TEST_ commands keep their order"},
+    {"--cache-ttl",               "-ct",       "keep the values read from and written to the device on the host, and serve the reads from there for the given number of milliseconds"},
+    {"--cache-static",            "-cs",       "comma separated list of commands whose values are read from the device only once, implies the cache is used"},
+    {"--cache-bypass",            "-cb",       "comma separated list of commands which are always read from the device, for values which can change at any time"},
+    {"--stats",                   "-st",       "print the number of reads and writes sent to the device and the cache hit rate before exiting, and the time spent waiting for the device with --bus-lock"},
+    {"--bus-lock",                "-bl",       "share the device with the other applications which use --bus-lock or set XVF_BUS_ARBITRATION=1, in the order they asked for it. The device is held for each transaction, and for the whole of -e, --boot-apply, --restore and the filter commands"},
+    {"--profile-startup",         "-ps",       "print the time taken by each step from the process start to the exit, such as loading the command map and the device driver, and connecting to the device"},
+    {"--compile-command-list",    "-ccl",      "check the commands in the .txt file without accessing the device and save them in a binary plan for -e, default is commands.txt commands.bin"},
     {"--get-aec-filter",          "-gf",       "get AEC filter into .bin files, default is aec_filter.bin.fx.mx"                                },
     {"--set-aec-filter",          "-sf",       "set AEC filter from .bin files, default is aec_filter.bin.fx.mx"                                },
     {"--get-nlmodel-buffer",      "-gn",       "get NLModel filter into .bin file, default is nlm_buffer.bin"                                   },
@@ -45,6 +78,58 @@ std::string get_cmd_map_abs_path(int * argc, char ** argv);
  */
 bool get_bypass_range_check(int * argc, char ** argv);
 
+/**
+ * @brief Gets bus arbitration state by looking for --bus-lock in argv
+ *
+ * @note Will decrement argc, if option is present
+ */
+bool get_bus_lock(int * argc, char ** argv);
+
+/**
+ * @brief Gets startup profiling state by looking for --profile-startup in argv
+ *
+ * @note Will decrement argc, if option is present
+ */
+bool get_profile_startup(int * argc, char ** argv);
+
+/**
+ * @brief Gets command plan optimisations by looking for --optimise, --skip-unchanged and --out-of-order in argv
+ *
+ * @note Will decrement argc, if options are present
+ */
+plan_optimise_t get_plan_optimise_options(int * argc, char ** argv);
+
+/**
+ * @brief Gets shadow cache configuration by looking for --cache-ttl <ms>, --cache-static <cmds>,
+ * --cache-bypass <cmds> and --stats in argv
+ *
+ * @note Will decrement argc, if options are present
+ */
+cache_config_t get_cache_options(int * argc, char ** argv);
+
+/**
+ * @brief Gets parameter dump configuration by looking for --dump-format <format>, --dump-resource <id>,
+ * --dump-prefix <prefix> and --dump-regex <regex> in argv
+ *
+ * @note Will decrement argc, if options are present
+ */
+dump_config_t get_dump_options(int * argc, char ** argv);
+
+/**
+ * @brief Gets watch configuration by looking for --interval <us>, --watch-samples <n>, --watch-format <format>
+ * and --capture-records <n> in argv
+ *
+ * @note Will decrement argc, if options are present
+ */
+watch_config_t get_watch_options(int * argc, char ** argv);
+
+/**
+ * @brief Gets wait configuration by looking for --timeout <ms> and --then-snapshot <commands> in argv
+ *
+ * @note Will decrement argc, if options are present
+ */
+wait_config_t get_wait_options(int * argc, char ** argv);
+
 /**
  * @brief Gets NL model band to get/set state by looking for --band <index> in argv
  *
@@ -64,24 +149,133 @@ control_ret_t print_help_menu();
 control_ret_t print_command_list();
 
 /**
- * @brief Do a read of all possible read commands and dump it into stdout
+ * @brief Do a read of all possible read commands and dump it into stdout or into a file
  *
  * @param command   Pointer to the Command class object
+ * @param config    Output format and filters
+ * @param filename  File name to write to, empty to write to stdout
  * @note Commands starting with SPECIAL_CMD_ and TEST_ will not be executed
+ * @note The reads are grouped by resource ID
+ */
+control_ret_t dump_params(Command * command, const dump_config_t & config, const std::string filename = "");
+
+/**
+ * @brief Save all readable parameters into a binary snapshot
+ *
+ * The snapshot uses the binary command plan format, with one write per parameter
+ * holding the name, type and values read from the device.
+ *
+ * @param command   Pointer to the Command class object
+ * @param filename  File name to write to
+ * @note Hidden commands and commands starting with SPECIAL_CMD_ and TEST_ are not saved
  */
-control_ret_t dump_params(Command * command);
+control_ret_t snapshot_params(Command * command, const std::string filename = "snapshot.bin");
 
 /**
- * @brief Execute commands from a text file.
+ * @brief Restore the parameters saved with snapshot_params()
  *
- * Will execute one command per line.
+ * The current value of every parameter in the snapshot is read first, and
+ * only the parameters which differ from the snapshot are written.
  *
  * @param command   Pointer to the Command class object
  * @param filename  File name to read from
+ * @note Read only parameters in the snapshot are not written
+ * @note The values are not range checked, as they have been read from a device
+ */
+control_ret_t restore_params(Command * command, const std::string filename = "snapshot.bin");
+
+/**
+ * @brief Execute commands from a text file or from a binary command plan.
+ *
+ * Will execute one command per line. The whole file is compiled into a plan
+ * before the first command is sent to the device.
+ *
+ * @param command   Pointer to the Command class object
+ * @param optimise  Optimisations to apply to the plan before it is executed
+ * @param filename  File name to read from
  * @note If filename is not specified will look for 'commands.txt'
  * @note Don't use --use inside text file
  */
-control_ret_t execute_cmd_list(Command * command, const std::string = "commands.txt");
+control_ret_t execute_cmd_list(Command * command, plan_optimise_t optimise, const std::string = "commands.txt");
+
+/** @brief Argument separating the commands given on the command line */
+#define CMD_BATCH_SEPARATOR "--"
+
+/**
+ * @brief Check if several commands are given on the command line
+ *
+ * @param argv      Pointer to command line arguments
+ * @param argc      Number of arguments in command line
+ * @param cmd_indx  Index of argv where the first command starts
+ * @return          true if CMD_BATCH_SEPARATOR is one of the arguments
+ */
+bool is_cmd_batch(char ** argv, int argc, int cmd_indx);
+
+/**
+ * @brief Execute the commands given on the command line, separated by CMD_BATCH_SEPARATOR
+ *
+ * Each command is given as for a single command: its name followed by the values to write,
+ * or by nothing to read it. All the commands are compiled into a plan before the first one
+ * is sent to the device, as with --execute-command-list.
+ *
+ * @param command   Pointer to the Command class object
+ * @param optimise  Optimisations to apply to the plan before it is executed
+ * @param argv      Pointer to command line arguments
+ * @param argc      Number of arguments in command line
+ * @param cmd_indx  Index of argv where the first command starts
+ */
+control_ret_t execute_cmd_batch(Command * command, plan_optimise_t optimise, char ** argv, int argc, int cmd_indx);
+
+/**
+ * @brief Compile commands from a text file into a binary command plan
+ *
+ * @param check_range   Range check, such as check_values_in_range(), nullptr to bypass it
+ * @param optimise      Optimisations to apply to the plan before it is saved
+ * @param in_filename   Text file name to read from
+ * @param out_filename  Binary plan file name to write to
+ * @note The device is not accessed, so the unchanged writes are not skipped
+ */
+control_ret_t compile_cmd_list(check_range_fptr check_range, plan_optimise_t optimise, const std::string in_filename = "commands.txt", const std::string out_filename = "commands.bin");
+
+/**
+ * @brief Apply a binary command plan in the shortest possible time after the process start
+ *
+ * Loads the command_map and the device driver, then sends the plan with the writes
+ * to the same resource grouped together, and prints where the time has gone.
+ *
+ * @param command_map_path      Absolute path to the command map
+ * @param device_dl_name        Device driver name to load
+ * @param bypass_range_check    Bypass range check state
+ * @param bus_lock              Share the device with other processes, it is held until the plan has been sent
+ * @param optimise              Optimisations to apply to the plan before it is sent
+ * @param filename              Binary plan file name to read from
+ * @note The commands in the plan are not resolved again with the command_map, so the plan
+ * has to be compiled for the same firmware. They are if the unchanged writes are skipped,
+ * to know which commands can be read.
+ */
+control_ret_t boot_apply(const std::string command_map_path, const std::string device_dl_name, bool bypass_range_check, bool bus_lock, plan_optimise_t optimise, const std::string filename);
+
+/**
+ * @brief Apply the requested optimisations to a command plan and print how many transactions are saved
+ *
+ * @param plan      Pointer to the plan to optimise
+ * @param command   Pointer to the Command class object, nullptr if the device is not accessed
+ * @param optimise  Optimisations to apply
+ * @note Nothing is printed if no optimisation is requested
+ */
+void optimise_cmd_plan(CommandPlan * plan, Command * command, plan_optimise_t optimise);
+
+/**
+ * @brief Check that a plan doesn't write any read only command
+ *
+ * Snapshots and binary parameter dumps keep the values of the read only commands for reference,
+ * so they can be restored but not applied as a command list.
+ *
+ * @param plan      Plan to check
+ * @param filename  File the plan has been loaded from, printed with the error
+ * @note Exits with an error message if a read only command is written
+ */
+void check_plan_writable(const CommandPlan & plan, const std::string filename);
 
 /**
  * @brief Set or get AEC filter
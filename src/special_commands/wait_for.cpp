@@ -0,0 +1,198 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "wait_for.hpp"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+using wait_clock_t = chrono::steady_clock;
+
+/** @brief Enum for the comparison operators of a condition */
+enum wait_op_t {WAIT_OP_EQ, WAIT_OP_NE, WAIT_OP_LT, WAIT_OP_LE, WAIT_OP_GT, WAIT_OP_GE};
+
+/** @brief Get a value as a double, so values of any type can be compared */
+static double param_to_double(cmd_param_type_t type, const cmd_param_t value)
+{
+    switch(type)
+    {
+    case TYPE_UINT8:
+        return value.ui8;
+    case TYPE_INT32:
+        return value.i32;
+    case TYPE_UINT32:
+        return value.ui32;
+    default:
+        return value.f;
+    }
+}
+
+static bool compare(wait_op_t op, double value, double ref)
+{
+    switch(op)
+    {
+    case WAIT_OP_EQ:
+        return value == ref;
+    case WAIT_OP_NE:
+        return value != ref;
+    case WAIT_OP_LT:
+        return value < ref;
+    case WAIT_OP_LE:
+        return value <= ref;
+    case WAIT_OP_GT:
+        return value > ref;
+    default:
+        return value >= ref;
+    }
+}
+
+/** @brief Check all the values read, after the status byte, meet the condition */
+static bool is_condition_met(const cmd_t & cmd, wait_op_t op, const vector<double> & refs, const uint8_t * data)
+{
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        const double value = param_to_double(cmd.type, command_param_from_bytes(cmd.type, &data[1], i));
+        if(!compare(op, value, refs[(refs.size() == 1) ? 0 : i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** @brief Print the values read, after the status byte */
+static void print_data(Command * command, const cmd_t & cmd, const uint8_t * data)
+{
+    vector<cmd_param_t> values(cmd.num_values);
+    for(unsigned i = 0; i < cmd.num_values; i++)
+    {
+        values[i] = command_param_from_bytes(cmd.type, &data[1], i);
+    }
+    command->print_values(&cmd, values.data());
+}
+
+control_ret_t wait_for_condition(Command * command, const string condition, const wait_config_t & config)
+{
+    static const vector<pair<string, wait_op_t>> ops = {
+        {"==", WAIT_OP_EQ}, {"!=", WAIT_OP_NE}, {"<", WAIT_OP_LT}, {"<=", WAIT_OP_LE}, {">", WAIT_OP_GT}, {">=", WAIT_OP_GE}
+    };
+
+    stringstream ss(condition);
+    string cmd_name, op_str, value_str;
+    ss >> cmd_name >> op_str;
+    auto op = find_if(ops.begin(), ops.end(), [&](const pair<string, wait_op_t> & o) {return o.first == op_str;});
+    if(cmd_name.empty() || (op == ops.end()))
+    {
+        cerr << "Invalid condition \"" << condition << "\". Use \"<command> <op> <value>\" with op one of ==, !=, <, <=, > or >=" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    cmd_t cmd;
+    init_cmd(&cmd, cmd_name);
+    if((cmd.rw == CMD_WO) || (cmd.type == TYPE_CHAR))
+    {
+        cerr << "Command " << cmd.cmd_name << " can't be compared to a value" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    vector<double> refs;
+    while(ss >> value_str)
+    {
+        cmd_param_t value;
+        string error;
+        if(!command_param_from_str(cmd.type, value_str, value, error))
+        {
+            cerr << error << endl;
+            exit(HOST_APP_ERROR);
+        }
+        refs.push_back(param_to_double(cmd.type, value));
+    }
+    if((refs.size() != 1) && (refs.size() != cmd.num_values))
+    {
+        cerr << "Condition on " << cmd.cmd_name << " needs 1 or " << cmd.num_values << " values" << endl;
+        exit(HOST_APP_ERROR);
+    }
+
+    // Resolve the snapshot in advance, so only the reads are left once the condition is met
+    vector<cmd_t> snapshot_cmds;
+    vector<vector<uint8_t>> snapshot_data;
+    stringstream snapshot_ss(config.then_snapshot);
+    while(getline(snapshot_ss, cmd_name, ','))
+    {
+        if(cmd_name.empty())
+        {
+            continue;
+        }
+        cmd_t snapshot_cmd;
+        init_cmd(&snapshot_cmd, cmd_name);
+        if(snapshot_cmd.rw == CMD_WO)
+        {
+            cerr << "Command " << snapshot_cmd.cmd_name << " is write only and can't be read" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        snapshot_cmds.push_back(snapshot_cmd);
+        snapshot_data.emplace_back(command_param_type_size(snapshot_cmd.type) * snapshot_cmd.num_values + 1);
+    }
+
+    const size_t data_len = command_param_type_size(cmd.type) * cmd.num_values + 1; // one extra for the status
+    vector<uint8_t> data(data_len);
+    vector<uint8_t> prev_data(data_len);
+    const wait_clock_t::time_point start = wait_clock_t::now();
+    const wait_clock_t::time_point deadline = start + chrono::milliseconds(config.timeout_ms);
+    chrono::microseconds poll_interval(WAIT_POLL_MIN_US);
+    size_t num_reads = 0;
+    while(1)
+    {
+        // The value must come from the device every time
+        command->invalidate_cache(&cmd);
+        command->command_get_bytes(&cmd, data.data(), data_len);
+        num_reads++;
+        if(is_condition_met(cmd, op->second, refs, data.data()))
+        {
+            break;
+        }
+        // Back off while the value is steady, poll fast again as soon as it moves
+        if((num_reads > 1) && (data == prev_data))
+        {
+            poll_interval = min(poll_interval * 2, chrono::microseconds(WAIT_POLL_MAX_US));
+        }
+        else
+        {
+            poll_interval = chrono::microseconds(WAIT_POLL_MIN_US);
+        }
+        prev_data.swap(data);
+
+        const wait_clock_t::time_point now = wait_clock_t::now();
+        if((config.timeout_ms != 0) && (now >= deadline))
+        {
+            cerr << "Timed out after " << chrono::duration_cast<chrono::milliseconds>(now - start).count()
+            << " ms and " << num_reads << " reads waiting for " << condition << ", the last value was:" << endl;
+            print_data(command, cmd, prev_data.data());
+            exit(HOST_APP_ERROR);
+        }
+        this_thread::sleep_until((config.timeout_ms != 0) ? min(now + poll_interval, deadline) : now + poll_interval);
+    }
+    const wait_clock_t::time_point trigger = wait_clock_t::now();
+
+    for(size_t i = 0; i < snapshot_cmds.size(); i++)
+    {
+        command->invalidate_cache(&snapshot_cmds[i]);
+        command->command_get_bytes(&snapshot_cmds[i], snapshot_data[i].data(), snapshot_data[i].size());
+    }
+    const wait_clock_t::time_point snapshot_end = wait_clock_t::now();
+
+    cout << "Condition met after " << chrono::duration_cast<chrono::milliseconds>(trigger - start).count()
+    << " ms and " << num_reads << " reads" << endl;
+    print_data(command, cmd, data.data());
+    if(!snapshot_cmds.empty())
+    {
+        cout << "Snapshot of " << snapshot_cmds.size() << " commands read within "
+        << chrono::duration_cast<chrono::microseconds>(snapshot_end - trigger).count() << " us of the trigger" << endl;
+        for(size_t i = 0; i < snapshot_cmds.size(); i++)
+        {
+            print_data(command, snapshot_cmds[i], snapshot_data[i].data());
+        }
+    }
+    return CONTROL_SUCCESS;
+}
@@ -0,0 +1,45 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef WAIT_FOR_H_
+#define WAIT_FOR_H_
+
+#include "command.hpp"
+#include <vector>
+
+/** @brief Shortest time between two reads of the condition command, in microseconds */
+#define WAIT_POLL_MIN_US 1000
+
+/** @brief Longest time between two reads of the condition command, in microseconds */
+#define WAIT_POLL_MAX_US 100000
+
+/** @brief Wait configuration structure */
+struct wait_config_t
+{
+    /** Time to give up after, in milliseconds, 0 to wait forever */
+    unsigned timeout_ms;
+    /** Comma separated list of commands to read as soon as the condition is met */
+    std::string then_snapshot;
+};
+
+/**
+ * @brief Block until a command value meets a condition, then read a set of commands
+ *
+ * The condition is "<command> <op> <value>...", with op one of ==, !=, <, <=, > or >=.
+ * A single value is compared to all the values of the command, otherwise one value per
+ * command value must be given, and all the comparisons must hold.
+ *
+ * The command is polled in this process with an adaptive interval: it starts at
+ * WAIT_POLL_MIN_US, doubles every time the value has not changed since the previous read,
+ * up to WAIT_POLL_MAX_US, and goes back to the minimum as soon as the value moves.
+ * The snapshot commands are resolved before polling starts and read back to back once
+ * the condition is met, before anything is printed.
+ *
+ * @param command       Pointer to the Command class object
+ * @param condition     Condition to wait for
+ * @param config        Timeout and snapshot commands
+ * @note Exits with an error if the timeout expires first
+ */
+control_ret_t wait_for_condition(Command * command, const std::string condition, const wait_config_t & config);
+
+#endif
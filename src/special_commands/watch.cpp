@@ -0,0 +1,356 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "capture_file.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+using watch_clock_t = chrono::steady_clock;
+
+/** @brief Set by SIGINT to stop the sampling */
+static atomic<bool> watch_stop(false);
+
+static void watch_signal_handler(int)
+{
+    watch_stop = true;
+}
+
+vector<uint8_t> encode_watch_descriptors(const vector<cmd_t> & cmds)
+{
+    vector<uint8_t> data;
+    for(const cmd_t & cmd : cmds)
+    {
+        // name length, name, type, num_values (2 bytes)
+        data.push_back(static_cast<uint8_t>(cmd.cmd_name.length()));
+        data.insert(data.end(), cmd.cmd_name.begin(), cmd.cmd_name.end());
+        data.push_back(static_cast<uint8_t>(cmd.type));
+        data.push_back(static_cast<uint8_t>(cmd.num_values & 0xFF));
+        data.push_back(static_cast<uint8_t>(cmd.num_values >> 8));
+    }
+    return data;
+}
+
+size_t decode_watch_descriptors(const uint8_t * data, size_t data_len, unsigned num_cmds, vector<cmd_t> & cmds)
+{
+    size_t pos = 0;
+    cmds.clear();
+    for(unsigned n = 0; n < num_cmds; n++)
+    {
+        if((pos + 1 > data_len) || (pos + 1 + data[pos] + 3 > data_len))
+        {
+            return 0;
+        }
+        cmd_t cmd = {};
+        cmd.cmd_name.assign(reinterpret_cast<const char *>(&data[pos + 1]), data[pos]);
+        pos += 1 + cmd.cmd_name.length();
+        cmd.type = static_cast<cmd_param_type_t>(data[pos]);
+        cmd.num_values = data[pos + 1] | (data[pos + 2] << 8);
+        cmd.rw = CMD_RO;
+        pos += 3;
+        if(cmd.type > TYPE_RADIANS)
+        {
+            return 0;
+        }
+        cmds.push_back(cmd);
+    }
+    return pos;
+}
+
+size_t get_watch_record_size(const vector<cmd_t> & cmds)
+{
+    size_t record_size = WATCH_RECORD_HEADER_SIZE;
+    for(const cmd_t & cmd : cmds)
+    {
+        record_size += command_param_type_size(cmd.type) * cmd.num_values;
+    }
+    return record_size;
+}
+
+size_t get_watch_csv_line_size(const vector<cmd_t> & cmds)
+{
+    size_t line_size = 32;
+    for(const cmd_t & cmd : cmds)
+    {
+        line_size += 4 + cmd.num_values * 24;
+    }
+    return line_size;
+}
+
+/** @brief Write the header and the command descriptors of a binary watch stream */
+static void write_binary_header(ostream & os, const vector<cmd_t> & cmds, const watch_config_t & config, uint32_t record_size)
+{
+    watch_stream_header_t header = {WATCH_STREAM_MAGIC, WATCH_STREAM_VERSION, static_cast<uint16_t>(cmds.size()), config.interval_us, record_size};
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    const vector<uint8_t> descriptors = encode_watch_descriptors(cmds);
+    os.write(reinterpret_cast<const char *>(descriptors.data()), descriptors.size());
+}
+
+void write_watch_csv_header(ostream & os, const vector<cmd_t> & cmds)
+{
+    os << "time_us,seq";
+    for(const cmd_t & cmd : cmds)
+    {
+        if((cmd.num_values == 1) || (cmd.type == TYPE_CHAR))
+        {
+            os << "," << cmd.cmd_name;
+            continue;
+        }
+        for(unsigned i = 0; i < cmd.num_values; i++)
+        {
+            os << "," << cmd.cmd_name << "[" << i << "]";
+        }
+    }
+    os << "\n";
+}
+
+size_t format_watch_csv_record(char * line, size_t line_size, const uint8_t * record, const vector<cmd_t> & cmds)
+{
+    uint64_t time_ns;
+    uint32_t seq;
+    memcpy(&time_ns, record, sizeof(time_ns));
+    memcpy(&seq, record + sizeof(time_ns), sizeof(seq));
+    size_t len = snprintf(line, line_size, "%llu,%u", static_cast<unsigned long long>(time_ns / 1000), seq);
+
+    const uint8_t * data = record + WATCH_RECORD_HEADER_SIZE;
+    for(const cmd_t & cmd : cmds)
+    {
+        if(cmd.type == TYPE_CHAR)
+        {
+            len += snprintf(line + len, line_size - len, ",\"%.*s\"", static_cast<int>(strnlen(reinterpret_cast<const char *>(data), cmd.num_values)), data);
+        }
+        for(unsigned i = 0; (i < cmd.num_values) && (cmd.type != TYPE_CHAR); i++)
+        {
+            const cmd_param_t value = command_param_from_bytes(cmd.type, data, i);
+            switch(cmd.type)
+            {
+            case TYPE_UINT8:
+                len += snprintf(line + len, line_size - len, ",%u", value.ui8);
+                break;
+            case TYPE_INT32:
+                len += snprintf(line + len, line_size - len, ",%d", value.i32);
+                break;
+            case TYPE_UINT32:
+                len += snprintf(line + len, line_size - len, ",%u", value.ui32);
+                break;
+            default:
+                len += snprintf(line + len, line_size - len, ",%.9g", value.f);
+                break;
+            }
+        }
+        data += command_param_type_size(cmd.type) * cmd.num_values;
+    }
+    len += snprintf(line + len, line_size - len, "\n");
+    return len;
+}
+
+control_ret_t watch_params(Command * command, const string cmd_names, const watch_config_t & config, const string filename)
+{
+    vector<cmd_t> cmds;
+    stringstream ss(cmd_names);
+    string name;
+    size_t max_cmd_len = 0;
+    while(getline(ss, name, ','))
+    {
+        if(name.empty())
+        {
+            continue;
+        }
+        cmd_t cmd;
+        init_cmd(&cmd, name);
+        if(cmd.rw == CMD_WO)
+        {
+            cerr << "Command " << cmd.cmd_name << " is write only and can't be watched" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        max_cmd_len = max(max_cmd_len, command_param_type_size(cmd.type) * cmd.num_values);
+        cmds.push_back(cmd);
+    }
+    if(cmds.empty())
+    {
+        cerr << "No commands provided after the --watch option" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    if(config.interval_us == 0)
+    {
+        cerr << "The --interval must be at least 1 us" << endl;
+        exit(HOST_APP_ERROR);
+    }
+    const size_t record_size = get_watch_record_size(cmds);
+
+    ofstream file;
+    unique_ptr<CaptureWriter> capture;
+    if(config.format == WATCH_FORMAT_CAPTURE)
+    {
+        if(filename.empty() || (config.capture_records == 0))
+        {
+            cerr << "A capture needs a file name and at least one record" << endl;
+            exit(HOST_APP_ERROR);
+        }
+        capture.reset(new CaptureWriter(filename, cmds, config.capture_records, config.interval_us));
+    }
+    else if(!filename.empty())
+    {
+        file.open(filename, ios::out | ios::binary | ios::trunc);
+        if(!file)
+        {
+            cerr << "Could not open a file " << filename << endl;
+            exit(HOST_APP_ERROR);
+        }
+    }
+    ostream & os = (filename.empty()) ? cout : file;
+    if(config.format == WATCH_FORMAT_BINARY)
+    {
+        write_binary_header(os, cmds, config, static_cast<uint32_t>(record_size));
+    }
+    else if(config.format == WATCH_FORMAT_CSV)
+    {
+        write_watch_csv_header(os, cmds);
+    }
+
+    SpscRing ring(WATCH_RING_SAMPLES, record_size);
+    atomic<bool> sampler_done(false);
+    size_t num_ticks = 0;
+    size_t num_sampled = 0;
+    size_t num_missed = 0;
+    size_t num_ring_full = 0;
+    uint64_t last_time_ns = 0;
+    exception_ptr sample_error = nullptr;
+
+    watch_stop = false;
+    signal(SIGINT, watch_signal_handler);
+
+    // The sampler thread owns the device, it never waits for the writer
+    thread sampler([&]()
+    {
+        vector<uint8_t> data(max_cmd_len + 1); // one extra for the status
+        const watch_clock_t::duration interval = chrono::microseconds(config.interval_us);
+        const watch_clock_t::time_point start = watch_clock_t::now();
+        uint64_t tick = 0;
+        while(!watch_stop && ((config.num_samples == 0) || (tick < config.num_samples)))
+        {
+            this_thread::sleep_until(start + tick * interval);
+            const uint64_t time_ns = chrono::duration_cast<chrono::nanoseconds>(watch_clock_t::now() - start).count();
+            uint8_t * record = ring.claim();
+            if(record == nullptr)
+            {
+                num_ring_full++;
+            }
+            else
+            {
+                const uint32_t seq = static_cast<uint32_t>(tick);
+                memcpy(record, &time_ns, sizeof(time_ns));
+                memcpy(record + sizeof(time_ns), &seq, sizeof(seq));
+                uint8_t * values = record + WATCH_RECORD_HEADER_SIZE;
+                try
+                {
+                    for(const cmd_t & cmd : cmds)
+                    {
+                        const size_t cmd_len = command_param_type_size(cmd.type) * cmd.num_values;
+                        // Each sample must come from the device, not from the shadow cache
+                        command->invalidate_cache(&cmd);
+                        command->command_get_bytes(&cmd, data.data(), cmd_len + 1);
+                        memcpy(values, &data[1], cmd_len);
+                        values += cmd_len;
+                    }
+                }
+                catch(...)
+                {
+                    // The sampling stops, the samples already in the ring are written and the error is rethrown once both threads have been joined
+                    sample_error = current_exception();
+                    break;
+                }
+                ring.publish();
+                num_sampled++;
+                last_time_ns = time_ns;
+            }
+            tick++;
+
+            // Ticks whose deadline has passed by more than an interval are skipped, not sampled in a burst
+            const uint64_t due = (watch_clock_t::now() - start) / interval;
+            if(due > tick)
+            {
+                if(config.num_samples != 0)
+                {
+                    num_missed += min<uint64_t>(due, config.num_samples) - min<uint64_t>(tick, config.num_samples);
+                }
+                else
+                {
+                    num_missed += due - tick;
+                }
+                tick = due;
+            }
+        }
+        num_ticks = (config.num_samples == 0) ? tick : min<uint64_t>(tick, config.num_samples);
+        sampler_done.store(true, memory_order_release);
+    });
+
+    thread writer([&]()
+    {
+        vector<char> line(get_watch_csv_line_size(cmds));
+        while(true)
+        {
+            const uint8_t * record = ring.peek();
+            if(record == nullptr)
+            {
+                if(sampler_done.load(memory_order_acquire))
+                {
+                    // Check again, the last samples may have been published just before the sampler finished
+                    if(ring.peek() == nullptr)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                this_thread::sleep_for(chrono::milliseconds(1));
+                continue;
+            }
+            if(config.format == WATCH_FORMAT_CAPTURE)
+            {
+                capture->append(record);
+            }
+            else if(config.format == WATCH_FORMAT_BINARY)
+            {
+                os.write(reinterpret_cast<const char *>(record), record_size);
+            }
+            else
+            {
+                os.write(line.data(), format_watch_csv_record(line.data(), line.size(), record, cmds));
+            }
+            ring.release();
+        }
+        os.flush();
+    });
+
+    sampler.join();
+    writer.join();
+    signal(SIGINT, SIG_DFL);
+    if(sample_error != nullptr)
+    {
+        rethrow_exception(sample_error);
+    }
+
+    const double requested_rate = 1e6 / config.interval_us;
+    const double achieved_rate = (num_sampled > 1) ? (num_sampled - 1) * 1e9 / last_time_ns : 0.0;
+    // The report goes to stderr when the samples are written to stdout
+    ostream & report = (filename.empty()) ? cerr : cout;
+    report << "Sampled " << num_sampled << " of " << num_ticks << " ticks, requested rate " << requested_rate
+    << " Hz, achieved rate " << achieved_rate << " Hz, " << num_missed + num_ring_full << " samples dropped ("
+    << num_missed << " missed deadlines, " << num_ring_full << " with the ring full)" << endl;
+
+    if(!os.good())
+    {
+        cerr << "Error occurred when writing the samples" << endl;
+        return CONTROL_ERROR;
+    }
+    return CONTROL_SUCCESS;
+}
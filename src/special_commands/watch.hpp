@@ -0,0 +1,131 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef WATCH_H_
+#define WATCH_H_
+
+#include "command.hpp"
+#include <vector>
+
+/** @brief Magic number at the start of a binary watch stream, "XVFW" */
+#define WATCH_STREAM_MAGIC 0x57465658
+
+/** @brief Version of the binary watch stream format */
+#define WATCH_STREAM_VERSION 1
+
+/** @brief Number of samples the ring between the sampler and the writer can hold */
+#define WATCH_RING_SAMPLES 4096
+
+/** @brief Size of the time and the sequence number at the start of each record */
+#define WATCH_RECORD_HEADER_SIZE 12
+
+/** @brief Default number of records of a capture file */
+#define WATCH_CAPTURE_RECORDS 1000000
+
+/** @brief Enum for the output formats of the watched samples */
+enum watch_format_t {WATCH_FORMAT_CSV, WATCH_FORMAT_BINARY, WATCH_FORMAT_CAPTURE};
+
+/** @brief Watch configuration structure */
+struct watch_config_t
+{
+    /** Time between two samples, in microseconds */
+    unsigned interval_us;
+    /** Number of samples to take, 0 to sample until interrupted */
+    size_t num_samples;
+    /** Output format */
+    watch_format_t format;
+    /** Number of records of the capture file, used with WATCH_FORMAT_CAPTURE */
+    size_t capture_records;
+};
+
+/** @brief Header of a binary watch stream, followed by the command descriptors and the records */
+struct watch_stream_header_t
+{
+    /** WATCH_STREAM_MAGIC */
+    uint32_t magic;
+    /** WATCH_STREAM_VERSION */
+    uint16_t version;
+    /** Number of command descriptors */
+    uint16_t num_cmds;
+    /** Requested time between two samples, in microseconds */
+    uint32_t interval_us;
+    /** Size of each record, including the time and the sequence number */
+    uint32_t record_size;
+};
+
+/**
+ * @brief Sample a set of commands at a fixed rate
+ *
+ * A sampler thread reads all the commands on every tick, scheduled on the monotonic clock,
+ * and pushes the samples through a lock free ring to a writer thread.
+ * A tick which is missed because the reads took too long is not made up for.
+ * The achieved rate and the number of dropped samples are reported at the end.
+ *
+ * Each binary record holds the time since the first sample in nanoseconds (8 bytes),
+ * the sequence number (4 bytes) and the encoded values of all the commands, in order.
+ *
+ * With WATCH_FORMAT_CAPTURE the records are written into a ring capture file, see CaptureWriter.
+ *
+ * @param command       Pointer to the Command class object
+ * @param cmd_names     Comma separated list of commands to sample
+ * @param config        Sampling interval, number of samples and format
+ * @param filename      File name to write to, empty to write to stdout
+ * @note Sampling stops after config.num_samples samples or on SIGINT
+ */
+control_ret_t watch_params(Command * command, const std::string cmd_names, const watch_config_t & config, const std::string filename = "");
+
+/**
+ * @brief Encode the name, type and number of values of each command
+ *
+ * Each descriptor is the name length (1 byte), the name, the type (1 byte) and the number of values (2 bytes).
+ *
+ * @param cmds          Commands to describe
+ * @return              Encoded descriptors
+ */
+std::vector<uint8_t> encode_watch_descriptors(const std::vector<cmd_t> & cmds);
+
+/**
+ * @brief Decode the descriptors written by encode_watch_descriptors()
+ *
+ * @param data          Encoded descriptors
+ * @param data_len      Number of bytes available
+ * @param num_cmds      Number of descriptors to decode
+ * @param cmds          Decoded commands, only the name, type and number of values are set
+ * @return              Number of bytes used, 0 if the descriptors are not valid
+ */
+size_t decode_watch_descriptors(const uint8_t * data, size_t data_len, unsigned num_cmds, std::vector<cmd_t> & cmds);
+
+/**
+ * @brief Get the size of the records for a list of commands
+ *
+ * @param cmds          Commands in each record
+ */
+size_t get_watch_record_size(const std::vector<cmd_t> & cmds);
+
+/**
+ * @brief Write the CSV column names, one column per value
+ *
+ * @param os            Stream to write to
+ * @param cmds          Commands in each record
+ */
+void write_watch_csv_header(std::ostream & os, const std::vector<cmd_t> & cmds);
+
+/**
+ * @brief Get the size of the buffer needed by format_watch_csv_record()
+ *
+ * @param cmds          Commands in each record
+ */
+size_t get_watch_csv_line_size(const std::vector<cmd_t> & cmds);
+
+/**
+ * @brief Format a record as a CSV line
+ *
+ * @param line          Buffer to write to
+ * @param line_size     Size of the buffer, see get_watch_csv_line_size()
+ * @param record        Record to format
+ * @param cmds          Commands in each record
+ * @return              Number of characters written to the buffer
+ */
+size_t format_watch_csv_record(char * line, size_t line_size, const uint8_t * record, const std::vector<cmd_t> & cmds);
+
+#endif
@@ -0,0 +1,180 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+/**
+ * @file xvf_param_table.h
+ * @brief Reader side of the shared memory parameter table published by xvf_host --publish
+ *
+ * The table is a POSIX shared memory segment holding the latest value of each published
+ * command. Each entry is protected by a sequence lock: the publisher makes the sequence odd
+ * while it updates the entry, so a reader retries if the sequence was odd or has changed
+ * while it copied the values. Reading never takes a lock nor makes a system call.
+ *
+ * This header can be used from C and C++, it needs GCC or Clang atomic builtins.
+ */
+
+#ifndef XVF_PARAM_TABLE_H_
+#define XVF_PARAM_TABLE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Magic number at the start of the table, "XVFT" */
+#define XVF_PARAM_TABLE_MAGIC 0x54465658
+
+/** @brief Version of the table layout */
+#define XVF_PARAM_TABLE_VERSION 1
+
+/** @brief Default shared memory object name */
+#define XVF_PARAM_TABLE_DEFAULT_NAME "/xvf_params"
+
+/** @brief Size of the command name field of an entry, including the null terminator */
+#define XVF_PARAM_NAME_SIZE 48
+
+/** @brief Header at the start of the table, followed by num_entries entries of entry_size bytes */
+typedef struct
+{
+    /** XVF_PARAM_TABLE_MAGIC, set once all the entries are described */
+    uint32_t magic;
+    /** XVF_PARAM_TABLE_VERSION */
+    uint16_t version;
+    /** Number of entries */
+    uint16_t num_entries;
+    /** Size of each entry, including its values */
+    uint32_t entry_size;
+    /** Time between two updates of the table, in microseconds */
+    uint32_t interval_us;
+    /** Process ID of the publisher */
+    uint64_t publisher_pid;
+} xvf_param_table_header_t;
+
+/** @brief Entry of the table, followed by the encoded values */
+typedef struct
+{
+    /** Command name, null terminated */
+    char name[XVF_PARAM_NAME_SIZE];
+    /** Value type, same as cmd_param_type_t: 0 char, 1 uint8, 2 int32, 3 float, 4 uint32, 5 radians */
+    uint8_t type;
+    /** Reserved, set to 0 */
+    uint8_t reserved;
+    /** Number of values */
+    uint16_t num_values;
+    /** Size of the encoded values in bytes */
+    uint32_t data_len;
+    /** Sequence lock, odd while the entry is being updated */
+    uint32_t seq;
+    /** Number of times the values have been read from the device */
+    uint32_t num_updates;
+    /** CLOCK_MONOTONIC time of the latest read from the device, in nanoseconds */
+    uint64_t timestamp_ns;
+} xvf_param_entry_t;
+
+/**
+ * @brief Map the parameter table
+ *
+ * @param name          Shared memory object name, XVF_PARAM_TABLE_DEFAULT_NAME by default
+ * @param size          Set to the size of the mapping, to unmap it with munmap()
+ * @return              Pointer to the table header, NULL if there is no valid table
+ */
+static inline const xvf_param_table_header_t * xvf_param_table_open(const char * name, size_t * size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    if((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(xvf_param_table_header_t)))
+    {
+        close(fd);
+        return NULL;
+    }
+    void * addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        return NULL;
+    }
+    const xvf_param_table_header_t * header = (const xvf_param_table_header_t *)addr;
+    if((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != XVF_PARAM_TABLE_MAGIC) ||
+       (header->version != XVF_PARAM_TABLE_VERSION) ||
+       (sizeof(*header) + (size_t)header->num_entries * header->entry_size > (size_t)st.st_size))
+    {
+        munmap(addr, st.st_size);
+        return NULL;
+    }
+    *size = st.st_size;
+    return header;
+}
+
+/**
+ * @brief Find the entry of a command
+ *
+ * @param header        Table returned by xvf_param_table_open()
+ * @param cmd_name      Command name, in upper case
+ * @return              Pointer to the entry, NULL if the command is not published
+ */
+static inline const xvf_param_entry_t * xvf_param_table_find(const xvf_param_table_header_t * header, const char * cmd_name)
+{
+    const uint8_t * entries = (const uint8_t *)(header + 1);
+    for(unsigned i = 0; i < header->num_entries; i++)
+    {
+        const xvf_param_entry_t * entry = (const xvf_param_entry_t *)(entries + (size_t)i * header->entry_size);
+        if(strncmp(entry->name, cmd_name, XVF_PARAM_NAME_SIZE) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copy the latest values of an entry
+ *
+ * @param entry         Entry returned by xvf_param_table_find()
+ * @param values        Buffer to copy the encoded values to, little endian as sent by the device
+ * @param values_size   Size of the buffer, at least entry->data_len
+ * @param timestamp_ns  Set to the CLOCK_MONOTONIC time of the values, can be NULL
+ * @return              Number of updates of the values copied, 0 if there are no values yet or the buffer is too small
+ */
+static inline uint32_t xvf_param_table_read(const xvf_param_entry_t * entry, void * values, size_t values_size, uint64_t * timestamp_ns)
+{
+    if(values_size < entry->data_len)
+    {
+        return 0;
+    }
+    for(;;)
+    {
+        uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if(seq & 1)
+        {
+            continue;
+        }
+        memcpy(values, entry + 1, entry->data_len);
+        uint64_t timestamp = entry->timestamp_ns;
+        uint32_t num_updates = entry->num_updates;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == seq)
+        {
+            if(timestamp_ns != NULL)
+            {
+                *timestamp_ns = timestamp;
+            }
+            return num_updates;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
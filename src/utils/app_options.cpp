@@ -0,0 +1,107 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "app_options.hpp"
+#include <iostream>
+
+using namespace std;
+
+// The option parsing prints its hints and exits, so it is only built into the applications,
+// not into xvf_control_objects
+
+size_t argv_option_lookup(int argc, char ** argv, opt_t * opt_lookup)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        string cmd_arg = to_lower(argv[i]);
+        if((cmd_arg == opt_lookup->long_name) || (cmd_arg == opt_lookup->short_name))
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void remove_opt(int * argc, char ** argv, size_t ind, size_t num)
+{
+    for(size_t i = 0; i < * argc - ind - num; i++)
+    {
+        argv[ind + i] = argv[ind + num + i];
+    }
+    * argc -= num;
+    if(* argc == 1)
+    {
+        cout << "Use --help to get the list of options for this application." << endl
+        << "Or use --list-commands to print the list of commands and their info." << endl;
+        exit(0);
+    }
+}
+
+string get_device_lib_name(int * argc, char ** argv, opt_t* options, const size_t num_options)
+{
+    string lib_name = default_driver_name;
+    opt_t * use_opt = option_lookup("--use", options, num_options);
+    size_t index = argv_option_lookup(*argc, argv, use_opt);
+    if(index == 0)
+    {
+        // could not find --use, using default driver name
+        return lib_name;
+    }
+    else
+    {
+        string protocol_name = argv[index + 1];
+        if (to_upper(protocol_name) == "I2C")
+        {
+            lib_name = device_i2c_dl_name;
+        }
+        else if (to_upper(protocol_name) == "SPI")
+        {
+            lib_name = device_spi_dl_name;
+        }
+        else if (to_upper(protocol_name) == "USB")
+        {
+            lib_name = device_usb_dl_name;
+        }
+        else
+        {
+            // Using default driver
+            cout << "Could not find " << to_upper(protocol_name) << " in supported protocols"
+            << endl << "Will use default driver: " << default_driver_name << endl;
+        }
+        remove_opt(argc, argv, index, 2);
+        return lib_name;
+    }
+}
+
+opt_t * option_lookup(const string str, opt_t* options, const size_t num_options)
+{
+    string low_str = to_lower(str);
+    for(size_t i = 0; i < num_options; i++)
+    {
+        opt_t * opt = &options[i];
+        if ((low_str == opt->long_name) || (low_str == opt->short_name))
+        {
+            return opt;
+        }
+    }
+
+    int shortest_dist = 100;
+    int indx  = 0;
+    for(size_t i = 0; i < num_options; i++)
+    {
+        opt_t * opt = &options[i];
+        int dist_long = Levenshtein_distance(low_str, opt->long_name);
+        int dist_short = Levenshtein_distance(low_str, opt->short_name);
+        int dist = (dist_short < dist_long) ? dist_short : dist_long;
+        if(dist < shortest_dist)
+        {
+            shortest_dist = dist;
+            indx = i;
+        }
+    }
+    cerr << "Option " << str << " does not exist." << endl
+    << "Maybe you meant " << options[indx].short_name
+    << " or " << options[indx].long_name << "." << endl;
+    exit(HOST_APP_ERROR);
+    return nullptr;
+}
@@ -0,0 +1,29 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef APP_OPTIONS_H_
+#define APP_OPTIONS_H_
+
+#include "utils.hpp"
+
+/** @brief Lookup option in argv */
+size_t argv_option_lookup(int argc, char ** argv, opt_t * opt_lookup);
+
+/**
+ * @brief Remove words from argv, decrement argc
+ *
+ * @note If no argument is left, will print how to get help and exit.
+ */
+void remove_opt(int * argc, char ** argv, size_t ind, size_t num);
+
+/** @brief Get device driver name to load by looking for --use
+ * @note Will decrement argc, if option is present
+ */
+std::string get_device_lib_name(int * argc, char ** argv, opt_t* options, const size_t num_options);
+
+/** @brief Look up the string in the option list.
+ * @note If the string is not found, will suggest a possible match and exit.
+ * @note Function is case insensitive
+ */
+opt_t * option_lookup(const std::string str, opt_t* options, const size_t num_options);
+#endif
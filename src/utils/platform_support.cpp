@@ -27,14 +27,19 @@
 
 using namespace std;
 
+/** @brief Libraries linked into the application, see register_static_libs() */
+static const static_lib_t * static_libs = nullptr;
+
+/** @brief Number of libraries linked into the application */
+static size_t num_static_libs = 0;
+
 string convert_to_abs_path(const string rel_path)
 {
 
     string dir_path_str;
     char path[PATH_MAX];
     if (getcwd(path, sizeof(path)) == NULL) {
-        cerr << "Could not find current working directory path " << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Could not find current working directory path ");
     }
     dir_path_str = path;
 #if defined(_WIN32)
@@ -54,8 +59,7 @@ string get_executable_path()
     ssize_t count = readlink("/proc/self/exe", path, PATH_MAX);
     if (count == -1)
     {
-        cerr << "Could not read /proc/self/exe into " << PATH_MAX << " string" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Could not read /proc/self/exe into " + to_string(PATH_MAX) + " string");
     }
     path[count] = '\0'; // readlink doesn't always add NULL for some reason
 
@@ -64,15 +68,13 @@ string get_executable_path()
     uint32_t size = PATH_MAX;
     if (_NSGetExecutablePath(path, &size) != 0)
     {
-        cerr << "Could not get binary path into " << PATH_MAX << " string" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Could not get binary path into " + to_string(PATH_MAX) + " string");
     }
 #elif defined(_WIN32)
     char path[MAX_PATH];
     if(0 == GetModuleFileNameA(GetModuleHandle(NULL), path, MAX_PATH))
     {
-        cerr << "Could not get binary path into " << MAX_PATH << " string" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Could not get binary path into " + to_string(MAX_PATH) + " string");
     }
 #endif // linux vs apple vs windows
     string path_str = path;
@@ -81,9 +83,9 @@ string get_executable_path()
     return path_str;
 }
 
-string get_dynamic_lib_path(const string lib_name)
+string get_dynamic_lib_path(const string lib_name, const string lib_dir)
 {
-    string exe_path = get_executable_path();
+    string exe_path = (lib_dir.empty()) ? get_executable_path() : lib_dir;
 #if defined(__linux__)
     string full_lib_name = "lib" + lib_name;
     char * dir_path;
@@ -104,8 +106,65 @@ string get_dynamic_lib_path(const string lib_name)
     return lib_path_str;
 }
 
+void register_static_libs(const static_lib_t * libs, size_t num_libs)
+{
+    static_libs = libs;
+    num_static_libs = num_libs;
+}
+
+/** @brief Get the handle standing for a library linked into the application */
+static dl_handle_t get_static_lib_handle(const static_lib_t * lib)
+{
+    return reinterpret_cast<dl_handle_t>(const_cast<static_lib_t *>(lib));
+}
+
+/** @brief Get the library linked into the application from its handle, nullptr if the library has been loaded */
+static const static_lib_t * get_static_lib(dl_handle_t handle)
+{
+    for(size_t i = 0; i < num_static_libs; i++)
+    {
+        if(handle == get_static_lib_handle(&static_libs[i]))
+        {
+            return &static_libs[i];
+        }
+    }
+    return nullptr;
+}
+
+/** @brief Look a function up in a library linked into the application, nullptr if the library does not have it */
+static void (* find_static_function(const static_lib_t * lib, const string symbol))()
+{
+    for(size_t i = 0; i < lib->num_symbols; i++)
+    {
+        if(symbol == lib->symbols[i].name)
+        {
+            return lib->symbols[i].func;
+        }
+    }
+    return nullptr;
+}
+
+/** @brief Look a function up in a library linked into the application */
+static void (* get_static_function(const static_lib_t * lib, const string symbol))()
+{
+    void (* func)() = find_static_function(lib, symbol);
+    if(func == nullptr)
+    {
+        throw host_app_error("Could not find " + symbol + " function in " + lib->name + " built into the application");
+    }
+    return func;
+}
+
 dl_handle_t get_dynamic_lib(const string lib_path)
 {
+    for(size_t i = 0; i < num_static_libs; i++)
+    {
+        if(lib_path == get_dynamic_lib_path(static_libs[i].name))
+        {
+            return get_static_lib_handle(&static_libs[i]);
+        }
+    }
+
 #if (defined(__linux__) || defined(__APPLE__))
     static_cast<void>(dlerror()); // clear errors
     dl_handle_t handle = dlopen(lib_path.c_str(), RTLD_NOW);
@@ -117,20 +176,45 @@ dl_handle_t get_dynamic_lib(const string lib_path)
     if(handle == NULL)
     {
 #if (defined(__linux__) || defined(__APPLE__))
-        cerr << dlerror() << endl;
+        throw host_app_error(dlerror());
 #elif defined(_WIN32)
-        cerr << "Could not load " << lib_path << ", got " << GetLastError() << " error code" << endl;
+        throw host_app_error("Could not load " + lib_path + ", got " + to_string(GetLastError()) + " error code");
 #else
 #error "Unknown Operating System"
 #endif // unix vs windows
-        exit(HOST_APP_ERROR);
     }
     return handle;
 }
 
+/** @brief Look up a function the library may not have, nullptr if it does not */
+template<typename T>
+T find_function(dl_handle_t handle, const string symbol)
+{
+    const static_lib_t * static_lib = get_static_lib(handle);
+    if(static_lib != nullptr)
+    {
+        return reinterpret_cast<T>(find_static_function(static_lib, symbol));
+    }
+
+#if (defined(__linux__) || defined(__APPLE__))
+    static_cast<void>(dlerror()); // clear errors
+    return reinterpret_cast<T>(dlsym(handle, symbol.c_str()));
+#elif defined(_WIN32)
+    return reinterpret_cast<T>(GetProcAddress(handle, symbol.c_str()));
+#else
+#error "Unsupported operating system"
+#endif // unix vs windows
+}
+
 template<typename T>
 T get_function(dl_handle_t handle, const string symbol)
 {
+    const static_lib_t * static_lib = get_static_lib(handle);
+    if(static_lib != nullptr)
+    {
+        return reinterpret_cast<T>(get_static_function(static_lib, symbol));
+    }
+
 #if (defined(__linux__) || defined(__APPLE__))
     static_cast<void>(dlerror()); // clear errors
     T func = reinterpret_cast<T>(dlsym(handle, symbol.c_str()));
@@ -142,13 +226,12 @@ T get_function(dl_handle_t handle, const string symbol)
     if(func == NULL)
     {
 #if (defined(__linux__) || defined(__APPLE__))
-        cerr << dlerror() << endl;
+        throw host_app_error(dlerror());
 #elif defined(_WIN32)
-        cerr << "Could not load " << symbol << " function, got " << GetLastError() << "error code" << endl;
+        throw host_app_error("Could not load " + symbol + " function, got " + to_string(GetLastError()) + "error code");
 #else
 #error "Unknown Operating System"
 #endif // unix vs windows
-        exit(HOST_APP_ERROR);
     }
     return func;
 }
@@ -208,6 +291,11 @@ check_range_fptr get_check_range_fptr(dl_handle_t handle)
     return get_function<check_range_fptr>(handle, "check_range");
 }
 
+range_error_fptr get_range_error_fptr(dl_handle_t handle)
+{
+    return find_function<range_error_fptr>(handle, "get_range_error");
+}
+
 size_t get_term_width()
 {
 #if (defined(__linux__) || defined(__APPLE__))
@@ -0,0 +1,96 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Lock free ring of fixed size byte slots, for one producer thread and one consumer thread
+ *
+ * The producer claims a slot, fills it and publishes it. The consumer peeks at the oldest
+ * published slot and releases it once it has been used. Neither side ever blocks.
+ */
+class SpscRing
+{
+    private:
+
+        /** @brief Storage for all the slots */
+        std::vector<uint8_t> slots;
+
+        /** @brief Size of a single slot in bytes */
+        size_t slot_size;
+
+        /** @brief Number of slots, a power of two */
+        size_t num_slots;
+
+        /** @brief Number of slots published so far, only written by the producer */
+        alignas(64) std::atomic<size_t> head;
+
+        /** @brief Number of slots released so far, only written by the consumer */
+        alignas(64) std::atomic<size_t> tail;
+
+    public:
+
+        /**
+         * @brief Construct a new SpscRing object
+         *
+         * @param _num_slots    Minimum number of slots, rounded up to a power of two
+         * @param _slot_size    Size of a single slot in bytes
+         */
+        SpscRing(size_t _num_slots, size_t _slot_size) : slot_size(_slot_size), num_slots(1), head(0), tail(0)
+        {
+            while(num_slots < _num_slots)
+            {
+                num_slots <<= 1;
+            }
+            slots.resize(num_slots * slot_size);
+        }
+
+        /**
+         * @brief Get the next free slot, producer side
+         *
+         * @return              Pointer to the slot, nullptr if the ring is full
+         */
+        uint8_t * claim()
+        {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == num_slots)
+            {
+                return nullptr;
+            }
+            return &slots[(h & (num_slots - 1)) * slot_size];
+        }
+
+        /** @brief Make the slot returned by claim() visible to the consumer */
+        void publish()
+        {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Get the oldest published slot, consumer side
+         *
+         * @return              Pointer to the slot, nullptr if the ring is empty
+         */
+        const uint8_t * peek() const
+        {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &slots[(t & (num_slots - 1)) * slot_size];
+        }
+
+        /** @brief Give the slot returned by peek() back to the producer */
+        void release()
+        {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+};
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+#include "utils.hpp"
+#include <iterator>
+
+// Registers the device driver and the command map linked into the application, see add_static_host_app()
+// in host_application.cmake. STATIC_DRIVER_NAME is the name of the driver, such as device_usb.
+// The command map gives the information of every driver, so the drivers which are not built in
+// can still be loaded at run time.
+
+#if !defined(STATIC_DRIVER_NAME)
+#error "STATIC_DRIVER_NAME must be defined"
+#endif
+
+#if defined(_MSC_VER)
+// MSVC has no weak symbols, so the command map must define all the optional functions
+#define STATIC_OPTIONAL
+#else
+// A command map without an optional function still links, the function is then null and reported missing when looked up
+#define STATIC_OPTIONAL __attribute__((weak))
+#endif
+
+#define STATIC_SYMBOL_STR(symbol) #symbol
+#define STATIC_SYMBOL(symbol) {STATIC_SYMBOL_STR(symbol), reinterpret_cast<void (*)()>(symbol)}
+
+extern "C"
+{
+    uint32_t get_num_commands();
+    size_t get_cmd_index(const std::string cmd_name);
+    std::string get_cmd_name(const size_t index);
+    void get_cmd_id_info(control_resid_t * res_id, control_cmd_t * cmd_id, const size_t index);
+    void get_cmd_val_info(cmd_param_type_t * type, cmd_rw_t * rw, unsigned * num_vals, const size_t index);
+    std::string get_cmd_info(const size_t index);
+    bool get_cmd_hidden(const size_t index);
+    STATIC_OPTIONAL int * get_info_i2c();
+    STATIC_OPTIONAL int * get_info_spi();
+    STATIC_OPTIONAL int * get_info_usb();
+    void super_print_arg(const std::string cmd_name, cmd_param_t * values);
+    void check_range(const std::string cmd_name, const cmd_param_t * vals);
+    STATIC_OPTIONAL std::string get_range_error(const std::string cmd_name, const cmd_param_t * vals);
+    Device * make_Dev(int * info);
+}
+
+/** @brief Functions of the command map, as looked up by the get_*_fptr functions */
+static const static_symbol_t command_map_symbols[] = {
+    STATIC_SYMBOL(get_num_commands),
+    STATIC_SYMBOL(get_cmd_index),
+    STATIC_SYMBOL(get_cmd_name),
+    STATIC_SYMBOL(get_cmd_id_info),
+    STATIC_SYMBOL(get_cmd_val_info),
+    STATIC_SYMBOL(get_cmd_info),
+    STATIC_SYMBOL(get_cmd_hidden),
+    STATIC_SYMBOL(get_info_i2c),
+    STATIC_SYMBOL(get_info_spi),
+    STATIC_SYMBOL(get_info_usb),
+    STATIC_SYMBOL(super_print_arg),
+    STATIC_SYMBOL(check_range),
+    STATIC_SYMBOL(get_range_error),
+};
+
+/** @brief Functions of the device driver */
+static const static_symbol_t device_symbols[] = {
+    STATIC_SYMBOL(make_Dev),
+};
+
+/** @brief Libraries linked into the application */
+static const static_lib_t built_in_libs[] = {
+    {default_command_map_name.c_str(), command_map_symbols, std::end(command_map_symbols) - std::begin(command_map_symbols)},
+    {STATIC_DRIVER_NAME, device_symbols, std::end(device_symbols) - std::begin(device_symbols)},
+};
+
+/** @brief Register the libraries before main() runs */
+static const bool is_registered = (register_static_libs(built_in_libs, std::end(built_in_libs) - std::begin(built_in_libs)), true);
@@ -2,21 +2,70 @@
 // This Software is subject to the terms of the XCORE VocalFusion Licence.
 
 #include "utils.hpp"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
 #include <vector>
 #include <iostream>
 #include "control_ret_str_map.h"
 
 using namespace std;
 
-static cmd_index_fptr get_cmd_index = nullptr;
-static cmd_name_fptr get_cmd_name = nullptr;
-static cmd_id_info_fptr get_cmd_id_info = nullptr;
-static cmd_val_info_fptr get_cmd_val_info = nullptr;
-static cmd_info_fptr get_cmd_info = nullptr;
-static cmd_hidden_fptr get_cmd_hidden = nullptr;
+// The command_map functions are resolved the first time they are used,
+// as most runs of the application only look a single command up.
+// A process uses a single command_map, set by the first load_command_map_dll() call and never changed,
+// so the threads using the handles of the library can resolve the functions while another handle is opened.
+static atomic<dl_handle_t> loaded_cmd_map(nullptr);
+
+/** @brief Serialises load_command_map_dll(), which sets loaded_cmd_map and num_commands once */
+static mutex load_cmd_map_mutex;
+static atomic<cmd_index_fptr> get_cmd_index(nullptr);
+static atomic<cmd_name_fptr> get_cmd_name(nullptr);
+static atomic<cmd_id_info_fptr> get_cmd_id_info(nullptr);
+static atomic<cmd_val_info_fptr> get_cmd_val_info(nullptr);
+static atomic<cmd_info_fptr> get_cmd_info(nullptr);
+static atomic<cmd_hidden_fptr> get_cmd_hidden(nullptr);
+static atomic<range_error_fptr> get_range_error(nullptr);
+static atomic<check_range_fptr> check_range(nullptr);
 
 size_t num_commands = 0;
 
+using profile_clock_t = std::chrono::steady_clock;
+
+/**
+ * @brief Time when the static objects of the application are initialised
+ *
+ * This is the closest point to the process start which is available on every platform,
+ * it only misses the time spent by the dynamic loader on the libraries linked at build time.
+ */
+static const profile_clock_t::time_point process_start_time = profile_clock_t::now();
+
+/** @brief Startup steps recorded since enable_startup_profile(), with the time each of them ended */
+static vector<pair<string, profile_clock_t::time_point>> startup_steps;
+
+/** @brief Set by enable_startup_profile() */
+static bool is_startup_profiled = false;
+
+/**
+ * @brief Get a function of the command_map, resolving it the first time
+ *
+ * @param fptr      Function pointer, nullptr until it is resolved
+ * @param resolve   Function getting the function pointer from the command_map, such as get_cmd_index_fptr()
+ */
+template<typename T>
+static T cmd_map_function(atomic<T> & fptr, T (*resolve)(dl_handle_t))
+{
+    T func = fptr.load(memory_order_acquire);
+    if(func == nullptr)
+    {
+        // Several threads can resolve the same function, they all get the same pointer
+        func = resolve(loaded_cmd_map.load(memory_order_acquire));
+        fptr.store(func, memory_order_release);
+    }
+    return func;
+}
+
 string to_upper(string str)
 {
     for(unsigned i = 0; i < str.length(); i++)
@@ -52,35 +101,51 @@ int * get_device_init_info(dl_handle_t handle, string lib_name)
     }
     else
     {
-        cerr << "Not a valid device dl name " << lib_name << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Not a valid device dl name " + lib_name);
     }
     device_info_fptr get_device_info = get_device_info_fptr(handle, symbol);
 
     return get_device_info();
 }
 
+Device * load_device(dl_handle_t cmd_map_handle, const string lib_name, const string lib_dir)
+{
+    string device_dl_path = get_dynamic_lib_path(lib_name, lib_dir);
+    dl_handle_t device_handle = get_dynamic_lib(device_dl_path);
+    startup_profile_mark("Device driver open");
+    int * device_init_info = get_device_init_info(cmd_map_handle, lib_name);
+    device_fptr make_dev = get_device_fptr(device_handle);
+    Device * device = make_dev(device_init_info);
+    startup_profile_mark("Device create");
+    return device;
+}
+
 dl_handle_t load_command_map_dll(const string cmd_map_abs_path)
 {
     dl_handle_t handle = get_dynamic_lib(cmd_map_abs_path);
 
-    num_cmd_fptr get_num_commands = get_num_cmd_fptr(handle);
-    num_commands = get_num_commands();
-
-    get_cmd_index = get_cmd_index_fptr(handle);
-    get_cmd_name = get_cmd_name_fptr(handle);
-    get_cmd_id_info = get_cmd_id_info_fptr(handle);
-    get_cmd_val_info = get_cmd_val_info_fptr(handle);
-    get_cmd_info = get_cmd_info_fptr(handle);
-    get_cmd_hidden = get_cmd_hidden_fptr(handle);
+    startup_profile_mark("Command map open");
 
+    lock_guard<mutex> lock(load_cmd_map_mutex);
+    dl_handle_t loaded = loaded_cmd_map.load(memory_order_relaxed);
+    if(loaded == nullptr)
+    {
+        num_cmd_fptr get_num_commands = get_num_cmd_fptr(handle);
+        num_commands = get_num_commands();
+        loaded_cmd_map.store(handle, memory_order_release);
+    }
+    else if(handle != loaded)
+    {
+        throw host_app_error("Command map " + cmd_map_abs_path + " differs from the one already loaded, a process can only use one command map");
+    }
+    startup_profile_mark("Command map symbols");
     return handle;
 }
 
 bool check_if_cmd_exists(const string cmd_name)
 {
     const string up_str = to_upper(cmd_name);
-    size_t index = get_cmd_index(up_str);
+    size_t index = cmd_map_function(get_cmd_index, get_cmd_index_fptr)(up_str);
     if(index == UINT32_MAX)
     {
         return false;
@@ -88,42 +153,73 @@ bool check_if_cmd_exists(const string cmd_name)
     return true;
 }
 
-size_t argv_option_lookup(int argc, char ** argv, opt_t * opt_lookup)
+void check_values_in_range(const string cmd_name, const cmd_param_t * vals)
 {
-    for(int i = 1; i < argc; i++)
+    range_error_fptr range_error = get_range_error.load(memory_order_acquire);
+    if(range_error == nullptr)
     {
-        string cmd_arg = to_lower(argv[i]);
-        if((cmd_arg == opt_lookup->long_name) || (cmd_arg == opt_lookup->short_name))
+        range_error = get_range_error_fptr(loaded_cmd_map.load(memory_order_acquire));
+        if(range_error == nullptr)
         {
-            return i;
+            // Older command_map, its check_range() prints the error and exits
+            cmd_map_function(check_range, get_check_range_fptr)(cmd_name, vals);
+            return;
         }
+        get_range_error.store(range_error, memory_order_release);
+    }
+    string error = range_error(cmd_name, vals);
+    if(!error.empty())
+    {
+        throw host_app_error("Command " + cmd_name + ": " + error);
     }
-    return 0;
 }
 
-void remove_opt(int * argc, char ** argv, size_t ind, size_t num)
+void check_cmd_error(string cmd_name, string rw, control_ret_t ret)
 {
-    for(size_t i = 0; i < * argc - ind - num; i++)
+    rw[0] = toupper(rw[0]);
+    if(ret != CONTROL_SUCCESS)
     {
-        argv[ind + i] = argv[ind + num + i];
+        throw host_app_error(rw + " command " + cmd_name + " returned control_ret_t error " + to_string(static_cast<int>(ret)) + ", " + control_ret_str_map[ret], ret);
     }
-    * argc -= num;
-    if(* argc == 1)
+}
+
+void enable_startup_profile()
+{
+    is_startup_profiled = true;
+    startup_profile_mark("Process start");
+}
+
+void startup_profile_mark(const string step)
+{
+    if(is_startup_profiled)
     {
-        cout << "Use --help to get the list of options for this application." << endl
-        << "Or use --list-commands to print the list of commands and their info." << endl;
-        exit(0);
+        startup_steps.emplace_back(step, profile_clock_t::now());
     }
 }
 
-void check_cmd_error(string cmd_name, string rw, control_ret_t ret)
+void print_startup_profile(ostream & os)
 {
-    rw[0] = toupper(rw[0]);
-    if(ret != CONTROL_SUCCESS)
+    if(!is_startup_profiled)
+    {
+        return;
+    }
+    const profile_clock_t::time_point end = profile_clock_t::now();
+    profile_clock_t::time_point start = process_start_time;
+    os << "Startup profile:" << endl << fixed << setprecision(3);
+    for(const auto & step : startup_steps)
     {
-        cerr << rw << " command " << cmd_name << " returned control_ret_t error " << static_cast<int>(ret) << ", " << control_ret_str_map[ret] << endl;
-        exit(ret);
+        os << left << setw(26) << step.first + ":" << right << setw(10)
+        << chrono::duration_cast<chrono::nanoseconds>(step.second - start).count() / 1e6 << " ms" << endl;
+        start = step.second;
     }
+    os << left << setw(26) << "Total:" << right << setw(10)
+    << chrono::duration_cast<chrono::nanoseconds>(end - process_start_time).count() / 1e6 << " ms" << endl;
+}
+
+void print_bus_arbiter_stats(const bus_arbiter_stats_t & stats, ostream & os, const string log_prefix)
+{
+    os << log_prefix << "Bus lock: " << stats.acquisitions << " acquisitions, " << stats.contended << " contended, waited "
+    << stats.total_wait_us / 1000.0 << " ms, longest wait " << stats.max_wait_us / 1000.0 << " ms" << endl;
 }
 
 string command_rw_type_name(const cmd_rw_t rw)
@@ -144,8 +240,7 @@ string command_rw_type_name(const cmd_rw_t rw)
         break;
 
     default:
-        cerr << "Unsupported read/write type" << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Unsupported read/write type");
     }
 
     return tstr;
@@ -155,30 +250,27 @@ control_ret_t check_num_args(const cmd_t * cmd, const size_t args_left)
 {
     if((cmd->rw == CMD_RO) && (args_left != 0))
     {
-        cerr << "Command: " << cmd->cmd_name << " is read-only, so it does not require any arguments." << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Command: " + cmd->cmd_name + " is read-only, so it does not require any arguments.");
     }
     else if ((cmd->rw == CMD_WO) && (args_left != cmd->num_values))
     {
-        cerr << "Command: " << cmd->cmd_name << " is write-only and"
-        << " expects " << cmd->num_values << " argument(s), " << endl
-        << args_left << " are given." << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Command: " + cmd->cmd_name + " is write-only and"
+        + " expects " + to_string(cmd->num_values) + " argument(s), \n"
+        + to_string(args_left) + " are given.");
     }
     else if ((cmd->rw == CMD_RW) && (args_left != 0) && (args_left != cmd->num_values))
     {
-        cerr << "Command: " << cmd->cmd_name << " is a read/write command." << endl
-        << "If you want to read do not give any arguments to this command." << endl
-        << "If you want to write give " << cmd->num_values << " argument(s) to this command, "
-        << args_left << " are given." << endl;
-        exit(HOST_APP_ERROR);
+        throw host_app_error("Command: " + cmd->cmd_name + " is a read/write command.\n"
+        + "If you want to read do not give any arguments to this command.\n"
+        + "If you want to write give " + to_string(cmd->num_values) + " argument(s) to this command, "
+        + to_string(args_left) + " are given.");
     }
     return CONTROL_SUCCESS;
 }
 
 // Taken from:
 // https://www.talkativeman.com/levenshtein-distance-algorithm-string-comparison/
-static int Levenshtein_distance(const string source, const string target)
+int Levenshtein_distance(const string source, const string target)
 {
 
     const int n = source.length();
@@ -266,7 +358,7 @@ static void calc_Levenshtein_and_error(const string str)
     size_t indx  = 0;
     for(size_t i = 0; i < num_commands; i++)
     {
-        string comp_name = get_cmd_name(i);
+        string comp_name = cmd_map_function(get_cmd_name, get_cmd_name_fptr)(i);
         int dist = Levenshtein_distance(str, comp_name);
         if(dist < shortest_dist)
         {
@@ -274,9 +366,8 @@ static void calc_Levenshtein_and_error(const string str)
             indx = i;
         }
     }
-    cerr << "Command " << str << " does not exist." << endl
-    << "Maybe you meant " << get_cmd_name(indx) <<  "." << endl;
-    exit(HOST_APP_ERROR);
+    throw host_app_error("Command " + str + " does not exist.\n"
+    + "Maybe you meant " + cmd_map_function(get_cmd_name, get_cmd_name_fptr)(indx) +  ".");
 }
 
 void init_cmd(cmd_t * cmd, const std::string cmd_name, size_t index)
@@ -285,7 +376,7 @@ void init_cmd(cmd_t * cmd, const std::string cmd_name, size_t index)
 
     if(index == UINT32_MAX)
     {
-        index = get_cmd_index(up_str);
+        index = cmd_map_function(get_cmd_index, get_cmd_index_fptr)(up_str);
         if(index == UINT32_MAX)
         {
             calc_Levenshtein_and_error(up_str);
@@ -294,80 +385,11 @@ void init_cmd(cmd_t * cmd, const std::string cmd_name, size_t index)
     }
     else
     {
-        cmd->cmd_name = get_cmd_name(index);
+        cmd->cmd_name = cmd_map_function(get_cmd_name, get_cmd_name_fptr)(index);
     }
 
-    get_cmd_id_info(&cmd->res_id, &cmd->cmd_id, index);
-    get_cmd_val_info(&cmd->type, &cmd->rw, &cmd->num_values, index);
-    cmd->info = get_cmd_info(index);
-    cmd->hidden_cmd = get_cmd_hidden(index);
-}
-
-string get_device_lib_name(int * argc, char ** argv, opt_t* options, const size_t num_options)
-{
-    string lib_name = default_driver_name;
-    opt_t * use_opt = option_lookup("--use", options, num_options);
-    size_t index = argv_option_lookup(*argc, argv, use_opt);
-    if(index == 0)
-    {
-        // could not find --use, using default driver name
-        return lib_name;
-    }
-    else
-    {
-        string protocol_name = argv[index + 1];
-        if (to_upper(protocol_name) == "I2C")
-        {
-            lib_name = device_i2c_dl_name;
-        }
-        else if (to_upper(protocol_name) == "SPI")
-        {
-            lib_name = device_spi_dl_name;
-        }
-        else if (to_upper(protocol_name) == "USB")
-        {
-            lib_name = device_usb_dl_name;
-        }
-        else
-        {
-            // Using default driver
-            cout << "Could not find " << to_upper(protocol_name) << " in supported protocols"
-            << endl << "Will use default driver: " << default_driver_name << endl;
-        }
-        remove_opt(argc, argv, index, 2);
-        return lib_name;
-    }
-}
-
-opt_t * option_lookup(const string str, opt_t* options, const size_t num_options)
-{
-    string low_str = to_lower(str);
-    for(size_t i = 0; i < num_options; i++)
-    {
-        opt_t * opt = &options[i];
-        if ((low_str == opt->long_name) || (low_str == opt->short_name))
-        {
-            return opt;
-        }
-    }
-
-    int shortest_dist = 100;
-    int indx  = 0;
-    for(size_t i = 0; i < num_options; i++)
-    {
-        opt_t * opt = &options[i];
-        int dist_long = Levenshtein_distance(low_str, opt->long_name);
-        int dist_short = Levenshtein_distance(low_str, opt->short_name);
-        int dist = (dist_short < dist_long) ? dist_short : dist_long;
-        if(dist < shortest_dist)
-        {
-            shortest_dist = dist;
-            indx = i;
-        }
-    }
-    cerr << "Option " << str << " does not exist." << endl
-    << "Maybe you meant " << options[indx].short_name
-    << " or " << options[indx].long_name << "." << endl;
-    exit(HOST_APP_ERROR);
-    return nullptr;
+    cmd_map_function(get_cmd_id_info, get_cmd_id_info_fptr)(&cmd->res_id, &cmd->cmd_id, index);
+    cmd_map_function(get_cmd_val_info, get_cmd_val_info_fptr)(&cmd->type, &cmd->rw, &cmd->num_values, index);
+    cmd->info = cmd_map_function(get_cmd_info, get_cmd_info_fptr)(index);
+    cmd->hidden_cmd = cmd_map_function(get_cmd_hidden, get_cmd_hidden_fptr)(index);
 }
@@ -6,6 +6,8 @@
 
 #include <cstring>
 #include <cstdint>
+#include <stdexcept>
+#include <ostream>
 #include "device.hpp"
 
 #if defined(_WIN32)
@@ -20,6 +22,28 @@ typedef void * dl_handle_t;
 
 #define HOST_APP_ERROR -1
 
+/**
+ * @brief Exception thrown by the command and device layers instead of exiting
+ *
+ * The applications print the message and exit with the code,
+ * the xvf_control library returns the code from its C functions.
+ */
+class host_app_error : public std::runtime_error
+{
+    public:
+
+        /** @brief control_ret_t returned by the device, or HOST_APP_ERROR */
+        const int code;
+
+        /**
+         * @brief Construct a new host_app_error object
+         *
+         * @param msg       Error message, without a trailing new line
+         * @param _code     control_ret_t returned by the device, or HOST_APP_ERROR
+         */
+        host_app_error(const std::string & msg, int _code = HOST_APP_ERROR) : std::runtime_error(msg), code(_code) {}
+};
+
 /** @brief Enum for read/write command types */
 enum cmd_rw_t {CMD_RO, CMD_WO, CMD_RW};
 
@@ -106,18 +130,26 @@ std::string to_lower(std::string str);
  */
 int * get_device_init_info(dl_handle_t handle, std::string lib_name);
 
-/** @brief Load the command_map shared object and get the cmd tools from it */
+/**
+ * @brief Load a device driver and create the device, which is not initialised yet
+ *
+ * @param cmd_map_handle    Pointer to the command_map dl, which holds the device information
+ * @param lib_name          Device dl name
+ * @param lib_dir           Directory of the device dl, the directory of the executable if empty
+ */
+Device * load_device(dl_handle_t cmd_map_handle, const std::string lib_name, const std::string lib_dir = "");
+
+/**
+ * @brief Load the command_map shared object, the cmd tools are resolved from it the first time they are used
+ *
+ * @param cmd_map_abs_path  Path to the command_map
+ * @note Throws host_app_error if another command_map has already been loaded, a process only uses one
+ */
 dl_handle_t load_command_map_dll(const std::string cmd_map_abs_path);
 
 /** @brief Initialise cmd_t structure with either command name or it's index */
 void init_cmd(cmd_t * cmd, const std::string cmd_name, size_t index = UINT32_MAX);
 
-/** @brief Lookup option in argv */
-size_t argv_option_lookup(int argc, char ** argv, opt_t * opt_lookup);
-
-/** @brief Remove words from argv, decrement argc */
-void remove_opt(int * argc, char ** argv, size_t ind, size_t num);
-
 /**
  * @brief Convert relative path to working directory to absolute path
  *
@@ -129,8 +161,9 @@ std::string convert_to_abs_path(const std::string rel_path);
  * @brief Convert lib name into the path to the library
  *
  * @param lib_name Name of the library to load (without lib prefix)
+ * @param lib_dir  Directory of the library, the directory of the executable if empty
  */
-std::string get_dynamic_lib_path(const std::string lib_name);
+std::string get_dynamic_lib_path(const std::string lib_name, const std::string lib_dir = "");
 
 /**
  * @brief Open the dynamic library
@@ -139,6 +172,38 @@ std::string get_dynamic_lib_path(const std::string lib_name);
  */
 dl_handle_t get_dynamic_lib(const std::string lib_path);
 
+/** @brief Function of a library linked into the application */
+struct static_symbol_t
+{
+    /** Name the function would be looked up with in the dynamic library */
+    const char * name;
+    /** Function, cast back to its own type by the get_*_fptr functions */
+    void (* func)();
+};
+
+/** @brief Library linked into the application instead of being loaded at run time */
+struct static_lib_t
+{
+    /** Name of the library, as given to get_dynamic_lib_path() */
+    const char * name;
+    /** Functions of the library */
+    const static_symbol_t * symbols;
+    /** Number of functions */
+    size_t num_symbols;
+};
+
+/**
+ * @brief Register the libraries linked into the application
+ *
+ * get_dynamic_lib() returns a registered library instead of loading it from the path
+ * get_dynamic_lib_path() gives for its name, and the get_*_fptr functions look its functions
+ * up in the table. The libraries at any other path are still loaded at run time.
+ *
+ * @param libs      Table of the libraries, which must outlive the application
+ * @param num_libs  Number of libraries in the table
+ */
+void register_static_libs(const static_lib_t * libs, size_t num_libs);
+
 /** uint32_t function pointer type */
 using num_cmd_fptr = uint32_t (*)();
 
@@ -172,6 +237,9 @@ using print_args_fptr = void (*)(const std::string, cmd_param_t *);
 /** Function pointer to get the range check info */
 using check_range_fptr = void (*)(const std::string, const cmd_param_t *);
 
+/** Function pointer to describe the values out of range, an empty string if they are all in range */
+using range_error_fptr = std::string (*)(const std::string, const cmd_param_t *);
+
 /**
  * @brief Get the function pointer to get_num_commands()
  *
@@ -250,15 +318,63 @@ print_args_fptr get_print_args_fptr(dl_handle_t handle);
  */
 check_range_fptr get_check_range_fptr(dl_handle_t handle);
 
+/**
+ * @brief Get the function pointer to get_range_error()
+ *
+ * @param handle Pointer to the command_map shared object
+ * @return       nullptr if the command_map does not have get_range_error(), as the older ones
+ */
+range_error_fptr get_range_error_fptr(dl_handle_t handle);
+
+/**
+ * @brief Check the values of a command against the range given by the loaded command_map
+ *
+ * @param cmd_name  Name of the command
+ * @param vals      Values of the command
+ * @throw host_app_error if a value is out of range
+ * @note  A command_map without get_range_error() is checked with its check_range(), which exits the process
+ */
+void check_values_in_range(const std::string cmd_name, const cmd_param_t * vals);
+
 /** @brief Get read/write type string */
 std::string command_rw_type_name(const cmd_rw_t rw);
 
 /** @brief Check if the right number of arguments has been given for the command */
 control_ret_t check_num_args(const cmd_t * cmd, const size_t args_left);
 
-/** @brief Exit on control_ret_t error */
+/** @brief Throw host_app_error on control_ret_t error */
 void check_cmd_error(std::string cmd_name, std::string rw, control_ret_t ret);
 
+/**
+ * @brief Print the time spent waiting for a device shared with other processes
+ *
+ * @param stats         Waiting statistics of the device
+ * @param os            Stream to print to
+ * @param log_prefix    String printed at the start of the line, used to tell targets apart
+ */
+void print_bus_arbiter_stats(const bus_arbiter_stats_t & stats, std::ostream & os, const std::string log_prefix = "");
+
+/**
+ * @brief Start recording the startup steps, which print_startup_profile() prints
+ *
+ * The time from the process start to this call is recorded as the first step.
+ */
+void enable_startup_profile();
+
+/**
+ * @brief Record the end of a startup step, does nothing unless enable_startup_profile() has been called
+ *
+ * @param step      Name of the step which has just ended, it started when the previous step ended
+ */
+void startup_profile_mark(const std::string step);
+
+/**
+ * @brief Print the time taken by each startup step, if enable_startup_profile() has been called
+ *
+ * @param os        Stream to print to
+ */
+void print_startup_profile(std::ostream & os);
+
 /** @brief Get current terminal width */
 size_t get_term_width();
 
@@ -267,19 +383,11 @@ size_t get_term_width();
 */
 bool check_if_cmd_exists(const std::string cmd_name);
 
-/** @brief Get device driver name to load by looking for --use
- * @note Will decrement argc, if option is present
- */
-std::string get_device_lib_name(int * argc, char ** argv, opt_t* options, const size_t num_options);
-
 /** @brief Get path of executable
  * @return string with path with no slash at the end
 */
 std::string get_executable_path();
 
-/** @brief Look up the string in the option list.
- * @note If the string is not found, will suggest a possible match and exit.
- * @note Function is case insensitive
- */
-opt_t * option_lookup(const std::string str, opt_t* options, const size_t num_options);
+/** @brief Number of single character edits turning source into target, used to suggest the closest name */
+int Levenshtein_distance(const std::string source, const std::string target);
 #endif
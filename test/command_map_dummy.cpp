@@ -7,6 +7,7 @@
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <map>
 
 /** @brief Enum for read/write command types */
@@ -141,6 +142,12 @@ const int * get_info_i2c()
     return &dummy_info;
 }
 
+extern "C"
+const int * get_info_spi()
+{
+    return &dummy_info;
+}
+
 void print_arg_local(const cmd_param_type_t type, const cmd_param_t val)
 {
     switch(type)
@@ -181,25 +188,25 @@ void super_print_arg(const std::string cmd_name, cmd_param_t *values)
     std::cout << std::endl;
 }
 
-void print_arg_stderr(const cmd_param_type_t type, const cmd_param_t val)
+void print_arg_stream(std::ostream & os, const cmd_param_type_t type, const cmd_param_t val)
 {
     switch(type)
     {
     case TYPE_CHAR:
-        std::cerr << static_cast<char>(val.ui8);
+        os << static_cast<char>(val.ui8);
         break;
     case TYPE_UINT8:
-        std::cerr << static_cast<int>(val.ui8);
+        os << static_cast<int>(val.ui8);
         break;
     case TYPE_RADIANS:
     case TYPE_FLOAT:
-        std::cerr << std::setprecision(7) << val.f;
+        os << std::setprecision(7) << val.f;
         break;
     case TYPE_INT32:
-        std::cerr << val.i32;
+        os << val.i32;
         break;
     case TYPE_UINT32:
-        std::cerr << val.ui32;
+        os << val.ui32;
         break;
     default:
         std::cerr << "Unsupported parameter type" << std::endl;
@@ -239,7 +246,7 @@ int compare_lim(const cmd_param_type_t type, const cmd_param_t val, const cmd_pa
     }
 }
 
-void check_range_one(const val_range_t * range_info, const cmd_param_type_t cmd_type, const cmd_param_t param)
+std::string check_range_one(const val_range_t * range_info, const cmd_param_type_t cmd_type, const cmd_param_t param)
 {
     size_t range_ind = 0;
     int ret = 0;
@@ -251,21 +258,22 @@ void check_range_one(const val_range_t * range_info, const cmd_param_type_t cmd_
     }
     if(ret == 0)
     {
-        std::cerr << "Value ";
-        print_arg_stderr(cmd_type, param);
-        std::cerr << " must fall within the given range(s): ";
+        std::ostringstream error;
+        error << "Value ";
+        print_arg_stream(error, cmd_type, param);
+        error << " must fall within the given range(s):";
 
         for(size_t num_int = 0; num_int < range_info->num_intervals; num_int++)
         {
-            std::cerr << "[";
-            print_arg_stderr(cmd_type, range_info->ranges[num_int * 2]);
-            std::cerr  << ", ";
-            print_arg_stderr(cmd_type, range_info->ranges[num_int * 2 + 1]);
-            std::cerr << "] ";
+            error << " [";
+            print_arg_stream(error, cmd_type, range_info->ranges[num_int * 2]);
+            error  << ", ";
+            print_arg_stream(error, cmd_type, range_info->ranges[num_int * 2 + 1]);
+            error << "]";
         }
-        std::cerr << std::endl;
-        exit(-1);
+        return error.str();
     }
+    return "";
 }
 
 cmd_param_t range0[4] = {0};
@@ -311,7 +319,7 @@ std::map<std::string, val_range_t *> test_map{
 };
 
 extern "C"
-void check_range(const std::string cmd_name, const cmd_param_t * vals)
+std::string get_range_error(const std::string cmd_name, const cmd_param_t * vals)
 {
     cmd_t * cmd = &commands[get_cmd_index(cmd_name)];
 
@@ -354,7 +362,23 @@ void check_range(const std::string cmd_name, const cmd_param_t * vals)
         for(size_t i = 0; i < cmd->num_values; i++)
         {
             if(val_range_ptr[i].num_intervals == 0){continue;}
-            check_range_one(&val_range_ptr[i], cmd->type, vals[i]);
+            std::string error = check_range_one(&val_range_ptr[i], cmd->type, vals[i]);
+            if(!error.empty())
+            {
+                return error;
+            }
         }
     }
+    return "";
+}
+
+extern "C"
+void check_range(const std::string cmd_name, const cmd_param_t * vals)
+{
+    std::string error = get_range_error(cmd_name, vals);
+    if(!error.empty())
+    {
+        std::cerr << error << std::endl;
+        exit(-1);
+    }
 }
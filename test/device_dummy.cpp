@@ -33,12 +33,17 @@ control_ret_t Device::device_init()
             ret = CONTROL_REGISTRATION_FAILED;
         }
         device_initialised = true;
+        if(ret == CONTROL_SUCCESS)
+        {
+            ret = open_bus_arbiter("dummy", arbitration_requested, &arbiter);
+        }
     }
     return ret;
 }
 
 control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     if(payload_len > (buff_size + 1)) // Max buffer len + 1 for the status
     {
         return CONTROL_DATA_LENGTH_ERROR;
@@ -79,16 +84,17 @@ control_ret_t Device::device_get(control_resid_t res_id, control_cmd_t cmd_id, u
     switch(cmd_id & 0x7F)
     {
         case 5:
-            memcpy(&payload[1], ch_ar, payload_len);
+            memcpy(&payload[1], ch_ar, payload_len - 1); // the first byte is the status
             break;
         default:
-            memcpy(&payload[1], buffer, payload_len);
+            memcpy(&payload[1], buffer, payload_len - 1);
     }
     return CONTROL_SUCCESS;
 }
 
 control_ret_t Device::device_set(control_resid_t res_id, control_cmd_t cmd_id, const uint8_t payload[], size_t payload_len)
 {
+    BusArbiterLock lock(arbiter);
     if(payload_len > buff_size) // Max buffer len
     {
         return CONTROL_DATA_LENGTH_ERROR;
@@ -123,6 +129,8 @@ Device::~Device()
 {
     if(device_initialised)
     {
+        delete arbiter;
+        arbiter = nullptr;
         device_initialised = false;
     }
 }
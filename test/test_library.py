@@ -0,0 +1,212 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XCORE VocalFusion Licence.
+
+import test_utils
+import ctypes
+import platform
+import pytest
+import shutil
+import threading
+import time
+
+
+def load_library(host_bin):
+    lib_names = {"Linux": "libxvf_control.so", "Darwin": "libxvf_control.dylib", "Windows": "xvf_control.dll"}
+    lib_path = host_bin.parents[1] / lib_names[platform.system()]
+    if not lib_path.is_file():
+        pytest.skip(f"{lib_path} not built")
+    lib = ctypes.CDLL(str(lib_path))
+    lib.xvf_control_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.POINTER(ctypes.c_void_p)]
+    lib.xvf_control_close.argtypes = [ctypes.c_void_p]
+    lib.xvf_control_last_error.restype = ctypes.c_char_p
+    lib.xvf_control_num_commands.argtypes = [ctypes.c_void_p]
+    lib.xvf_control_num_commands.restype = ctypes.c_size_t
+    lib.xvf_control_command_name.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_command_name.restype = ctypes.c_char_p
+    lib.xvf_control_get.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_set.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_get_buffer.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.xvf_control_get_eq_filter.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(ctypes.c_size_t)]
+    return lib
+
+
+def test_library(monkeypatch, tmp_path):
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    # the dummy device keeps its buffer in the working directory
+    monkeypatch.chdir(test_dir)
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    lib = load_library(host_bin)
+    ctrl = ctypes.c_void_p()
+    assert lib.xvf_control_open(None, str(test_dir).encode(), control_protocol.encode(), 0, ctypes.byref(ctrl)) == 0
+    try:
+        names = [lib.xvf_control_command_name(ctrl, i).decode() for i in range(lib.xvf_control_num_commands(ctrl))]
+        assert "CMD_SMALL" in names
+
+        values = (ctypes.c_int32 * 3)(4, 5, 6)
+        assert lib.xvf_control_set(ctrl, b"cmd_small", values, 3) == 0
+        out = (ctypes.c_int32 * 3)()
+        assert lib.xvf_control_get(ctrl, b"CMD_SMALL", out, 3) == 0
+        assert list(out) == [4, 5, 6]
+        assert lib.xvf_control_last_error() == b""
+
+        # errors are returned, the process keeps running
+        assert lib.xvf_control_get(ctrl, b"CMD_SMAL", out, 3) == -1
+        assert b"Maybe you meant CMD_SMALL" in lib.xvf_control_last_error()
+        assert lib.xvf_control_set(ctrl, b"CMD_SMALL", values, 2) == -1
+        assert lib.xvf_control_set(ctrl, b"CMD_CHAR", values, 3) == -1
+        assert lib.xvf_control_get(ctrl, b"CMD_SMALL", out, 2) == -1
+        length = ctypes.c_size_t(0)
+        assert lib.xvf_control_get_eq_filter(ctrl, None, ctypes.byref(length)) == -1
+        assert b"SPECIAL_CMD_PP_EQUALIZATION_NUM_BANDS" in lib.xvf_control_last_error()
+
+        # a value out of range fails the call instead of exiting the process
+        range_values = (ctypes.c_int32 * 1)(4)
+        assert lib.xvf_control_set(ctrl, b"RANGE_TEST0", range_values, 1) == -1
+        assert b"must fall within the given range(s)" in lib.xvf_control_last_error()
+        range_values[0] = 5
+        assert lib.xvf_control_set(ctrl, b"RANGE_TEST0", range_values, 1) == 0
+    finally:
+        lib.xvf_control_close(ctrl)
+
+    other = ctypes.c_void_p()
+    assert lib.xvf_control_open(None, str(test_dir / "missing").encode(), control_protocol.encode(), 0, ctypes.byref(other)) == -1
+    assert lib.xvf_control_last_error() != b""
+    assert not other.value
+
+    # the handles of a process share a single command map
+    map_names = {"Linux": "libcommand_map.so", "Darwin": "libcommand_map.dylib", "Windows": "command_map.dll"}
+    other_map = tmp_path / map_names[platform.system()]
+    shutil.copy(test_dir / map_names[platform.system()], other_map)
+    assert lib.xvf_control_open(str(other_map).encode(), str(test_dir).encode(), control_protocol.encode(), 0, ctypes.byref(other)) == -1
+    assert b"differs from the one already loaded" in lib.xvf_control_last_error()
+    assert not other.value
+
+
+def test_python_bindings(monkeypatch):
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    monkeypatch.chdir(test_dir)
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    np = pytest.importorskip("numpy")
+    # the bindings are copied next to the library by the build
+    build_dir = host_bin.parents[1]
+    if not (build_dir / "xvf_control.py").is_file():
+        pytest.skip(f"Python bindings not found in {build_dir}")
+    monkeypatch.syspath_prepend(str(build_dir))
+    import xvf_control
+
+    with xvf_control.XvfControl(test_dir, control_protocol, bypass_range_check=True) as ctrl:
+        assert ctrl.info("cmd_small").num_values == 3
+
+        ctrl.set("CMD_SMALL", [7, -8, 9])
+        values = ctrl.get("CMD_SMALL")
+        assert values.dtype == np.int32
+        assert list(values) == [7, -8, 9]
+
+        # values are read into the given array
+        out = np.zeros(3, dtype=np.int32)
+        assert ctrl.get("CMD_SMALL", out) is out
+        assert list(out) == [7, -8, 9]
+
+        ctrl.set_many({"CMD_FLOAT": np.arange(20, dtype=np.float32) / 4})
+        assert np.array_equal(ctrl.get_many(["CMD_FLOAT"])["CMD_FLOAT"], np.arange(20, dtype=np.float32) / 4)
+
+        # the dummy device keeps the last write, so the start offset of the only chunk reads back as 0.0
+        buffer = np.arange(1, 21, dtype=np.float32)
+        buffer[0] = 0.0
+        ctrl.set_buffer("RANGE_TEST0", "CMD_FLOAT", buffer)
+        assert np.array_equal(ctrl.get_buffer("RANGE_TEST0", "CMD_FLOAT", 20), buffer)
+        assert ctrl.get_buffer("RANGE_TEST0", "CMD_FLOAT", 45).shape == (45,)
+
+        with pytest.raises(xvf_control.XvfControlError, match="Maybe you meant CMD_SMALL"):
+            ctrl.get("CMD_SMAL")
+        with pytest.raises(xvf_control.XvfControlError):
+            ctrl.get("CMD_SMALL", np.zeros(3, dtype=np.float32))
+        with pytest.raises(xvf_control.XvfControlError):
+            ctrl.get_buffer("CMD_SMALL", "CMD_FLOAT", 20)
+        # the dummy command map has no filter, the call fails before selecting anything
+        with pytest.raises(xvf_control.XvfControlError, match="SPECIAL_CMD_PP_EQUALIZATION"):
+            ctrl.get_eq_filter()
+        with pytest.raises(xvf_control.XvfControlError, match="SPECIAL_CMD_AEC_FILTER"):
+            ctrl.set_aec_filter(0, 0, np.zeros(4, dtype=np.float32))
+
+
+def test_library_threads(monkeypatch):
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    monkeypatch.chdir(test_dir)
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    lib = load_library(host_bin)
+    ctrl = ctypes.c_void_p()
+    assert lib.xvf_control_open(None, str(test_dir).encode(), control_protocol.encode(), 0, ctypes.byref(ctrl)) == 0
+    errors = []
+
+    # The dummy device keeps a single buffer, so an interleaved write would show up as mixed values
+    def writer():
+        for i in range(200):
+            values = (ctypes.c_int32 * 3)(i, i, i)
+            if lib.xvf_control_set(ctrl, b"CMD_SMALL", values, 3) != 0:
+                errors.append(lib.xvf_control_last_error())
+
+    def poller():
+        out = (ctypes.c_int32 * 3)()
+        for _ in range(200):
+            if lib.xvf_control_get(ctrl, b"CMD_SMALL", out, 3) != 0:
+                errors.append(lib.xvf_control_last_error())
+            elif len(set(out)) != 1:
+                errors.append(list(out))
+
+    try:
+        threads = [threading.Thread(target=writer), threading.Thread(target=poller), threading.Thread(target=poller)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        # errors are reported to the thread which made the call
+        assert lib.xvf_control_get(ctrl, b"CMD_SMAL", (ctypes.c_int32 * 3)(), 3) == -1
+        assert b"Maybe you meant" in lib.xvf_control_last_error()
+    finally:
+        lib.xvf_control_close(ctrl)
+    assert errors == []
+
+
+def test_library_priority(monkeypatch):
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    monkeypatch.chdir(test_dir)
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    lib = load_library(host_bin)
+    ctrl = ctypes.c_void_p()
+    assert lib.xvf_control_open(None, str(test_dir).encode(), control_protocol.encode(), 1, ctypes.byref(ctrl)) == 0
+    try:
+        # A long bulk transfer, split into chunks of 20 values
+        length = 1000000
+        buffer = (ctypes.c_float * length)()
+        results = []
+        bulk = threading.Thread(target=lambda: results.append(lib.xvf_control_get_buffer(ctrl, b"RANGE_TEST0", b"CMD_FLOAT", buffer, length)))
+        bulk.start()
+        time.sleep(0.05)
+
+        # A control write runs between two chunks instead of waiting for the whole transfer
+        values = (ctypes.c_int32 * 3)(1, 2, 3)
+        assert lib.xvf_control_set(ctrl, b"CMD_SMALL", values, 3) == 0
+        preempted = bulk.is_alive()
+        bulk.join()
+        assert results == [0]
+        assert preempted
+    finally:
+        lib.xvf_control_close(ctrl)
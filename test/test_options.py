@@ -3,8 +3,15 @@
 
 import test_utils
 import os
+import pytest
 import platform
 import shutil
+import json
+import struct
+import signal
+import subprocess
+import threading
+import time
 from pathlib import Path
 
 small_cmd = "CMD_SMALL"
@@ -36,6 +43,590 @@ def test_execute_cmd_list():
     print(out)
 
 
+def test_compile_cmd_list():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    # lines longer than 128 characters are supported
+    float_vals = test_utils.gen_rand_array('float', -1000.0, 1000.0)
+    cmd_list_path = test_dir / "commands_long.txt"
+    with open(cmd_list_path, "w") as f:
+        f.write("CMD_FLOAT " + " ".join(str(val) for val in float_vals) + "\n")
+        f.write("CMD_FLOAT\n")
+    out_text = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path))
+
+    # the compiled plan gives the same output as the text file
+    plan_path = test_dir / "commands_long.bin"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ccl " + str(cmd_list_path) + " " + str(plan_path))
+    assert plan_path.is_file()
+    out_plan = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(plan_path))
+    assert out_text == out_plan
+
+    # no command is sent if any line is not valid
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[1, 2, 3])
+    bad_list_path = test_dir / "commands_bad.txt"
+    with open(bad_list_path, "w") as f:
+        f.write(small_cmd + " 4 5 6\n")
+        f.write(small_cmd + " 7 8\n")
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(bad_list_path), expect_success=False)
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["1", "2", "3"]
+
+
+def test_boot_apply():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    cmd_list_path = test_dir / "commands_boot.txt"
+    plan_path = test_dir / "commands_boot.bin"
+    with open(cmd_list_path, "w") as f:
+        f.write(small_cmd + " 10 20 30\n")
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ccl " + str(cmd_list_path) + " " + str(plan_path))
+
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(plan_path))
+    assert "ACK:" in out
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["10", "20", "30"]
+
+    # a text command list is not accepted
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(cmd_list_path), expect_success=False)
+
+
+def test_optimise_cmd_list():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    cmd_list_path = test_dir / "commands_optimise.txt"
+    with open(cmd_list_path, "w") as f:
+        f.write(small_cmd + " 1 2 3\n")
+        f.write(small_cmd + " 4 5 6\n")
+        f.write(small_cmd + "\n")
+        f.write(small_cmd + " 7 8 9\n")
+        f.write(small_cmd + " 7 8 9\n")
+
+    # the write before the read is kept, the first 7 8 9 is overwritten by the second one
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " --optimise")
+    assert "Optimised 5 commands into 3 transactions: 2 repeated writes removed, 2 transactions saved" in " ".join(out)
+    assert out[-3:] == ["4", "5", "6"]
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["7", "8", "9"]
+
+    # the device already holds 7 8 9, so the write left is skipped
+    unchanged_list_path = test_dir / "commands_unchanged.txt"
+    with open(unchanged_list_path, "w") as f:
+        f.write(small_cmd + " 7 8 9\n")
+        f.write(small_cmd + " 7 8 9\n")
+        f.write(small_cmd + "\n")
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(unchanged_list_path) + " -op -su")
+    assert "Optimised 3 commands into 2 transactions: 1 repeated writes removed, 1 unchanged writes skipped after 1 reads, 1 transactions saved" in " ".join(out)
+    assert out[-3:] == ["7", "8", "9"]
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["7", "8", "9"]
+
+    # the saved plan is already optimised
+    plan_path = test_dir / "commands_optimise.bin"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ccl " + str(cmd_list_path) + " " + str(plan_path) + " -op")
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(plan_path))
+    assert "Applied 3 commands from " + str(plan_path) + " to 1 resources in 1 runs" in " ".join(out)
+
+    # --skip-unchanged needs --optimise
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " -su", expect_success=False)
+
+
+def test_out_of_order():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    cmd_list_path = test_dir / "commands_out_of_order.txt"
+    with open(cmd_list_path, "w") as f:
+        f.write(small_cmd + " 1 2 3\n")
+        f.write(small_cmd + "\n")
+        f.write("CMD_FLOAT " + " ".join(str(i / 4) for i in range(20)) + "\n")
+        f.write("CMD_FLOAT\n")
+        f.write(small_cmd + " 4 5 6\n")
+        f.write(small_cmd + "\n")
+
+    # the values read are printed in the order of the command list
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+    out_in_order = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path))
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " --out-of-order")
+    assert out == out_in_order
+    assert out[-3:] == ["4", "5", "6"]
+
+    plan_path = test_dir / "commands_out_of_order.bin"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ccl " + str(cmd_list_path) + " " + str(plan_path))
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(plan_path) + " -oo")
+    assert "Applied 6 commands from " + str(plan_path) in " ".join(out)
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["4", "5", "6"]
+
+
+def test_bus_lock(monkeypatch):
+    if platform.system() == "Windows":
+        return
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    monkeypatch.setenv("XVF_BUS_LOCK_DIR", str(test_dir))
+    lock_path = test_dir / "xvf_bus_dummy.lock"
+    if lock_path.is_file(): os.remove(lock_path)
+
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "--bus-lock --stats " + small_cmd + " 1 2 3")
+    assert "Bus lock: 1 acquisitions, 0 contended" in " ".join(out)
+    assert lock_path.is_file()
+
+    # Another process holds the next ticket, so the device is only taken once that process has exited.
+    # The lock file holds the next ticket and the ticket being served, then the owner of each ticket.
+    holder = subprocess.Popen(["sleep", "0.5"])
+    with open(lock_path, "r+b") as f:
+        next_ticket, now_serving = struct.unpack("<II", f.read(8))
+        assert next_ticket == now_serving
+        f.seek(0)
+        f.write(struct.pack("<I", next_ticket + 1))
+        f.seek(8 + 8 * (next_ticket % 256))
+        f.write(struct.pack("<Q", (next_ticket << 32) | holder.pid))
+    reaper = threading.Thread(target=holder.wait)
+    reaper.start()
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "-bl -st " + small_cmd)
+    reaper.join()
+    assert out[1:4] == ["1", "2", "3"]
+    stats = " ".join(out)
+    assert "Bus lock: 1 acquisitions, 1 contended" in stats
+    assert float(stats.split("waited ")[1].split(" ")[0]) > 200
+
+    # without the option, the device is not shared
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "--stats " + small_cmd)
+    assert "Bus lock" not in " ".join(out)
+
+
+def test_cache():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    cmd_list_path = test_dir / "commands_cache.txt"
+    with open(cmd_list_path, "w") as f:
+        f.write(small_cmd + " 1 2 3\n")
+        f.write(small_cmd + "\n")
+        f.write(small_cmd + "\n")
+
+    # without the cache every read goes to the device
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " --stats"))
+    assert "Device reads: 2, device writes: 1" in out
+
+    # the reads are served from the value written
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " --cache-ttl 60000 -st"))
+    assert "Device reads: 0, device writes: 1" in out
+    assert "Cache hits: 2, misses: 0, bypassed: 0, hit rate: 100%" in out
+    assert out.count("1 2 3") == 2
+
+    # a bypassed command is always read from the device
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " -ct 60000 -cb " + small_cmd + " -st"))
+    assert "Device reads: 2, device writes: 1" in out
+    assert "Cache hits: 0, misses: 0, bypassed: 2, hit rate: 0%" in out
+
+    # unknown commands are rejected
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(cmd_list_path) + " -cs CMD_NOT_THERE", expect_success=False)
+
+
+def test_snapshot_restore():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[1, 2, 3])
+    snapshot_path = test_dir / "snapshot_test.bin"
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "--snapshot " + str(snapshot_path)))
+    assert snapshot_path.is_file()
+    assert "Saved 11 parameters into " + str(snapshot_path) in out
+
+    # nothing is written if the device still holds the values of the snapshot
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-rs " + str(snapshot_path)))
+    assert "Restored 0 of 10 parameters from " + str(snapshot_path) + ", 10 already matched" in out
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[4, 5, 6])
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-rs " + str(snapshot_path)))
+    assert "Restored 0 of" not in out
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert out == ["1", "2", "3"]
+
+    # the read only values of a snapshot can't be executed as a command list
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-e " + str(snapshot_path), expect_success=False)
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(snapshot_path), expect_success=False)
+
+
+def test_dump_params():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[1, 2, 3])
+
+    json_path = test_dir / "dump.json"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(json_path) + " --dump-format json")
+    with open(json_path) as f:
+        params = json.load(f)
+    assert params[small_cmd] == [1, 2, 3]
+    assert "CMD_HIDDEN" not in params
+    assert len(params) == 11
+
+    # only the filtered commands are dumped
+    csv_path = test_dir / "dump.csv"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(csv_path) + " -df csv -dp cmd_s")
+    with open(csv_path) as f:
+        lines = f.read().splitlines()
+    assert lines == ["command,resource_id,command_id,type,values", small_cmd + ",0,7,int32,1,2,3"]
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(json_path) + " -df json -dx RANGE_TEST[12]")
+    with open(json_path) as f:
+        assert list(json.load(f).keys()) == ["RANGE_TEST1", "RANGE_TEST2"]
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(json_path) + " -df json -dr 1")
+    with open(json_path) as f:
+        assert json.load(f) == {}
+
+    # a binary dump can be restored
+    bin_path = test_dir / "dump.bin"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(bin_path) + " -df binary")
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "--restore " + str(bin_path)))
+    assert "Restored 0 of 10 parameters" in out
+    # but not boot applied, as it holds the read only values
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-ba " + str(bin_path), expect_success=False)
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d " + str(csv_path), expect_success=False)
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-d -df xml", expect_success=False)
+
+    # a read error of the reader thread is returned by the application, not raised from the thread
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+    result = subprocess.run([str(host_bin), "-u", control_protocol, "-d", str(json_path), "-df", "json"], cwd=test_dir, capture_output=True, text=True)
+    assert result.returncode == 3 and "CONTROL_DATA_LENGTH_ERROR" in result.stderr
+
+
+def test_watch():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[1, 2, 3])
+
+    csv_path = test_dir / "watch.csv"
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "--watch " + small_cmd + " " + str(csv_path) + " --interval 1000 --watch-samples 10"))
+    assert "requested rate 1000 Hz" in out
+    with open(csv_path) as f:
+        lines = f.read().splitlines()
+    assert lines[0] == "time_us,seq,CMD_SMALL[0],CMD_SMALL[1],CMD_SMALL[2]"
+    # samples can only be dropped if the host is too slow, the ones written are in order
+    assert 1 < len(lines) <= 11
+    seqs = [int(line.split(",")[1]) for line in lines[1:]]
+    assert seqs == sorted(seqs)
+    assert all(line.split(",")[2:] == ["1", "2", "3"] for line in lines[1:])
+
+    # every sample is read from the device, even with the cache
+    out = " ".join(test_utils.execute_command(host_bin, control_protocol, test_dir, "-w " + small_cmd + " " + str(csv_path) + " -it 1000 -wn 10 -ct 60000 -st"))
+    assert "Cache hits: 0" in out
+
+    bin_path = test_dir / "watch.bin"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-w " + small_cmd + " " + str(bin_path) + " -it 1000 -wn 10 -wf binary")
+    with open(bin_path, "rb") as f:
+        data = f.read()
+    magic, version, num_cmds, interval_us, record_size = struct.unpack_from("<IHHII", data)
+    assert (magic, version, num_cmds, interval_us, record_size) == (0x57465658, 1, 1, 1000, 12 + 3 * 4)
+    records = data[16 + 1 + len(small_cmd) + 3:]
+    assert len(records) % record_size == 0
+    assert struct.unpack_from("<QI3i", records)[2:] == (1, 2, 3)
+
+    # unknown commands are rejected
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-w CMD_NOT_THERE -wn 1", expect_success=False)
+
+    # a read error stops the sampling, the samples taken before it are kept and the error is returned
+    proc = subprocess.Popen([str(host_bin), "-u", control_protocol, "-w", small_cmd, str(csv_path), "-it", "1000"], cwd=test_dir,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    time.sleep(0.3)
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+    _, err = proc.communicate(timeout=10)
+    assert proc.returncode == 3 and "CONTROL_DATA_LENGTH_ERROR" in err
+    with open(csv_path) as f:
+        lines = f.read().splitlines()
+    assert len(lines) > 1 and all(line.split(",")[2:] == ["1", "2", "3"] for line in lines[1:])
+
+
+def test_watch_capture():
+    if platform.system() == "Windows":
+        return
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[4, 5, 6])
+
+    # the file keeps the latest samples only
+    capture_path = test_dir / "watch.cap"
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-w " + small_cmd + " " + str(capture_path) + " -wf capture --capture-records 20 -it 1000 -wn 50")
+    size = capture_path.stat().st_size
+    test_utils.execute_command(host_bin, control_protocol, test_dir, "-w " + small_cmd + " " + str(capture_path) + " -wf capture -cr 20 -it 1000 -wn 100")
+    assert capture_path.stat().st_size == size
+
+    out = test_utils.run_cmd(str(host_bin) + " --read-capture " + str(capture_path), test_dir, True, True)
+    lines = str(out, "utf-8").splitlines()
+    assert lines[0] == "time_us,seq,CMD_SMALL[0],CMD_SMALL[1],CMD_SMALL[2]"
+    assert len(lines) == 20
+    assert all(line.split(",")[2:] == ["4", "5", "6"] for line in lines[1:])
+    seqs = [int(line.split(",")[1]) for line in lines[1:]]
+    assert seqs == sorted(seqs) and seqs[-1] == 99
+
+    # a window relative to the latest sample
+    out = test_utils.run_cmd(str(host_bin) + " -rc " + str(capture_path) + " -0.005", test_dir, True, True)
+    assert 1 < len(str(out, "utf-8").splitlines()) <= 8
+
+    test_utils.run_cmd(str(host_bin) + " -rc " + str(test_dir / "test_buf.bin"), test_dir, True, False)
+    # a header with offsets or sizes outside the file is rejected
+    for offset, fmt, value in [(12, "<I", 8), (16, "<Q", 1 << 60)]:
+        corrupt_path = test_dir / "corrupt.cap"
+        data = bytearray(capture_path.read_bytes())
+        struct.pack_into(fmt, data, offset, value)
+        corrupt_path.write_bytes(data)
+        err = test_utils.run_cmd(str(host_bin) + " -rc " + str(corrupt_path), test_dir, True, False)
+        assert "is not a valid capture file" in str(err, "utf-8")
+
+    # the times must be numbers
+    err = test_utils.run_cmd(str(host_bin) + " -rc " + str(capture_path) + " 1s", test_dir, True, False)
+    assert "Invalid time 1s" in str(err, "utf-8")
+
+
+def test_publish():
+    if platform.system() != "Linux":
+        return
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[4, 5, 6])
+
+    shm_path = Path("/dev/shm/xvf_params_test")
+    cmd = [str(test_dir / host_bin), "-u", control_protocol, "--publish", small_cmd + ",CMD_UINT8", "/xvf_params_test", "-it", "1000", "-wn", "5000"]
+    publisher = subprocess.Popen(cmd, cwd=test_dir, stdout=subprocess.PIPE)
+    try:
+        header = None
+        for _ in range(200):
+            if shm_path.is_file() and shm_path.stat().st_size >= 24:
+                header = struct.unpack_from("<IHHIIQ", shm_path.read_bytes())
+                if header[0] == 0x54465658:
+                    break
+            time.sleep(0.01)
+        assert header is not None and header[0] == 0x54465658
+        magic, version, num_entries, entry_size, interval_us, pid = header
+        assert (version, num_entries, interval_us, pid) == (1, 2, 1000, publisher.pid)
+        assert entry_size % 8 == 0
+
+        # wait for a few updates, then read the table until the entry is not being updated,
+        # the sequence is even and unchanged across the copy as for the readers of xvf_param_table.h
+        time.sleep(0.1)
+        for _ in range(1000):
+            seq_before = struct.unpack_from("<I", shm_path.read_bytes(), 24 + 56)[0]
+            table = shm_path.read_bytes()
+            seq_after = struct.unpack_from("<I", shm_path.read_bytes(), 24 + 56)[0]
+            if seq_before % 2 == 0 and seq_before == seq_after:
+                break
+        name, _, _, num_values, data_len, seq, num_updates, timestamp_ns = struct.unpack_from("<48sBBHIIIQ", table, 24)
+        assert seq == seq_before
+        assert name.rstrip(b"\0") == small_cmd.encode()
+        assert (num_values, data_len) == (3, 12)
+        assert seq % 2 == 0 and seq == 2 * num_updates and num_updates > 1
+        assert timestamp_ns > 0
+        assert list(struct.unpack_from("<3i", table, 24 + 72)) == [4, 5, 6]
+        name, _, _, num_values, data_len, _, _, _ = struct.unpack_from("<48sBBHIIIQ", table, 24 + entry_size)
+        assert (name.rstrip(b"\0"), num_values, data_len) == (b"CMD_UINT8", 20, 20)
+
+        # a second publisher does not take the table over
+        result = subprocess.run(cmd, cwd=test_dir, capture_output=True, text=True)
+        assert result.returncode != 0 and "published by another process" in result.stderr
+        assert struct.unpack_from("<IHHIIQ", shm_path.read_bytes())[5] == publisher.pid
+    finally:
+        publisher.send_signal(signal.SIGINT)
+        out, _ = publisher.communicate(timeout=10)
+    assert publisher.returncode == 0
+    assert "commands to /xvf_params_test" in str(out, "utf-8")
+    assert not shm_path.exists()
+
+    # a read error removes the table as well
+    publisher = subprocess.Popen(cmd, cwd=test_dir, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(0.3)
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+    publisher.communicate(timeout=10)
+    assert publisher.returncode != 0
+    assert not shm_path.exists()
+
+
+def test_wait_for():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[4, 5, 6])
+
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, "--wait-for \"" + small_cmd + " == 4 5 6\" --then-snapshot " + small_cmd)
+    out = " ".join(out)
+    assert "Condition met after" in out and "Snapshot of 1 commands" in out
+    assert out.count(small_cmd + " 4 5 6") == 2
+
+    test_utils.run_cmd(str(host_bin) + " -u " + control_protocol + " -wt \"" + small_cmd + " > 6\" -to 100", test_dir, True, False)
+    test_utils.run_cmd(str(host_bin) + " -u " + control_protocol + " -wt \"" + small_cmd + " == 4 5\"", test_dir, True, False)
+
+    # the condition is met by a write from another process while waiting
+    cmd = [str(test_dir / host_bin), "-u", control_protocol, "-wt", small_cmd + " >= 7", "-to", "10000", "-ts", small_cmd]
+    waiter = subprocess.Popen(cmd, cwd=test_dir, stdout=subprocess.PIPE)
+    time.sleep(0.2)
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[7, 8, 9])
+    out, _ = waiter.communicate(timeout=10)
+    assert waiter.returncode == 0
+    assert str(out, "utf-8").count(small_cmd + " 7 8 9") == 2
+
+
+def test_stdin_session():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    lines = [small_cmd + " 4 5 6", "# comment", "", small_cmd, "CMD_SMAL", small_cmd + " 1 2",
+             "cmd_float " + " ".join(str(i / 4) for i in range(20)), "CMD_FLOAT", "RANGE_TEST0 4", "RANGE_TEST0 5", "quit", small_cmd]
+    cmd = [str(test_dir / host_bin), "-u", control_protocol, "--stdin"]
+    result = subprocess.run(cmd, cwd=test_dir, input="\n".join(lines) + "\n", stdout=subprocess.PIPE, text=True, timeout=30)
+    responses = [json.loads(line) for line in result.stdout.splitlines()]
+    print(responses)
+
+    # one response per command, the session stops at quit and errors don't end it
+    assert [r["line"] for r in responses] == [1, 4, 5, 6, 7, 8, 9, 10]
+    assert result.returncode != 0
+    assert responses[0]["status"] == 0 and "values" not in responses[0]
+    assert responses[1]["values"] == [4, 5, 6]
+    assert responses[2]["status"] != 0 and "Maybe you meant " + small_cmd in responses[2]["error"]
+    assert responses[3]["status"] != 0 and responses[3]["command"] == small_cmd
+    assert responses[4]["command"] == "CMD_FLOAT"
+    assert responses[5]["values"] == [i / 4 for i in range(20)]
+    # a value out of range is an error of its line, the next lines still run
+    assert responses[6]["status"] != 0 and "must fall within the given range(s)" in responses[6]["error"]
+    assert responses[7]["status"] == 0 and responses[7]["command"] == "RANGE_TEST0"
+    assert all(r["time_us"] >= 0 for r in responses if r["status"] == 0)
+
+    # without a terminal the interactive session reads the lines as they are
+    cmd = [str(test_dir / host_bin), "-u", control_protocol, "--interactive"]
+    result = subprocess.run(cmd, cwd=test_dir, input=small_cmd + " 7 8 9\nCMD_SMAL\n" + small_cmd + "\n", stdout=subprocess.PIPE, text=True, timeout=30)
+    assert result.returncode == 0
+    assert small_cmd + " 7 8 9" in result.stdout
+    assert result.stdout.count(" ms") == 2
+
+
+def test_cmd_batch():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    def run_batch(args, expect_success=True):
+        out = test_utils.run_cmd(str(host_bin) + " -u " + control_protocol + " " + args, test_dir, True, expect_success)
+        return str(out, "utf-8").split()
+
+    float_vals = " ".join(str(i / 4) for i in range(20))
+    out = run_batch(small_cmd + " 1 2 3 -- " + small_cmd + " -- CMD_FLOAT " + float_vals + " -- -- CMD_FLOAT")
+    assert out[:4] == [small_cmd, "1", "2", "3"]
+    assert out[4] == "CMD_FLOAT" and [float(v) for v in out[5:]] == [i / 4 for i in range(20)]
+
+    # all the commands are checked before the first one is sent
+    assert run_batch(small_cmd + " 1 2 3 -- " + small_cmd) == [small_cmd, "1", "2", "3"]
+    assert "Error in command 2" in " ".join(run_batch(small_cmd + " 4 5 6 -- " + small_cmd + " 7 8", False))
+    run_batch(small_cmd + " 4 5 6 -- CMD_SMAL", False)
+    assert run_batch(small_cmd + " -- " + small_cmd) == [small_cmd, "1", "2", "3"] * 2
+
+    out = run_batch(small_cmd + " 4 5 6 -- " + small_cmd + " 7 8 9 -- " + small_cmd + " --optimise")
+    assert "1 repeated writes removed" in " ".join(out)
+    assert out[-3:] == ["7", "8", "9"]
+
+def test_profile_startup():
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    print("\n")
+
+    with open(test_dir / 'test_buf.bin', 'w'):
+        pass
+
+    test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd, cmd_vals=[1, 2, 3])
+    # the profile is printed to stderr, so stdout only holds the output of the command
+    result = subprocess.run([str(test_dir / host_bin), "-u", control_protocol, "--profile-startup", small_cmd], cwd=test_dir, capture_output=True, text=True)
+    assert result.returncode == 0 and result.stdout.split() == [small_cmd, "1", "2", "3"]
+    steps = [line.split(":")[0] for line in result.stderr.splitlines()[1:]]
+    assert steps == ["Process start", "Options", "Command map open", "Command map symbols", "Device driver open",
+                     "Device create", "Command setup", "Device init", "Commands", "Total"]
+
+    # the device is not connected for a command which does not exist
+    result = subprocess.run([str(test_dir / host_bin), "-u", control_protocol, "CMD_SMAL", "-ps"], cwd=test_dir, capture_output=True, text=True)
+    assert result.returncode != 0 and "Maybe you meant" in result.stderr
+    assert "Total:" in result.stderr and "Device init:" not in result.stderr
+
+
+def test_static_host(tmp_path):
+    test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
+    static_bin = test_dir / ("xvf_host_static_dummy" + Path(host_bin).suffix)
+    if not static_bin.is_file():
+        pytest.skip(f"{static_bin} not built")
+    print("\n")
+
+    # the built-in driver is the default one and the built-in command map is used without its library
+    shutil.copy2(static_bin, tmp_path)
+    with open(tmp_path / 'test_buf.bin', 'w'):
+        pass
+    test_utils.run_cmd(str(tmp_path / static_bin.name) + " " + small_cmd + " 4 5 6", tmp_path, True)
+    out = test_utils.run_cmd(str(tmp_path / static_bin.name) + " -u " + control_protocol + " " + small_cmd, tmp_path, True)
+    assert str(out, "utf-8").split() == [small_cmd, "4", "5", "6"]
+
+    # the same device as the plugin build, which reads what the static build has written
+    test_utils.run_cmd(str(static_bin) + " " + small_cmd + " 7 8 9", test_dir, True)
+    out = test_utils.execute_command(host_bin, control_protocol, test_dir, small_cmd)
+    assert [int(v) for v in out] == [7, 8, 9]
+
+    # the drivers which are not built in are still loaded at run time, with their information from the built-in command map
+    driver = next(test_dir.glob("*device_" + control_protocol + ".*"))
+    for protocol in ["spi", "usb"]:
+        shutil.copy2(driver, tmp_path / driver.name.replace(control_protocol, protocol))
+    out = test_utils.run_cmd(str(tmp_path / static_bin.name) + " -u spi " + small_cmd, tmp_path, True)
+    assert str(out, "utf-8").split() == [small_cmd, "4", "5", "6"]
+
+    # the dummy command map has no get_info_usb
+    result = subprocess.run([str(tmp_path / static_bin.name), "-u", "usb", small_cmd], cwd=tmp_path, capture_output=True, text=True)
+    assert result.returncode != 0 and "Could not find get_info_usb function" in result.stderr
+
+
 def test_version():
     test_dir, host_bin, control_protocol, _, _ = test_utils.get_dummy_files()
     print("\n")